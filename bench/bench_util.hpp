@@ -0,0 +1,42 @@
+#ifndef GIFCMD_BENCH_UTIL_HPP
+#define GIFCMD_BENCH_UTIL_HPP
+
+#include <algorithm>
+#include <chrono>
+#include <cstdlib>
+#include <string>
+#include <vector>
+
+// 运行 fn 共 repeats 次，返回最短的一次耗时（秒）
+template <class Fn>
+double BenchSeconds(int repeats, Fn &&fn)
+{
+    double best = 1e30;
+    for (int i = 0; i < repeats; i++)
+    {
+        auto start = std::chrono::steady_clock::now();
+        fn();
+        std::chrono::duration<double> elapsed = std::chrono::steady_clock::now() - start;
+        best = std::min(best, elapsed.count());
+    }
+    return best;
+}
+
+// 阻止编译器把只用于计时的结果优化掉
+template <class T>
+inline void KeepResult(const T &value)
+{
+    asm volatile("" : : "g"(&value) : "memory");
+}
+
+// 命令行参数中的正整数列表，没有参数时用 defaults
+inline std::vector<long> SizesFromArgs(int argc, char **argv, std::vector<long> defaults)
+{
+    std::vector<long> sizes;
+    for (int i = 1; i < argc; i++)
+        if (long value = std::strtol(argv[i], nullptr, 10); value > 0)
+            sizes.push_back(value);
+    return sizes.empty() ? defaults : sizes;
+}
+
+#endif // GIFCMD_BENCH_UTIL_HPP
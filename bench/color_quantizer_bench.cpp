@@ -0,0 +1,86 @@
+#include <cmath>
+#include <cstdio>
+#include <vector>
+#include "color_quantizer.hpp"
+#include "synthetic_image.hpp"
+#include "bench_util.hpp"
+
+// 颜色量化：直方图统计的帧率（各SIMD级别），以及各算法在 64/128/256 色时生成调色板的耗时
+// 逐帧调色板时每帧都要统计直方图并生成调色板，其帧率按两者之和计算；PSNR 为按最近颜色映射后的质量
+
+namespace
+{
+    double Psnr(const RgbImage &image, const Palette &palette)
+    {
+        double error = 0;
+        for (int y = 0; y < image.height; y++)
+        {
+            const uint8_t *p = image.Row(y);
+            for (int x = 0; x < image.width; x++, p += 3)
+            {
+                int best = 1 << 30;
+                for (int i = 0; i < palette.size; i++)
+                {
+                    int dr = p[0] - palette.colors[i][0], dg = p[1] - palette.colors[i][1], db = p[2] - palette.colors[i][2];
+                    best = std::min(best, dr * dr + dg * dg + db * db);
+                }
+                error += best;
+            }
+        }
+        double mse = error / (3.0 * image.width * image.height);
+        return mse > 0 ? 10 * std::log10(255.0 * 255.0 / mse) : 99.0;
+    }
+}
+
+int main()
+{
+    const int width = 640, height = 360;
+    RgbImage frame;
+    if (!FillSyntheticFrame(frame, width, height, 0))
+    {
+        std::fprintf(stderr, "无法分配 %dx%d 的帧\n", width, height);
+        return 1;
+    }
+
+    // 直方图：每帧的统计耗时
+    const SimdLevel best = DetectSimdLevel();
+    const char *level_names[] = {"scalar", "sse4.1", "avx2"};
+    ColorHistogram histogram;
+    double histogram_seconds = 0;
+    std::printf("histogram %dx%d\n%-8s %10s %10s\n", width, height, "kernel", "ms/frame", "fps");
+    for (SimdLevel level : {SimdLevel::scalar, SimdLevel::sse41, SimdLevel::avx2})
+    {
+        if (level > best)
+            continue;
+        double seconds = BenchSeconds(50, [&]
+                                      { histogram.Clear(); histogram.Add(frame, level); KeepResult(histogram); });
+        std::printf("%-8s %10.3f %10.0f\n", level_names[static_cast<int>(level)], seconds * 1e3, 1 / seconds);
+        histogram_seconds = seconds;
+    }
+
+    // 调色板：由同一帧的直方图生成
+    histogram.Clear();
+    histogram.Add(frame);
+    const struct
+    {
+        const char *name;
+        QuantizeAlgorithm algorithm;
+    } algorithms[] = {
+        {"median", QuantizeAlgorithm::median_cut},
+        {"octree", QuantizeAlgorithm::octree},
+        {"kmeans", QuantizeAlgorithm::kmeans},
+    };
+    std::printf("\npalette build\n%-8s %7s %10s %16s %8s\n", "algo", "colors", "build ms", "per-frame fps", "PSNR");
+    for (const auto &entry : algorithms)
+    {
+        for (int colors : {64, 128, 256})
+        {
+            Palette palette;
+            double seconds = BenchSeconds(10, [&]
+                                          { palette = Quantize(histogram, colors, entry.algorithm); KeepResult(palette); });
+            std::printf("%-8s %7d %10.3f %16.0f %8.2f\n", entry.name, colors, seconds * 1e3,
+                        1 / (seconds + histogram_seconds), Psnr(frame, palette));
+        }
+    }
+    return 0;
+}
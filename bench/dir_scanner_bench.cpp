@@ -0,0 +1,71 @@
+#include <cstdio>
+#include <filesystem>
+#include <string>
+#include <fcntl.h>
+#include <unistd.h>
+#include "dir_scanner.hpp"
+#include "frame_index.hpp"
+#include "bench_util.hpp"
+
+namespace fs = std::filesystem;
+
+// 目录扫描：getdents64 批量读取（ScanFrameDirectory）对比原先的 directory_iterator 循环
+// 用法：dir_scanner_bench [条目数...]，默认 10000 100000 1000000；目录建在临时目录下（最好是 tmpfs）
+//  - 约十分之一的条目是其他后缀的文件，用来覆盖后缀过滤
+
+// 原先 ScanFiles 中的实现
+static void ScanWithDirectoryIterator(const std::string &directory, const std::string &extension, FrameIndex &index)
+{
+    for (const auto &entry : fs::directory_iterator(directory))
+    {
+        if (entry.is_regular_file() && entry.path().extension() == "." + extension)
+            index.Add(entry.path().filename().string());
+    }
+}
+
+static bool CreateEntries(const std::string &directory, long count)
+{
+    for (long i = 0; i < count; i++)
+    {
+        char name[64];
+        std::snprintf(name, sizeof(name), "%s/image_%07ld.%s", directory.c_str(), i, i % 10 == 9 ? "txt" : "jpg");
+        int fd = ::open(name, O_WRONLY | O_CREAT | O_EXCL | O_CLOEXEC, 0644);
+        if (fd < 0)
+            return false;
+        ::close(fd);
+    }
+    return true;
+}
+
+int main(int argc, char **argv)
+{
+    const std::string extension = "jpg";
+    std::printf("%10s %14s %14s %9s\n", "entries", "iterator(ms)", "getdents(ms)", "speedup");
+    for (long count : SizesFromArgs(argc, argv, {10000, 100000, 1000000}))
+    {
+        std::string pattern = (fs::temp_directory_path() / "gifcmd_scan_XXXXXX").string();
+        if (!::mkdtemp(pattern.data()))
+            return 1;
+        const std::string directory = pattern;
+        if (!CreateEntries(directory, count))
+        {
+            std::fprintf(stderr, "无法创建 %ld 个文件\n", count);
+            fs::remove_all(directory);
+            return 1;
+        }
+
+        const int repeats = count >= 1000000 ? 3 : 10;
+        FrameIndex iterated, scanned;
+        double iterator_seconds = BenchSeconds(repeats, [&]
+                                               { iterated.Clear(); ScanWithDirectoryIterator(directory, extension, iterated); });
+        double getdents_seconds = BenchSeconds(repeats, [&]
+                                               { scanned.Clear(); ScanFrameDirectory(directory.c_str(), extension, scanned); });
+        if (iterated.size() != scanned.size())
+            std::fprintf(stderr, "结果不一致：%zu / %zu\n", iterated.size(), scanned.size());
+
+        std::printf("%10ld %14.2f %14.2f %8.2fx\n", count, iterator_seconds * 1e3, getdents_seconds * 1e3,
+                    iterator_seconds / getdents_seconds);
+        fs::remove_all(directory);
+    }
+    return 0;
+}
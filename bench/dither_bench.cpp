@@ -0,0 +1,58 @@
+#include <cstdio>
+#include <thread>
+#include <vector>
+#include "color_quantizer.hpp"
+#include "dither.hpp"
+#include "palette_mapper.hpp"
+#include "synthetic_image.hpp"
+#include "bench_util.hpp"
+
+// 抖动的线程扩展性：1920x1080 单帧，各方法在不同线程数下的每帧毫秒数和相对单线程的加速比
+// 同时核对各线程数的结果与单线程逐字节相同；加速比受CPU核数限制（运行时打印）
+// 用法：dither_bench [线程数...]，默认 1 2 4 8
+
+int main(int argc, char **argv)
+{
+    const int width = 1920, height = 1080;
+    RgbImage frame;
+    if (!FillSyntheticFrame(frame, width, height, 0))
+    {
+        std::fprintf(stderr, "无法分配 %dx%d 的帧\n", width, height);
+        return 1;
+    }
+    ColorHistogram histogram;
+    histogram.Add(frame);
+    const Palette palette = Quantize(histogram, 256, QuantizeAlgorithm::median_cut);
+    PaletteMapper mapper(palette);
+    std::vector<uint8_t> reference, indices;
+    mapper.Map(frame, indices); // 预先填充逆调色板表，只计抖动本身
+
+    const struct
+    {
+        const char *name;
+        DitherMethod method;
+    } methods[] = {
+        {"bayer", DitherMethod::bayer},
+        {"blue-noise", DitherMethod::blue_noise},
+        {"floyd", DitherMethod::floyd_steinberg},
+        {"sierra", DitherMethod::sierra},
+    };
+    const std::vector<long> thread_counts = SizesFromArgs(argc, argv, {1, 2, 4, 8});
+    std::printf("%dx%d, %u hardware threads\n%-11s %8s %10s %9s %6s\n", width, height,
+                std::thread::hardware_concurrency(), "method", "threads", "ms/frame", "speedup", "same");
+    for (const auto &entry : methods)
+    {
+        double single = 0;
+        DitherImage(frame, mapper, entry.method, reference, 1);
+        for (long threads : thread_counts)
+        {
+            double seconds = BenchSeconds(5, [&]
+                                          { DitherImage(frame, mapper, entry.method, indices, static_cast<size_t>(threads)); KeepResult(indices); });
+            if (single == 0)
+                single = seconds;
+            std::printf("%-11s %8ld %10.2f %8.2fx %6s\n", entry.name, threads, seconds * 1e3, single / seconds,
+                        indices == reference ? "yes" : "NO");
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,51 @@
+#include <cstdio>
+#include <random>
+#include <vector>
+#include "gif_lzw.hpp"
+#include "bench_util.hpp"
+
+// GIF LZW 压缩吞吐量（MB/s，按输入的索引字节计），单线程
+// 用法：gif_lzw_bench [输入字节数]，默认 16 MiB
+
+int main(int argc, char **argv)
+{
+    const size_t count = static_cast<size_t>(SizesFromArgs(argc, argv, {16 << 20})[0]);
+    struct Stream
+    {
+        const char *name;
+        int bits;
+        std::vector<uint8_t> indices;
+    };
+    std::vector<Stream> streams = {
+        {"random 8-bit", 8, {}},
+        {"random 4-bit", 4, {}},
+        {"runs 8-bit", 8, {}},
+        {"noise 8-bit", 8, {}},
+    };
+    std::mt19937 rng(12345);
+    for (Stream &stream : streams)
+    {
+        stream.indices.resize(count);
+        const uint32_t colors = 1u << stream.bits;
+        for (size_t i = 0; i < count; i++)
+        {
+            if (stream.name[0] == 'r' && stream.name[1] == 'a')
+                stream.indices[i] = static_cast<uint8_t>(rng() % colors);
+            else if (stream.name[0] == 'r')
+                stream.indices[i] = i > 0 && rng() % 64 != 0 ? stream.indices[i - 1] : static_cast<uint8_t>(rng() % colors);
+            else
+                stream.indices[i] = static_cast<uint8_t>(((i / 97) + rng() % 3) % colors);
+        }
+    }
+
+    GifLzwEncoder encoder;
+    std::vector<uint8_t> out;
+    std::printf("%-14s %10s %8s\n", "stream", "MB/s", "ratio");
+    for (const Stream &stream : streams)
+    {
+        double seconds = BenchSeconds(5, [&]
+                                      { encoder.Encode(stream.indices.data(), count, std::max(2, stream.bits), out); KeepResult(out); });
+        std::printf("%-14s %10.1f %8.3f\n", stream.name, count / seconds / 1e6, static_cast<double>(out.size()) / count);
+    }
+    return 0;
+}
@@ -0,0 +1,50 @@
+#include <cstdio>
+#include <vector>
+#include "image_resize.hpp"
+#include "synthetic_image.hpp"
+#include "bench_util.hpp"
+
+// 缩放耗时：每帧毫秒数，以及按输入像素计的每百万像素毫秒数；分别用标量、SSE4.1、AVX2 内核（CPU支持时）
+// 缩小倍数大于等于4时包含区域平均预缩小
+
+int main()
+{
+    struct Case
+    {
+        int src_width, src_height, width;
+    };
+    const Case cases[] = {
+        {3840, 2160, 640},
+        {1920, 1080, 480},
+        {1920, 1080, 960},
+        {1280, 720, 854},
+        {640, 360, 1280},
+    };
+    const SimdLevel best = DetectSimdLevel();
+    const char *level_names[] = {"scalar", "sse4.1", "avx2"};
+
+    RgbImage src, dst;
+    std::printf("%-22s %-7s %10s %12s\n", "resize", "kernel", "ms/frame", "ms/MP(in)");
+    for (const Case &c : cases)
+    {
+        if (!FillSyntheticFrame(src, c.src_width, c.src_height, 1))
+        {
+            std::fprintf(stderr, "无法分配 %dx%d 的帧\n", c.src_width, c.src_height);
+            return 1;
+        }
+        const int height = ScaledHeight(c.src_width, c.src_height, c.width);
+        const double megapixels = static_cast<double>(c.src_width) * c.src_height / 1e6;
+        for (SimdLevel level : {SimdLevel::scalar, SimdLevel::sse41, SimdLevel::avx2})
+        {
+            if (level > best)
+                continue;
+            double seconds = BenchSeconds(10, [&]
+                                          { ResizeImage(src, c.width, height, dst, ResizeFilter::lanczos, level); KeepResult(dst); });
+            char name[32];
+            std::snprintf(name, sizeof(name), "%dx%d->%dx%d", c.src_width, c.src_height, c.width, height);
+            std::printf("%-22s %-7s %10.2f %12.2f\n", name, level_names[static_cast<int>(level)], seconds * 1e3,
+                        seconds * 1e3 / megapixels);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,72 @@
+#include <cstdio>
+#include <vector>
+#include "color_quantizer.hpp"
+#include "palette_mapper.hpp"
+#include "synthetic_image.hpp"
+#include "bench_util.hpp"
+
+// 最近颜色映射：PaletteMapper 对比逐个比较全部调色板颜色，百万像素每秒
+// cold 为新建映射器后的第一帧（含逆调色板表的惰性填充），warm 为之后的帧；同时核对结果与逐个比较相同
+
+int main()
+{
+    const int width = 640, height = 360;
+    RgbImage frame;
+    if (!FillSyntheticFrame(frame, width, height, 0))
+    {
+        std::fprintf(stderr, "无法分配 %dx%d 的帧\n", width, height);
+        return 1;
+    }
+    ColorHistogram histogram;
+    histogram.Add(frame);
+    const double megapixels = static_cast<double>(width) * height / 1e6;
+
+    std::printf("%dx%d\n%-7s %12s %12s %12s %12s %9s %6s\n", width, height, "colors", "brute MP/s", "cold MP/s",
+                "scalar MP/s", "avx2 MP/s", "speedup", "same");
+    std::vector<uint8_t> expected, indices;
+    for (int colors : {16, 64, 256})
+    {
+        const Palette palette = Quantize(histogram, colors, QuantizeAlgorithm::median_cut);
+
+        double brute = BenchSeconds(3, [&]
+                                    {
+            expected.resize(static_cast<size_t>(width) * height);
+            for (int y = 0; y < height; y++)
+            {
+                const uint8_t *p = frame.Row(y);
+                for (int x = 0; x < width; x++, p += 3)
+                {
+                    int best = 0, best_distance = 1 << 30;
+                    for (int i = 0; i < palette.size; i++)
+                    {
+                        int dr = p[0] - palette.colors[i][0], dg = p[1] - palette.colors[i][1], db = p[2] - palette.colors[i][2];
+                        int d = dr * dr + dg * dg + db * db;
+                        if (d < best_distance)
+                        {
+                            best = i;
+                            best_distance = d;
+                        }
+                    }
+                    expected[static_cast<size_t>(y) * width + x] = static_cast<uint8_t>(best);
+                }
+            }
+            KeepResult(expected); });
+
+        double cold = BenchSeconds(5, [&]
+                                   { PaletteMapper mapper(palette); mapper.Map(frame, indices); KeepResult(indices); });
+        PaletteMapper mapper(palette);
+        mapper.Map(frame, indices);
+        const bool same = indices == expected;
+        double scalar = BenchSeconds(10, [&]
+                                     {
+            for (int y = 0; y < height; y++)
+                mapper.MapRow(frame.Row(y), width, indices.data() + static_cast<size_t>(y) * width, SimdLevel::scalar);
+            KeepResult(indices); });
+        double simd = BenchSeconds(10, [&]
+                                   { mapper.Map(frame, indices); KeepResult(indices); });
+
+        std::printf("%-7d %12.1f %12.1f %12.1f %12.1f %8.1fx %6s\n", palette.size, megapixels / brute, megapixels / cold,
+                    megapixels / scalar, megapixels / simd, brute / simd, same ? "yes" : "NO");
+    }
+    return 0;
+}
@@ -0,0 +1,430 @@
+#ifndef GIFCMD_COLOR_QUANTIZER_HPP
+#define GIFCMD_COLOR_QUANTIZER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "cpu_features.hpp"
+#include "image_decode.hpp"
+
+// 调色板：最多256种颜色
+struct Palette
+{
+    int size = 0;
+    uint8_t colors[256][3] = {};
+};
+
+// 量化算法：中位切分、八叉树，或中位切分后做K均值细化
+enum class QuantizeAlgorithm
+{
+    median_cut,
+    octree,
+    kmeans,
+};
+
+namespace color_histogram_detail
+{
+    // 每批计算的桶下标数：先批量算下标（可向量化），再逐个累加
+    const size_t batch = 256;
+
+    inline void BucketsScalar(const uint8_t *p, size_t n, uint32_t *out)
+    {
+        for (size_t i = 0; i < n; i++, p += 3)
+            out[i] = ((p[0] >> 3) << 10) | ((p[1] >> 3) << 5) | (p[2] >> 3);
+    }
+
+#ifdef GIFCMD_X86
+    // 把每个像素 (r g b) 放进一个32位通道 r | g << 8 | b << 16，再用移位和掩码拼出15位桶下标
+    GIFCMD_TARGET_SSE41 inline __m128i PixelToLaneMask()
+    {
+        return _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1);
+    }
+
+    GIFCMD_TARGET_SSE41 inline __m128i BucketLanesSse41(__m128i v)
+    {
+        __m128i r = _mm_slli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF8)), 7);
+        __m128i g = _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF800)), 6);
+        __m128i b = _mm_srli_epi32(_mm_and_si128(v, _mm_set1_epi32(0xF80000)), 19);
+        return _mm_or_si128(_mm_or_si128(r, g), b);
+    }
+
+    // 每次读16字节、处理4个像素，末尾不足16字节的部分用标量实现
+    GIFCMD_TARGET_SSE41 inline void BucketsSse41(const uint8_t *p, size_t n, uint32_t *out)
+    {
+        const __m128i mask = PixelToLaneMask();
+        size_t i = 0;
+        for (; i + 6 <= n; i += 4)
+        {
+            __m128i v = _mm_shuffle_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(p + i * 3)), mask);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), BucketLanesSse41(v));
+        }
+        BucketsScalar(p + i * 3, n - i, out + i);
+    }
+
+    // 每次处理8个像素：低128位通道取像素0-3，高通道取像素4-7
+    GIFCMD_TARGET_AVX2 inline void BucketsAvx2(const uint8_t *p, size_t n, uint32_t *out)
+    {
+        const __m256i mask = _mm256_broadcastsi128_si256(PixelToLaneMask());
+        size_t i = 0;
+        for (; i + 10 <= n; i += 8)
+        {
+            const uint8_t *q = p + i * 3;
+            __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(q))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(q + 12)), 1);
+            v = _mm256_shuffle_epi8(v, mask);
+            __m256i r = _mm256_slli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xF8)), 7);
+            __m256i g = _mm256_srli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xF800)), 6);
+            __m256i b = _mm256_srli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xF80000)), 19);
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_or_si256(_mm256_or_si256(r, g), b));
+        }
+        BucketsScalar(p + i * 3, n - i, out + i);
+    }
+#endif
+
+    inline void Buckets(SimdLevel level, const uint8_t *p, size_t n, uint32_t *out)
+    {
+#ifdef GIFCMD_X86
+        if (level == SimdLevel::avx2)
+            return BucketsAvx2(p, n, out);
+        if (level == SimdLevel::sse41)
+            return BucketsSse41(p, n, out);
+#endif
+        BucketsScalar(p, n, out);
+    }
+}
+
+// 每通道5位的颜色直方图（32768个桶）
+// 一个直方图只由一个线程写入；多线程统计时每个线程（或每帧）一个直方图，最后用 Merge 合并
+class ColorHistogram
+{
+public:
+    ColorHistogram() : counts_(1 << 15, 0) {}
+
+    static int Bucket(const uint8_t *rgb) { return ((rgb[0] >> 3) << 10) | ((rgb[1] >> 3) << 5) | (rgb[2] >> 3); }
+
+    void Add(const RgbImage &image, SimdLevel level = DetectSimdLevel())
+    {
+        using namespace color_histogram_detail;
+        const size_t n = static_cast<size_t>(image.width);
+        uint32_t buckets[batch];
+        for (int y = 0; y < image.height; y++)
+        {
+            const uint8_t *p = image.Row(y);
+            for (size_t done = 0; done < n; done += batch)
+            {
+                size_t count = std::min(batch, n - done);
+                Buckets(level, p + done * 3, count, buckets);
+                for (size_t i = 0; i < count; i++)
+                    counts_[buckets[i]]++;
+            }
+        }
+        total_ += n * image.height;
+    }
+
+    void Merge(const ColorHistogram &other)
+    {
+        for (size_t i = 0; i < counts_.size(); i++)
+            counts_[i] += other.counts_[i];
+        total_ += other.total_;
+    }
+
+    void Clear()
+    {
+        std::fill(counts_.begin(), counts_.end(), 0);
+        total_ = 0;
+    }
+
+    const std::vector<uint64_t> &counts() const { return counts_; }
+    uint64_t total() const { return total_; }
+
+private:
+    std::vector<uint64_t> counts_;
+    uint64_t total_ = 0;
+};
+
+namespace color_quantizer_detail
+{
+    // 中位切分的一个颜色盒：histogram 中非空桶的下标区间
+    struct Box
+    {
+        size_t begin, end;
+        uint64_t weight;
+    };
+
+    inline int Channel(int bucket, int c) { return (bucket >> (10 - 5 * c)) & 31; }
+
+    // 桶中心的颜色值
+    inline int BucketColor(int bucket, int c) { return Channel(bucket, c) * 8 + 4; }
+}
+
+// 中位切分：每次切开像素最多的盒子（沿跨度最大的通道、按像素数中位切分），每个盒子取加权平均色
+inline Palette MedianCut(const ColorHistogram &histogram, int max_colors)
+{
+    using namespace color_quantizer_detail;
+
+    std::vector<int> buckets;
+    const auto &counts = histogram.counts();
+    for (int i = 0; i < static_cast<int>(counts.size()); i++)
+    {
+        if (counts[i])
+            buckets.push_back(i);
+    }
+
+    Palette palette;
+    if (buckets.empty())
+    {
+        palette.size = 1;
+        return palette;
+    }
+
+    std::vector<Box> boxes;
+    uint64_t total = 0;
+    for (int b : buckets)
+        total += counts[b];
+    boxes.push_back({0, buckets.size(), total});
+
+    max_colors = std::clamp(max_colors, 2, 256);
+    while (static_cast<int>(boxes.size()) < max_colors)
+    {
+        // 选择可以切分且像素最多的盒子
+        int chosen = -1;
+        for (size_t i = 0; i < boxes.size(); i++)
+        {
+            if (boxes[i].end - boxes[i].begin > 1 && (chosen < 0 || boxes[i].weight > boxes[chosen].weight))
+                chosen = static_cast<int>(i);
+        }
+        if (chosen < 0)
+            break;
+
+        Box box = boxes[chosen];
+        int lo[3] = {31, 31, 31}, hi[3] = {0, 0, 0};
+        for (size_t i = box.begin; i < box.end; i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                lo[c] = std::min(lo[c], Channel(buckets[i], c));
+                hi[c] = std::max(hi[c], Channel(buckets[i], c));
+            }
+        }
+        int axis = 0;
+        for (int c = 1; c < 3; c++)
+        {
+            if (hi[c] - lo[c] > hi[axis] - lo[axis])
+                axis = c;
+        }
+        std::sort(buckets.begin() + box.begin, buckets.begin() + box.end, [axis](int a, int b)
+                  { return Channel(a, axis) < Channel(b, axis); });
+
+        // 按像素数找中位位置，两侧都至少保留一个桶
+        uint64_t half = box.weight / 2, acc = 0;
+        size_t split = box.begin;
+        while (split < box.end - 1 && acc + counts[buckets[split]] <= half)
+            acc += counts[buckets[split++]];
+        if (split == box.begin)
+            acc += counts[buckets[split++]];
+
+        boxes[chosen] = {box.begin, split, acc};
+        boxes.push_back({split, box.end, box.weight - acc});
+    }
+
+    palette.size = static_cast<int>(boxes.size());
+    for (size_t i = 0; i < boxes.size(); i++)
+    {
+        uint64_t sum[3] = {0, 0, 0}, weight = 0;
+        for (size_t j = boxes[i].begin; j < boxes[i].end; j++)
+        {
+            uint64_t w = counts[buckets[j]];
+            for (int c = 0; c < 3; c++)
+                sum[c] += w * BucketColor(buckets[j], c);
+            weight += w;
+        }
+        for (int c = 0; c < 3; c++)
+            palette.colors[i][c] = static_cast<uint8_t>(weight ? sum[c] / weight : 0);
+    }
+    return palette;
+}
+
+// 八叉树：非空桶按各通道的5位从高到低插入深度为5的树，再从最深层开始合并像素最少的节点，直到叶子数不超过 max_colors
+inline Palette OctreeQuantize(const ColorHistogram &histogram, int max_colors)
+{
+    using namespace color_quantizer_detail;
+
+    struct Node
+    {
+        uint64_t weight = 0;
+        uint64_t sum[3] = {0, 0, 0};
+        int children[8] = {-1, -1, -1, -1, -1, -1, -1, -1};
+        int depth = 0;
+        bool leaf = false;
+    };
+    std::vector<Node> nodes(1);
+    const auto &counts = histogram.counts();
+    int leaves = 0;
+    for (int bucket = 0; bucket < static_cast<int>(counts.size()); bucket++)
+    {
+        uint64_t w = counts[bucket];
+        if (!w)
+            continue;
+        int node = 0;
+        for (int level = 0; level < 5; level++)
+        {
+            nodes[node].weight += w;
+            for (int c = 0; c < 3; c++)
+                nodes[node].sum[c] += w * BucketColor(bucket, c);
+            int shift = 4 - level;
+            int child = (((Channel(bucket, 0) >> shift) & 1) << 2) | (((Channel(bucket, 1) >> shift) & 1) << 1) |
+                        ((Channel(bucket, 2) >> shift) & 1);
+            if (nodes[node].children[child] < 0)
+            {
+                nodes[node].children[child] = static_cast<int>(nodes.size());
+                Node created;
+                created.depth = level + 1;
+                nodes.push_back(created);
+            }
+            node = nodes[node].children[child];
+        }
+        nodes[node].weight = w;
+        for (int c = 0; c < 3; c++)
+            nodes[node].sum[c] = w * BucketColor(bucket, c);
+        nodes[node].leaf = true;
+        leaves++;
+    }
+
+    // 逐层合并：同一层中像素少的节点先合并（其子节点此时都是叶子）
+    max_colors = std::clamp(max_colors, 2, 256);
+    for (int depth = 4; depth >= 0 && leaves > max_colors; depth--)
+    {
+        std::vector<int> level;
+        for (int i = 0; i < static_cast<int>(nodes.size()); i++)
+        {
+            if (nodes[i].depth == depth && !nodes[i].leaf)
+                level.push_back(i);
+        }
+        std::sort(level.begin(), level.end(), [&](int a, int b)
+                  { return nodes[a].weight < nodes[b].weight; });
+        for (int i : level)
+        {
+            if (leaves <= max_colors)
+                break;
+            int merged = 0;
+            for (int &child : nodes[i].children)
+            {
+                if (child >= 0)
+                {
+                    merged++;
+                    child = -1;
+                }
+            }
+            nodes[i].leaf = true;
+            leaves -= merged - 1;
+        }
+    }
+
+    // 已合并节点的子树不再可达，只取从根可达的叶子
+    Palette palette;
+    std::vector<int> stack = {0};
+    while (!stack.empty())
+    {
+        const Node &node = nodes[stack.back()];
+        stack.pop_back();
+        if (node.leaf)
+        {
+            for (int c = 0; c < 3; c++)
+                palette.colors[palette.size][c] = static_cast<uint8_t>(node.sum[c] / node.weight);
+            palette.size++;
+            continue;
+        }
+        for (int child : node.children)
+        {
+            if (child >= 0)
+                stack.push_back(child);
+        }
+    }
+    if (palette.size == 0)
+        palette.size = 1;
+    return palette;
+}
+
+// K均值细化：以 palette 为初始中心，对非空桶（按像素数加权）迭代分配和重算中心，中心不再移动时提前结束
+inline void KMeansRefine(const ColorHistogram &histogram, Palette &palette, int iterations = 8)
+{
+    using namespace color_quantizer_detail;
+
+    std::vector<int> buckets;
+    const auto &counts = histogram.counts();
+    for (int i = 0; i < static_cast<int>(counts.size()); i++)
+    {
+        if (counts[i])
+            buckets.push_back(i);
+    }
+    if (buckets.empty() || palette.size < 2)
+        return;
+
+    std::vector<int> center(palette.size * 3);
+    for (int i = 0; i < palette.size; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            center[i * 3 + c] = palette.colors[i][c];
+    }
+    std::vector<uint64_t> sums(palette.size * 4);
+    for (int iteration = 0; iteration < iterations; iteration++)
+    {
+        std::fill(sums.begin(), sums.end(), 0);
+        for (int bucket : buckets)
+        {
+            int r = BucketColor(bucket, 0), g = BucketColor(bucket, 1), b = BucketColor(bucket, 2);
+            int best = 0, best_distance = 1 << 30;
+            for (int i = 0; i < palette.size; i++)
+            {
+                int dr = r - center[i * 3], dg = g - center[i * 3 + 1], db = b - center[i * 3 + 2];
+                int distance = dr * dr + dg * dg + db * db;
+                if (distance < best_distance)
+                {
+                    best_distance = distance;
+                    best = i;
+                }
+            }
+            uint64_t w = counts[bucket];
+            sums[best * 4] += w * r;
+            sums[best * 4 + 1] += w * g;
+            sums[best * 4 + 2] += w * b;
+            sums[best * 4 + 3] += w;
+        }
+
+        bool moved = false;
+        for (int i = 0; i < palette.size; i++)
+        {
+            uint64_t w = sums[i * 4 + 3];
+            if (!w)
+                continue; // 没有分到颜色的中心保持不动
+            for (int c = 0; c < 3; c++)
+            {
+                int value = static_cast<int>((sums[i * 4 + c] + w / 2) / w);
+                moved = moved || value != center[i * 3 + c];
+                center[i * 3 + c] = value;
+            }
+        }
+        if (!moved)
+            break;
+    }
+    for (int i = 0; i < palette.size; i++)
+    {
+        for (int c = 0; c < 3; c++)
+            palette.colors[i][c] = static_cast<uint8_t>(center[i * 3 + c]);
+    }
+}
+
+// 按所选算法由直方图生成最多 max_colors 色的调色板
+inline Palette Quantize(const ColorHistogram &histogram, int max_colors, QuantizeAlgorithm algorithm)
+{
+    if (algorithm == QuantizeAlgorithm::octree)
+        return OctreeQuantize(histogram, max_colors);
+    Palette palette = MedianCut(histogram, max_colors);
+    if (algorithm == QuantizeAlgorithm::kmeans)
+        KMeansRefine(histogram, palette);
+    return palette;
+}
+
+#endif // GIFCMD_COLOR_QUANTIZER_HPP
@@ -0,0 +1,37 @@
+#ifndef GIFCMD_CPU_FEATURES_HPP
+#define GIFCMD_CPU_FEATURES_HPP
+
+// 运行时选择SIMD内核：x86上按CPU支持的指令集选择AVX2或SSE4.1实现，其余平台只用标量实现
+// 内核函数用 __attribute__((target(...))) 单独编译，不需要给整个程序加 -mavx2
+#if defined(__x86_64__) || defined(__i386__)
+#define GIFCMD_X86 1
+#include <immintrin.h>
+#define GIFCMD_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define GIFCMD_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+enum class SimdLevel
+{
+    scalar,
+    sse41,
+    avx2,
+};
+
+// 当前CPU支持的最高级别（只检测一次）
+inline SimdLevel DetectSimdLevel()
+{
+    static const SimdLevel level = []
+    {
+#ifdef GIFCMD_X86
+        __builtin_cpu_init();
+        if (__builtin_cpu_supports("avx2"))
+            return SimdLevel::avx2;
+        if (__builtin_cpu_supports("sse4.1"))
+            return SimdLevel::sse41;
+#endif
+        return SimdLevel::scalar;
+    }();
+    return level;
+}
+
+#endif // GIFCMD_CPU_FEATURES_HPP
@@ -0,0 +1,104 @@
+#ifndef GIFCMD_DIR_SCANNER_HPP
+#define GIFCMD_DIR_SCANNER_HPP
+
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <filesystem>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#ifdef __linux__
+#include <dirent.h>
+#include <sys/syscall.h>
+#endif
+#include "frame_index.hpp"
+
+// 文件名是否以 "." + extension 结尾（直接比较原始字节）
+inline bool HasFrameExtension(std::string_view name, std::string_view extension)
+{
+    return name.size() > extension.size() &&
+           name[name.size() - extension.size() - 1] == '.' &&
+           std::memcmp(name.data() + name.size() - extension.size(), extension.data(), extension.size()) == 0;
+}
+
+#ifdef __linux__
+// getdents64 返回的原始目录项（glibc 未导出该结构）
+struct LinuxDirent64
+{
+    ino64_t d_ino;
+    off64_t d_off;
+    unsigned short d_reclen;
+    unsigned char d_type;
+    char d_name[];
+};
+
+// 按内核顺序批量读取目录项，对每个匹配后缀的普通文件调用 fn(dirfd, name, d_ino)
+// d_type 为 DT_REG 时不做 stat，仅 DT_UNKNOWN/DT_LNK 回退到 fstatat
+template <class Fn>
+bool ScanDirectoryEntries(int dirfd, std::string_view extension, Fn &&fn)
+{
+    // 从开头读取，允许同一个fd重复扫描
+    ::lseek(dirfd, 0, SEEK_SET);
+
+    alignas(8) static thread_local char buffer[1 << 16];
+    for (;;)
+    {
+        long n = ::syscall(SYS_getdents64, dirfd, buffer, sizeof(buffer));
+        if (n < 0)
+            return false;
+        if (n == 0)
+            return true;
+
+        for (long offset = 0; offset < n;)
+        {
+            auto *entry = reinterpret_cast<LinuxDirent64 *>(buffer + offset);
+            offset += entry->d_reclen;
+
+            std::string_view name(entry->d_name);
+            if (!HasFrameExtension(name, extension))
+                continue;
+
+            if (entry->d_type == DT_UNKNOWN || entry->d_type == DT_LNK)
+            {
+                struct stat st;
+                if (::fstatat(dirfd, entry->d_name, &st, 0) != 0 || !S_ISREG(st.st_mode))
+                    continue;
+            }
+            else if (entry->d_type != DT_REG)
+            {
+                continue;
+            }
+
+            fn(dirfd, name, static_cast<uint64_t>(entry->d_ino));
+        }
+    }
+}
+#endif
+
+// 扫描目录并填充帧索引（不为每个目录项分配 std::filesystem::path）
+// 非Linux平台回退到 std::filesystem
+inline bool ScanFrameDirectory(const char *directory, std::string_view extension, FrameIndex &index)
+{
+#ifdef __linux__
+    int dirfd = ::open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+        return false;
+
+    bool ok = ScanDirectoryEntries(dirfd, extension, [&](int, std::string_view name, uint64_t)
+                                   { index.Add(name); });
+    ::close(dirfd);
+    return ok;
+#else
+    std::error_code ec;
+    std::string dot_extension = "." + std::string(extension);
+    for (const auto &entry : std::filesystem::directory_iterator(directory, ec))
+    {
+        if (entry.is_regular_file(ec) && entry.path().extension() == dot_extension)
+            index.Add(entry.path().filename().string());
+    }
+    return !ec;
+#endif
+}
+
+#endif // GIFCMD_DIR_SCANNER_HPP
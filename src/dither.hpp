@@ -0,0 +1,388 @@
+#ifndef GIFCMD_DITHER_HPP
+#define GIFCMD_DITHER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <memory>
+#include <thread>
+#include <vector>
+#include "cpu_features.hpp"
+#include "image_decode.hpp"
+#include "palette_mapper.hpp"
+
+// 抖动：在量化（生成调色板）之后、映射为调色板下标时使用
+//  - 有序抖动（Bayer 8x8 / 蓝噪声 64x64）：按位置给像素加阈值偏移再查表，各行互不依赖，按行分给各线程；
+//    加偏移的循环为SIMD内核
+//  - 误差扩散（Floyd-Steinberg / Sierra）：波前并行，第 y 行由线程 y % threads 处理，
+//    上一行处理到 x + 2 之后（扩散核在下一行最远到 x + 2）第 y 行才能处理 x，各行像阶梯一样同时推进
+enum class DitherMethod
+{
+    none,
+    bayer,
+    blue_noise,
+    floyd_steinberg,
+    sierra,
+};
+
+namespace dither_detail
+{
+    const int wavefront_chunk = 64; // 误差扩散每处理这么多像素发布一次进度
+
+    // 误差扩散核：分子之和等于 1 << shift，权重为编译期常量，为0的项不生成代码
+    struct FloydSteinbergKernel
+    {
+        static constexpr int shift = 4;
+        static constexpr int right[2] = {7, 0};      // 本行 x+1, x+2
+        static constexpr int next[5] = {0, 3, 5, 1, 0}; // 下一行 x-2 .. x+2
+        static constexpr int next2[3] = {0, 0, 0};    // 下两行 x-1 .. x+1
+        static constexpr bool two_rows = false;       // 是否扩散到下两行
+    };
+    struct SierraKernel
+    {
+        static constexpr int shift = 5;
+        static constexpr int right[2] = {5, 3};
+        static constexpr int next[5] = {2, 4, 5, 4, 2};
+        static constexpr int next2[3] = {2, 3, 2};
+        static constexpr bool two_rows = true;
+    };
+
+    // 8x8 Bayer 矩阵（0-63）
+    inline int Bayer(int x, int y)
+    {
+        int value = 0;
+        for (int bit = 2; bit >= 0; bit--)
+        {
+            int bx = (x >> (2 - bit)) & 1, by = (y >> (2 - bit)) & 1;
+            value |= (((bx ^ by) << 1) | by) << (2 * bit);
+        }
+        return value;
+    }
+
+    // 64x64 蓝噪声阈值（0-4095），void-and-cluster 生成（环面上的高斯能量，sigma = 1.5），只生成一次
+    inline const std::vector<uint16_t> &BlueNoise()
+    {
+        static const std::vector<uint16_t> ranks = []
+        {
+            const int size = 64, count = size * size;
+            std::vector<float> kernel(count);
+            for (int dy = 0; dy < size; dy++)
+            {
+                for (int dx = 0; dx < size; dx++)
+                {
+                    int wx = std::min(dx, size - dx), wy = std::min(dy, size - dy);
+                    kernel[dy * size + dx] = std::exp(-(wx * wx + wy * wy) / (2 * 1.5f * 1.5f));
+                }
+            }
+            std::vector<float> energy(count, 0);
+            std::vector<char> bits(count, 0);
+            auto toggle = [&](int p, bool on)
+            {
+                int px = p % size, py = p / size;
+                float sign = on ? 1.0f : -1.0f;
+                for (int y = 0; y < size; y++)
+                {
+                    const float *row = kernel.data() + ((y - py) & (size - 1)) * size;
+                    for (int x = 0; x < size; x++)
+                        energy[y * size + x] += sign * row[(x - px) & (size - 1)];
+                }
+                bits[p] = on;
+            };
+            // 已置位点中能量最大的（最密的簇）或空位中能量最小的（最大的空洞）
+            auto extreme = [&](bool cluster)
+            {
+                int best = -1;
+                for (int p = 0; p < count; p++)
+                {
+                    if (bits[p] == cluster &&
+                        (best < 0 || (cluster ? energy[p] > energy[best] : energy[p] < energy[best])))
+                        best = p;
+                }
+                return best;
+            };
+
+            // 初始图案：约10%的点（固定种子的线性同余序列），再反复把最密的点移到最大的空洞中直到稳定
+            uint32_t seed = 1;
+            int ones = 0;
+            while (ones < count / 10)
+            {
+                seed = seed * 1664525u + 1013904223u;
+                int p = static_cast<int>(seed >> 20);
+                if (!bits[p])
+                {
+                    toggle(p, true);
+                    ones++;
+                }
+            }
+            for (;;)
+            {
+                int cluster = extreme(true);
+                toggle(cluster, false);
+                int hole = extreme(false);
+                if (hole == cluster)
+                {
+                    toggle(cluster, true);
+                    break;
+                }
+                toggle(hole, true);
+            }
+
+            // 初始点按从密到疏的顺序取较小的阈值，其余空位按从大到小的空洞依次取后面的阈值
+            std::vector<uint16_t> result(count);
+            std::vector<char> prototype = bits;
+            std::vector<float> prototype_energy = energy;
+            for (int rank = ones - 1; rank >= 0; rank--)
+            {
+                int cluster = extreme(true);
+                toggle(cluster, false);
+                result[cluster] = static_cast<uint16_t>(rank);
+            }
+            bits = prototype;
+            energy = prototype_energy;
+            for (int rank = ones; rank < count; rank++)
+            {
+                int hole = extreme(false);
+                toggle(hole, true);
+                result[hole] = static_cast<uint16_t>(rank);
+            }
+            return result;
+        }();
+        return ranks;
+    }
+
+    // 有序抖动的阈值偏移：幅度为调色板颜色在每个通道上的平均间距
+    inline int8_t Offset(double threshold, int palette_size)
+    {
+        double spread = 255.0 / std::cbrt(std::max(palette_size, 2));
+        return static_cast<int8_t>(std::clamp(std::lround((threshold - 0.5) * spread), -127L, 127L));
+    }
+
+    // dst[i] = clamp(src[i] + offsets[i], 0, 255)
+    inline void AddOffsetsScalar(const uint8_t *src, const int8_t *offsets, size_t n, uint8_t *dst)
+    {
+        for (size_t i = 0; i < n; i++)
+            dst[i] = static_cast<uint8_t>(std::clamp(src[i] + offsets[i], 0, 255));
+    }
+
+#ifdef GIFCMD_X86
+    // 像素异或 0x80 转为有符号数后做饱和加法，再异或回来
+    GIFCMD_TARGET_SSE41 inline void AddOffsetsSse41(const uint8_t *src, const int8_t *offsets, size_t n, uint8_t *dst)
+    {
+        const __m128i bias = _mm_set1_epi8(static_cast<char>(0x80));
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i v = _mm_xor_si128(_mm_loadu_si128(reinterpret_cast<const __m128i *>(src + i)), bias);
+            v = _mm_adds_epi8(v, _mm_loadu_si128(reinterpret_cast<const __m128i *>(offsets + i)));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(dst + i), _mm_xor_si128(v, bias));
+        }
+        AddOffsetsScalar(src + i, offsets + i, n - i, dst + i);
+    }
+
+    GIFCMD_TARGET_AVX2 inline void AddOffsetsAvx2(const uint8_t *src, const int8_t *offsets, size_t n, uint8_t *dst)
+    {
+        const __m256i bias = _mm256_set1_epi8(static_cast<char>(0x80));
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i v = _mm256_xor_si256(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(src + i)), bias);
+            v = _mm256_adds_epi8(v, _mm256_loadu_si256(reinterpret_cast<const __m256i *>(offsets + i)));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(dst + i), _mm256_xor_si256(v, bias));
+        }
+        AddOffsetsScalar(src + i, offsets + i, n - i, dst + i);
+    }
+#endif
+
+    inline void AddOffsets(SimdLevel level, const uint8_t *src, const int8_t *offsets, size_t n, uint8_t *dst)
+    {
+#ifdef GIFCMD_X86
+        if (level == SimdLevel::avx2)
+            return AddOffsetsAvx2(src, offsets, n, dst);
+        if (level == SimdLevel::sse41)
+            return AddOffsetsSse41(src, offsets, n, dst);
+#endif
+        AddOffsetsScalar(src, offsets, n, dst);
+    }
+
+    // 在 threads 个线程中执行 work(t)（t = 0 在调用线程中执行）
+    template <class Work>
+    void RunThreads(size_t threads, Work &&work)
+    {
+        std::vector<std::thread> pool;
+        for (size_t t = 1; t < threads; t++)
+            pool.emplace_back(work, t);
+        work(0);
+        for (auto &thread : pool)
+            thread.join();
+    }
+
+    // 有序抖动：矩阵边长 period，阈值 thresholds[y * period + x]（0-1）
+    inline void OrderedDither(const RgbImage &image, const PaletteMapper &mapper, const std::vector<float> &thresholds,
+                              int period, size_t threads, SimdLevel level, uint8_t *indices)
+    {
+        const int width = image.width, height = image.height;
+        const int palette_size = mapper.palette().size;
+
+        // 每个矩阵行展开为一整行（每像素3个通道相同的偏移）；缓冲区按线程复用，其他线程通过指针访问调用线程的缓冲区
+        thread_local std::vector<int8_t> pattern_buffer;
+        pattern_buffer.resize(static_cast<size_t>(period) * width * 3);
+        const int8_t *pattern = pattern_buffer.data();
+        for (int y = 0; y < period; y++)
+        {
+            int8_t *row = pattern_buffer.data() + static_cast<size_t>(y) * width * 3;
+            for (int x = 0; x < width; x++)
+                row[x * 3] = row[x * 3 + 1] = row[x * 3 + 2] = Offset(thresholds[y * period + x % period], palette_size);
+        }
+
+        RunThreads(threads, [&](size_t t)
+                   {
+            thread_local std::vector<uint8_t> shifted;
+            shifted.resize(static_cast<size_t>(width) * 3);
+            for (int y = static_cast<int>(t); y < height; y += static_cast<int>(threads))
+            {
+                AddOffsets(level, image.Row(y), pattern + static_cast<size_t>(y % period) * width * 3,
+                           shifted.size(), shifted.data());
+                mapper.MapRow(shifted.data(), width, indices + static_cast<size_t>(y) * width, level);
+            } });
+    }
+
+    // 误差扩散（波前并行）
+    // 误差按分子累计：next[r] 为第 r 行扩散给下一行的误差，next2[r] 为扩散给下两行的误差，
+    // 分开存放使每个缓冲区只有一个线程写入；读取后清零，缓冲区按3行循环使用
+    // （第 y + 3 行写入时，第 y + 1、y + 2 行已经读过并清零了对应位置；第一行之前的行对应初始为0的缓冲区）
+    template <class Kernel>
+    void DiffusionDither(const RgbImage &image, const PaletteMapper &mapper, size_t threads, uint8_t *indices)
+    {
+        const int width = image.width, height = image.height;
+        const int ring = 3, pad = 2;
+        const size_t stride = (static_cast<size_t>(width) + 2 * pad) * 3;
+        // 缓冲区按线程复用，其他线程通过指针访问调用线程的缓冲区
+        thread_local std::vector<int> next_buffer, next2_buffer;
+        thread_local std::unique_ptr<std::atomic<int>[]> progress_buffer;
+        thread_local int progress_capacity = 0;
+        next_buffer.assign(ring * stride, 0);
+        next2_buffer.assign(ring * stride, 0);
+        if (progress_capacity < height)
+        {
+            progress_buffer.reset(new std::atomic<int>[height]);
+            progress_capacity = height;
+        }
+        int *next = next_buffer.data(), *next2 = next2_buffer.data();
+        std::atomic<int> *progress = progress_buffer.get();
+        for (int y = 0; y < height; y++)
+            progress[y].store(0, std::memory_order_relaxed);
+        const Palette &palette = mapper.palette();
+        const int round = 1 << (Kernel::shift - 1);
+
+        RunThreads(threads, [&](size_t t)
+                   {
+            for (int y = static_cast<int>(t); y < height; y += static_cast<int>(threads))
+            {
+                int *in1 = next + ((y + ring - 1) % ring) * stride;
+                int *in2 = next2 + ((y + ring - 2) % ring) * stride;
+                int *out1 = next + (y % ring) * stride;
+                int *out2 = next2 + (y % ring) * stride;
+                const uint8_t *src = image.Row(y);
+                uint8_t *dst = indices + static_cast<size_t>(y) * width;
+                int carry[2][3] = {{0, 0, 0}, {0, 0, 0}}; // 本行扩散给 x+1、x+2 的误差
+
+                for (int begin = 0; begin < width; begin += wavefront_chunk)
+                {
+                    int end = std::min(width, begin + wavefront_chunk);
+                    if (y >= 1)
+                    {
+                        int needed = std::min(width, end + 2);
+                        while (progress[y - 1].load(std::memory_order_acquire) < needed)
+                            std::this_thread::yield();
+                    }
+                    for (int x = begin; x < end; x++)
+                    {
+                        const size_t at = static_cast<size_t>(x + pad) * 3;
+                        uint8_t color[3];
+                        for (int c = 0; c < 3; c++)
+                        {
+                            int error = in1[at + c] + carry[0][c];
+                            in1[at + c] = 0;
+                            if (Kernel::two_rows)
+                            {
+                                error += in2[at + c];
+                                in2[at + c] = 0;
+                            }
+                            color[c] = static_cast<uint8_t>(std::clamp(src[x * 3 + c] + ((error + round) >> Kernel::shift), 0, 255));
+                        }
+                        uint8_t index = mapper.MapColor(color);
+                        dst[x] = index;
+                        for (int c = 0; c < 3; c++)
+                        {
+                            int e = color[c] - palette.colors[index][c];
+                            carry[0][c] = carry[1][c] + e * Kernel::right[0];
+                            carry[1][c] = e * Kernel::right[1];
+                            for (int d = 0; d < 5; d++)
+                            {
+                                if (Kernel::next[d])
+                                    out1[at + (d - 2) * 3 + c] += e * Kernel::next[d];
+                            }
+                            for (int d = 0; d < 3 && Kernel::two_rows; d++)
+                            {
+                                if (Kernel::next2[d])
+                                    out2[at + (d - 1) * 3 + c] += e * Kernel::next2[d];
+                            }
+                        }
+                    }
+                    progress[y].store(end, std::memory_order_release);
+                }
+            } });
+    }
+}
+
+// 按 method 抖动 image 并映射为 mapper 调色板的下标；threads 为参与的线程数（含调用线程）
+// 编码器各帧已在不同线程中并行处理时取1即可，单帧很大时可用多个线程
+inline void DitherImage(const RgbImage &image, const PaletteMapper &mapper, DitherMethod method,
+                        std::vector<uint8_t> &indices, size_t threads = 1, SimdLevel level = DetectSimdLevel())
+{
+    using namespace dither_detail;
+
+    indices.resize(static_cast<size_t>(image.width) * image.height);
+    threads = std::clamp<size_t>(threads, 1, std::max(1, image.height));
+    switch (method)
+    {
+    case DitherMethod::none:
+        mapper.Map(image, indices);
+        break;
+    case DitherMethod::bayer:
+    {
+        static const std::vector<float> thresholds = []
+        {
+            std::vector<float> result(64);
+            for (int i = 0; i < 64; i++)
+                result[i] = (Bayer(i % 8, i / 8) + 0.5f) / 64;
+            return result;
+        }();
+        OrderedDither(image, mapper, thresholds, 8, threads, level, indices.data());
+        break;
+    }
+    case DitherMethod::blue_noise:
+    {
+        static const std::vector<float> thresholds = []
+        {
+            const auto &ranks = BlueNoise();
+            std::vector<float> result(ranks.size());
+            for (size_t i = 0; i < ranks.size(); i++)
+                result[i] = (ranks[i] + 0.5f) / ranks.size();
+            return result;
+        }();
+        OrderedDither(image, mapper, thresholds, 64, threads, level, indices.data());
+        break;
+    }
+    case DitherMethod::floyd_steinberg:
+        DiffusionDither<FloydSteinbergKernel>(image, mapper, threads, indices.data());
+        break;
+    case DitherMethod::sierra:
+        DiffusionDither<SierraKernel>(image, mapper, threads, indices.data());
+        break;
+    }
+}
+
+#endif // GIFCMD_DITHER_HPP
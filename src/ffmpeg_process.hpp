@@ -0,0 +1,351 @@
+#ifndef GIFCMD_FFMPEG_PROCESS_HPP
+#define GIFCMD_FFMPEG_PROCESS_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+#include <fcntl.h>
+#include <poll.h>
+#include <signal.h>
+#include <spawn.h>
+#include <unistd.h>
+#include <sys/wait.h>
+
+extern char **environ;
+
+// ffmpeg -progress 输出的一组进度数据（每遇到 progress= 行提交一次）
+struct FFmpegProgress
+{
+    int64_t frame = 0;
+    double fps = 0;
+    int64_t out_time_us = 0;
+    double speed = 0;
+    int64_t total_size = 0;
+    bool finished = false; // progress=end
+};
+
+namespace ffmpeg_process_detail
+{
+    inline int64_t ParseInt(std::string_view s)
+    {
+        int64_t value = 0;
+        bool negative = !s.empty() && s[0] == '-';
+        for (size_t i = negative ? 1 : 0; i < s.size() && s[i] >= '0' && s[i] <= '9'; i++)
+            value = value * 10 + (s[i] - '0');
+        return negative ? -value : value;
+    }
+
+    // 解析形如 "12.5" 或 "1.02x" 的小数，"N/A" 返回0
+    inline double ParseDecimal(std::string_view s)
+    {
+        double value = 0, scale = 1;
+        bool fraction = false;
+        for (char c : s)
+        {
+            if (c >= '0' && c <= '9')
+            {
+                if (fraction)
+                    value += (c - '0') * (scale /= 10);
+                else
+                    value = value * 10 + (c - '0');
+            }
+            else if (c == '.' && !fraction)
+                fraction = true;
+            else
+                break;
+        }
+        return value;
+    }
+}
+
+// 手写的 -progress 键值流解析器：按行切分，跨读取块的半行会被保留到下次
+class ProgressParser
+{
+public:
+    explicit ProgressParser(std::function<void(const FFmpegProgress &)> on_progress)
+        : on_progress_(std::move(on_progress)) {}
+
+    void Feed(const char *data, size_t size)
+    {
+        using namespace ffmpeg_process_detail;
+
+        const char *end = data + size;
+        while (data < end)
+        {
+            const char *newline = static_cast<const char *>(std::memchr(data, '\n', end - data));
+            if (!newline)
+            {
+                pending_.append(data, end - data);
+                return;
+            }
+
+            std::string_view line;
+            if (pending_.empty())
+            {
+                line = std::string_view(data, newline - data);
+            }
+            else
+            {
+                pending_.append(data, newline - data);
+                line = pending_;
+            }
+            data = newline + 1;
+            HandleLine(line);
+            pending_.clear();
+        }
+    }
+
+private:
+    void HandleLine(std::string_view line)
+    {
+        using namespace ffmpeg_process_detail;
+
+        if (!line.empty() && line.back() == '\r')
+            line.remove_suffix(1);
+        size_t eq = line.find('=');
+        if (eq == std::string_view::npos)
+            return;
+        std::string_view key = line.substr(0, eq);
+        std::string_view value = line.substr(eq + 1);
+        while (!value.empty() && value.front() == ' ')
+            value.remove_prefix(1);
+
+        if (key == "frame")
+            current_.frame = ParseInt(value);
+        else if (key == "fps")
+            current_.fps = ParseDecimal(value);
+        else if (key == "out_time_us")
+            current_.out_time_us = ParseInt(value);
+        else if (key == "speed")
+            current_.speed = ParseDecimal(value);
+        else if (key == "total_size")
+            current_.total_size = ParseInt(value);
+        else if (key == "progress")
+        {
+            current_.finished = (value == "end");
+            on_progress_(current_);
+        }
+    }
+
+    std::function<void(const FFmpegProgress &)> on_progress_;
+    FFmpegProgress current_;
+    std::string pending_;
+};
+
+// 将参数拼接为可直接复制到shell执行的命令行（仅用于显示）
+inline std::string JoinCommandLine(const std::vector<std::string> &args)
+{
+    std::string result;
+    for (const auto &arg : args)
+    {
+        if (!result.empty())
+            result += ' ';
+        if (!arg.empty() && arg.find_first_of(" \t\"'\\$`;&|<>()[]*?") == std::string::npos)
+        {
+            result += arg;
+            continue;
+        }
+        result += '"';
+        for (char c : arg)
+        {
+            if (c == '"' || c == '\\' || c == '$' || c == '`')
+                result += '\\';
+            result += c;
+        }
+        result += '"';
+    }
+    return result;
+}
+
+// 向文件描述符写入全部数据（阻塞），对端关闭或出错时返回false
+inline bool WriteAll(int fd, const void *data, size_t size)
+{
+    auto *p = static_cast<const char *>(data);
+    while (size > 0)
+    {
+        ssize_t n = ::write(fd, p, size);
+        if (n < 0 && errno == EINTR)
+            continue;
+        if (n <= 0)
+            return false;
+        p += n;
+        size -= static_cast<size_t>(n);
+    }
+    return true;
+}
+
+// 用 posix_spawn 启动进程，stdout/stderr 分别接到非阻塞管道，poll 读取
+// stdout 数据交给 on_stdout，stderr 按行交给 on_stderr_line
+// working_directory 不为 "." 时子进程在该目录中运行
+// stdin_writer 不为空时 stdin 接到管道，由独立线程调用 stdin_writer(fd) 阻塞写入，返回后关闭管道；
+// 否则 stdin 为 /dev/null（调用方须忽略 SIGPIPE，子进程退出后写入返回 EPIPE）
+// 返回进程退出码；无法启动时返回-1
+inline int RunProcess(const std::vector<std::string> &args,
+                      const std::function<void(const char *, size_t)> &on_stdout,
+                      const std::function<void(std::string_view)> &on_stderr_line,
+                      const std::string &working_directory = ".",
+                      const std::function<void(int)> &stdin_writer = nullptr)
+{
+    if (args.empty())
+        return -1;
+#if !(defined(__GLIBC__) || defined(__APPLE__))
+    if (working_directory != ".")
+        return -1;
+#endif
+
+    int out_pipe[2], err_pipe[2], in_pipe[2] = {-1, -1};
+    if (::pipe2(out_pipe, O_CLOEXEC) != 0)
+        return -1;
+    if (::pipe2(err_pipe, O_CLOEXEC) != 0)
+    {
+        ::close(out_pipe[0]);
+        ::close(out_pipe[1]);
+        return -1;
+    }
+    if (stdin_writer && ::pipe2(in_pipe, O_CLOEXEC) != 0)
+    {
+        for (int fd : {out_pipe[0], out_pipe[1], err_pipe[0], err_pipe[1]})
+            ::close(fd);
+        return -1;
+    }
+
+    posix_spawn_file_actions_t actions;
+    posix_spawn_file_actions_init(&actions);
+    if (stdin_writer)
+        posix_spawn_file_actions_adddup2(&actions, in_pipe[0], STDIN_FILENO);
+    else
+        posix_spawn_file_actions_addopen(&actions, STDIN_FILENO, "/dev/null", O_RDONLY, 0);
+    posix_spawn_file_actions_adddup2(&actions, out_pipe[1], STDOUT_FILENO);
+    posix_spawn_file_actions_adddup2(&actions, err_pipe[1], STDERR_FILENO);
+#if defined(__GLIBC__) || defined(__APPLE__)
+    if (working_directory != ".")
+        posix_spawn_file_actions_addchdir_np(&actions, working_directory.c_str());
+#endif
+
+    std::vector<char *> argv;
+    for (const auto &arg : args)
+        argv.push_back(const_cast<char *>(arg.c_str()));
+    argv.push_back(nullptr);
+
+    // 子进程恢复 SIGPIPE 的默认处理（父进程可能忽略了它）
+    posix_spawnattr_t attributes;
+    posix_spawnattr_init(&attributes);
+    sigset_t default_signals;
+    sigemptyset(&default_signals);
+    sigaddset(&default_signals, SIGPIPE);
+    posix_spawnattr_setsigdefault(&attributes, &default_signals);
+    posix_spawnattr_setflags(&attributes, POSIX_SPAWN_SETSIGDEF);
+
+    pid_t pid;
+    int spawn_error = ::posix_spawnp(&pid, argv[0], &actions, &attributes, argv.data(), environ);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+    ::close(out_pipe[1]);
+    ::close(err_pipe[1]);
+    if (stdin_writer)
+        ::close(in_pipe[0]);
+    if (spawn_error != 0)
+    {
+        ::close(out_pipe[0]);
+        ::close(err_pipe[0]);
+        if (stdin_writer)
+            ::close(in_pipe[1]);
+        return -1;
+    }
+
+    std::thread writer;
+    if (stdin_writer)
+    {
+        writer = std::thread([&stdin_writer, fd = in_pipe[1]]
+                             {
+            stdin_writer(fd);
+            ::close(fd); });
+    }
+
+    ::fcntl(out_pipe[0], F_SETFL, O_NONBLOCK);
+    ::fcntl(err_pipe[0], F_SETFL, O_NONBLOCK);
+
+    std::vector<char> buffer(1 << 16);
+    std::string err_line;
+    struct pollfd fds[2] = {{out_pipe[0], POLLIN, 0}, {err_pipe[0], POLLIN, 0}};
+    int open_fds = 2;
+    while (open_fds > 0)
+    {
+        if (::poll(fds, 2, -1) < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            break;
+        }
+
+        for (int i = 0; i < 2; i++)
+        {
+            if (fds[i].fd < 0 || !(fds[i].revents & (POLLIN | POLLHUP | POLLERR)))
+                continue;
+
+            // 读空管道再回到poll
+            for (;;)
+            {
+                ssize_t n = ::read(fds[i].fd, buffer.data(), buffer.size());
+                if (n > 0)
+                {
+                    if (i == 0)
+                    {
+                        on_stdout(buffer.data(), static_cast<size_t>(n));
+                        continue;
+                    }
+                    // stderr 按 \n 或 \r 切行（ffmpeg统计行以\r结尾）
+                    const char *p = buffer.data();
+                    const char *end = p + n;
+                    for (const char *q = p; q < end; q++)
+                    {
+                        if (*q == '\n' || *q == '\r')
+                        {
+                            err_line.append(p, q - p);
+                            if (!err_line.empty())
+                                on_stderr_line(err_line);
+                            err_line.clear();
+                            p = q + 1;
+                        }
+                    }
+                    err_line.append(p, end - p);
+                    continue;
+                }
+                if (n < 0 && (errno == EINTR))
+                    continue;
+                if (n < 0 && (errno == EAGAIN || errno == EWOULDBLOCK))
+                    break;
+                // EOF 或错误：关闭该管道
+                ::close(fds[i].fd);
+                fds[i].fd = -1;
+                open_fds--;
+                break;
+            }
+        }
+    }
+    if (!err_line.empty())
+        on_stderr_line(err_line);
+
+    for (auto &fd : fds)
+    {
+        if (fd.fd >= 0)
+            ::close(fd.fd);
+    }
+
+    if (writer.joinable())
+        writer.join();
+
+    int status = 0;
+    while (::waitpid(pid, &status, 0) < 0 && errno == EINTR)
+    {
+    }
+    return WIFEXITED(status) ? WEXITSTATUS(status) : 128 + WTERMSIG(status);
+}
+
+#endif // GIFCMD_FFMPEG_PROCESS_HPP
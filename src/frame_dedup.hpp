@@ -0,0 +1,203 @@
+#ifndef GIFCMD_FRAME_DEDUP_HPP
+#define GIFCMD_FRAME_DEDUP_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+#include "image_decode.hpp"
+#include "ordered_work.hpp"
+
+// 重复帧检测：各线程并行计算每帧的签名，调用线程按顺序把连续的重复帧合并为一帧，时长为整段之和
+//  - 完全相同：可在进程内解码的格式比较解码后像素的XXH64，其余格式比较文件内容的XXH64
+//  - 近似相同（threshold > 0，仅可解码的格式）：32x32亮度缩略图逐格之差的最大值不超过 threshold
+// 每帧与所在段的第一帧比较，缓慢变化的画面不会被逐帧累积误差合并掉
+const int dedup_thumbnail_size = 32;
+
+// XXH64（与参考实现结果相同）
+inline uint64_t Xxh64(const void *input, size_t size, uint64_t seed = 0)
+{
+    const uint64_t p1 = 11400714785074694791ull, p2 = 14029467366897019727ull, p3 = 1609587929392839161ull,
+                   p4 = 9650029242287828579ull, p5 = 2870177450012600261ull;
+    auto rotl = [](uint64_t x, int r)
+    { return (x << r) | (x >> (64 - r)); };
+    auto read64 = [](const uint8_t *p)
+    {
+        uint64_t v;
+        std::memcpy(&v, p, 8);
+        return v;
+    };
+    auto read32 = [](const uint8_t *p)
+    {
+        uint32_t v;
+        std::memcpy(&v, p, 4);
+        return static_cast<uint64_t>(v);
+    };
+    auto round = [&](uint64_t acc, uint64_t lane)
+    { return rotl(acc + lane * p2, 31) * p1; };
+    auto merge = [&](uint64_t acc, uint64_t lane)
+    { return (acc ^ round(0, lane)) * p1 + p4; };
+
+    const uint8_t *p = static_cast<const uint8_t *>(input);
+    const uint8_t *end = p + size;
+    uint64_t h;
+    if (size >= 32)
+    {
+        uint64_t v1 = seed + p1 + p2, v2 = seed + p2, v3 = seed, v4 = seed - p1;
+        for (; p + 32 <= end; p += 32)
+        {
+            v1 = round(v1, read64(p));
+            v2 = round(v2, read64(p + 8));
+            v3 = round(v3, read64(p + 16));
+            v4 = round(v4, read64(p + 24));
+        }
+        h = rotl(v1, 1) + rotl(v2, 7) + rotl(v3, 12) + rotl(v4, 18);
+        h = merge(merge(merge(merge(h, v1), v2), v3), v4);
+    }
+    else
+    {
+        h = seed + p5;
+    }
+    h += size;
+    for (; p + 8 <= end; p += 8)
+        h = rotl(h ^ round(0, read64(p)), 27) * p1 + p4;
+    if (p + 4 <= end)
+    {
+        h = rotl(h ^ (read32(p) * p1), 23) * p2 + p3;
+        p += 4;
+    }
+    for (; p < end; p++)
+        h = rotl(h ^ (*p * p5), 11) * p1;
+    h ^= h >> 33;
+    h *= p2;
+    h ^= h >> 29;
+    h *= p3;
+    h ^= h >> 32;
+    return h;
+}
+
+// 一帧的签名：完全相同比较 hash，近似相同比较亮度缩略图
+struct FrameSignature
+{
+    uint64_t hash = 0;
+    bool has_thumbnail = false;
+    uint8_t thumbnail[dedup_thumbnail_size * dedup_thumbnail_size] = {};
+
+    bool Duplicates(const FrameSignature &other, int threshold) const
+    {
+        if (hash == other.hash)
+            return true;
+        if (threshold <= 0 || !has_thumbnail || !other.has_thumbnail)
+            return false;
+        for (int i = 0; i < dedup_thumbnail_size * dedup_thumbnail_size; i++)
+        {
+            if (std::abs(thumbnail[i] - other.thumbnail[i]) > threshold)
+                return false;
+        }
+        return true;
+    }
+};
+
+namespace frame_dedup_detail
+{
+    // 缩略图每格为对应区域的平均亮度（BT.601），图像小于缩略图时格子至少取一个像素
+    inline void Thumbnail(const RgbImage &image, uint8_t *out)
+    {
+        const int n = dedup_thumbnail_size;
+        uint32_t sums[n * n] = {}, counts[n * n] = {};
+        thread_local std::vector<int> column;
+        column.resize(image.width);
+        for (int x = 0; x < image.width; x++)
+            column[x] = std::min(n - 1, x * n / image.width);
+        for (int y = 0; y < image.height; y++)
+        {
+            const uint8_t *row = image.Row(y);
+            const int cell_row = std::min(n - 1, y * n / image.height) * n;
+            for (int x = 0; x < image.width; x++)
+            {
+                const uint8_t *p = row + x * 3;
+                sums[cell_row + column[x]] += (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+                counts[cell_row + column[x]]++;
+            }
+        }
+        for (int i = 0; i < n * n; i++)
+        {
+            // 图像比缩略图小时空格子取同一行左侧（或上一行）的值
+            if (counts[i])
+                out[i] = static_cast<uint8_t>((sums[i] + counts[i] / 2) / counts[i]);
+            else
+                out[i] = i > 0 ? out[i - 1] : 0;
+        }
+    }
+}
+
+// 依次检测 names 中的重复帧：keep 输出保留帧的下标，lengths 输出每个保留帧代表的原始帧数
+// decode 为false时（格式不能在进程内解码）只按文件内容判断完全相同
+// on_progress(done, total) 在按顺序处理完每帧后调用；返回错误信息（成功时为空）
+inline std::string FindDuplicateFrames(int dirfd, const std::vector<std::string> &names, bool decode, int threshold,
+                                       size_t workers, std::vector<size_t> &keep, std::vector<uint32_t> &lengths,
+                                       const std::function<void(size_t, size_t)> &on_progress)
+{
+    keep.clear();
+    lengths.clear();
+    FrameSignature anchor; // 当前段第一帧的签名
+    std::atomic<size_t> failed_frame{names.size()};
+    bool ok = ParallelOrdered<FrameSignature>(
+        names.size(), workers, workers * 2,
+        [&](size_t i, FrameSignature &signature)
+        {
+            thread_local std::vector<uint8_t> file;
+            if (!ReadImageFile(dirfd, names[i], file))
+            {
+                failed_frame = i;
+                return false;
+            }
+            if (!decode)
+            {
+                signature.hash = Xxh64(file.data(), file.size());
+                signature.has_thumbnail = false;
+                return true;
+            }
+            thread_local RgbImage image;
+            if (!DecodeImage(file, image))
+            {
+                failed_frame = i;
+                return false;
+            }
+            // 尺寸参与散列，像素相同但尺寸不同的帧不算重复；行尾有填充，逐行散列，上一行的结果作为下一行的种子
+            uint64_t hash = (static_cast<uint64_t>(image.width) << 32) | static_cast<uint32_t>(image.height);
+            for (int y = 0; y < image.height; y++)
+                hash = Xxh64(image.Row(y), static_cast<size_t>(image.width) * 3, hash);
+            signature.hash = hash;
+            signature.has_thumbnail = threshold > 0;
+            if (signature.has_thumbnail)
+                frame_dedup_detail::Thumbnail(image, signature.thumbnail);
+            return true;
+        },
+        [&](size_t i, FrameSignature &signature)
+        {
+            if (!keep.empty() && signature.Duplicates(anchor, threshold))
+            {
+                lengths.back()++;
+            }
+            else
+            {
+                keep.push_back(i);
+                lengths.push_back(1);
+                anchor = signature;
+            }
+            on_progress(i + 1, names.size());
+            return true;
+        });
+    if (failed_frame < names.size())
+        return "无法读取 " + names[failed_frame.load()];
+    if (!ok)
+        return "去重失败";
+    return "";
+}
+
+#endif // GIFCMD_FRAME_DEDUP_HPP
@@ -0,0 +1,258 @@
+#ifndef GIFCMD_FRAME_DELTA_HPP
+#define GIFCMD_FRAME_DELTA_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "cpu_features.hpp"
+
+// 帧间差分：相邻两帧只写出变化像素的包围盒，包围盒内未变化的像素写为透明色，
+// 透明像素连成长串后LZW压缩率更高，需要压缩的像素也更少
+// 两帧用“比较平面”表示：每像素 bpp 字节，两帧的调色板相同时直接比较索引（bpp = 1），否则比较颜色
+struct DeltaRect
+{
+    int x = 0;
+    int y = 0;
+    int width = 0;
+    int height = 0;
+
+    bool empty() const { return width == 0 || height == 0; }
+};
+
+namespace frame_delta_detail
+{
+    // [0, n) 中第一个不同字节的位置，全部相同时返回 n
+    inline size_t FirstDifferenceScalar(const uint8_t *a, const uint8_t *b, size_t n)
+    {
+        size_t i = 0;
+        while (i < n && a[i] == b[i])
+            i++;
+        return i;
+    }
+
+    // [0, n) 中最后一个不同字节的位置加1，全部相同时返回0
+    inline size_t LastDifferenceScalar(const uint8_t *a, const uint8_t *b, size_t n)
+    {
+        while (n > 0 && a[n - 1] == b[n - 1])
+            n--;
+        return n;
+    }
+
+    // 相同像素写为 transparent，不同像素取 indices
+    inline void MaskScalar(const uint8_t *a, const uint8_t *b, const uint8_t *indices, size_t n, uint8_t transparent,
+                           uint8_t *out)
+    {
+        for (size_t i = 0; i < n; i++)
+            out[i] = a[i] == b[i] ? transparent : indices[i];
+    }
+
+#ifdef GIFCMD_X86
+    GIFCMD_TARGET_SSE41 inline size_t FirstDifferenceSse41(const uint8_t *a, const uint8_t *b, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+            unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(eq)) & 0xFFFF;
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        return i + FirstDifferenceScalar(a + i, b + i, n - i);
+    }
+
+    GIFCMD_TARGET_SSE41 inline size_t LastDifferenceSse41(const uint8_t *a, const uint8_t *b, size_t n)
+    {
+        for (; n >= 16; n -= 16)
+        {
+            __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + n - 16)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + n - 16)));
+            unsigned mask = ~static_cast<unsigned>(_mm_movemask_epi8(eq)) & 0xFFFF;
+            if (mask)
+                return n - 16 + (32 - __builtin_clz(mask));
+        }
+        return LastDifferenceScalar(a, b, n);
+    }
+
+    GIFCMD_TARGET_SSE41 inline void MaskSse41(const uint8_t *a, const uint8_t *b, const uint8_t *indices, size_t n,
+                                              uint8_t transparent, uint8_t *out)
+    {
+        const __m128i fill = _mm_set1_epi8(static_cast<char>(transparent));
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m128i eq = _mm_cmpeq_epi8(_mm_loadu_si128(reinterpret_cast<const __m128i *>(a + i)),
+                                        _mm_loadu_si128(reinterpret_cast<const __m128i *>(b + i)));
+            __m128i value = _mm_loadu_si128(reinterpret_cast<const __m128i *>(indices + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm_blendv_epi8(value, fill, eq));
+        }
+        MaskScalar(a + i, b + i, indices + i, n - i, transparent, out + i);
+    }
+
+    GIFCMD_TARGET_AVX2 inline size_t FirstDifferenceAvx2(const uint8_t *a, const uint8_t *b, size_t n)
+    {
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i)));
+            unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(eq));
+            if (mask)
+                return i + __builtin_ctz(mask);
+        }
+        return i + FirstDifferenceScalar(a + i, b + i, n - i);
+    }
+
+    GIFCMD_TARGET_AVX2 inline size_t LastDifferenceAvx2(const uint8_t *a, const uint8_t *b, size_t n)
+    {
+        for (; n >= 32; n -= 32)
+        {
+            __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + n - 32)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + n - 32)));
+            unsigned mask = ~static_cast<unsigned>(_mm256_movemask_epi8(eq));
+            if (mask)
+                return n - 32 + (32 - __builtin_clz(mask));
+        }
+        return LastDifferenceScalar(a, b, n);
+    }
+
+    GIFCMD_TARGET_AVX2 inline void MaskAvx2(const uint8_t *a, const uint8_t *b, const uint8_t *indices, size_t n,
+                                            uint8_t transparent, uint8_t *out)
+    {
+        const __m256i fill = _mm256_set1_epi8(static_cast<char>(transparent));
+        size_t i = 0;
+        for (; i + 32 <= n; i += 32)
+        {
+            __m256i eq = _mm256_cmpeq_epi8(_mm256_loadu_si256(reinterpret_cast<const __m256i *>(a + i)),
+                                           _mm256_loadu_si256(reinterpret_cast<const __m256i *>(b + i)));
+            __m256i value = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(indices + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(out + i), _mm256_blendv_epi8(value, fill, eq));
+        }
+        MaskScalar(a + i, b + i, indices + i, n - i, transparent, out + i);
+    }
+#endif
+
+    inline size_t FirstDifference(SimdLevel level, const uint8_t *a, const uint8_t *b, size_t n)
+    {
+#ifdef GIFCMD_X86
+        if (level == SimdLevel::avx2)
+            return FirstDifferenceAvx2(a, b, n);
+        if (level == SimdLevel::sse41)
+            return FirstDifferenceSse41(a, b, n);
+#endif
+        return FirstDifferenceScalar(a, b, n);
+    }
+
+    inline size_t LastDifference(SimdLevel level, const uint8_t *a, const uint8_t *b, size_t n)
+    {
+#ifdef GIFCMD_X86
+        if (level == SimdLevel::avx2)
+            return LastDifferenceAvx2(a, b, n);
+        if (level == SimdLevel::sse41)
+            return LastDifferenceSse41(a, b, n);
+#endif
+        return LastDifferenceScalar(a, b, n);
+    }
+
+    inline void Mask(SimdLevel level, const uint8_t *a, const uint8_t *b, const uint8_t *indices, size_t n,
+                     uint8_t transparent, uint8_t *out)
+    {
+#ifdef GIFCMD_X86
+        if (level == SimdLevel::avx2)
+            return MaskAvx2(a, b, indices, n, transparent, out);
+        if (level == SimdLevel::sse41)
+            return MaskSse41(a, b, indices, n, transparent, out);
+#endif
+        MaskScalar(a, b, indices, n, transparent, out);
+    }
+
+    inline bool SamePixel(const uint8_t *a, const uint8_t *b, int bpp) { return std::memcmp(a, b, bpp) == 0; }
+}
+
+// 比较 width x height 的两个比较平面，返回不同像素的包围盒（没有变化时为空）
+// 每行只需比较当前左边界以左和右边界以右的部分；最后一个变化行以下的行再比较左右边界之间的部分
+inline DeltaRect ChangedRect(const uint8_t *previous, const uint8_t *current, int width, int height, int bpp,
+                             SimdLevel level = DetectSimdLevel())
+{
+    using namespace frame_delta_detail;
+
+    const size_t row_bytes = static_cast<size_t>(width) * bpp;
+    int left = width, right = 0, top = -1, bottom = 0;
+    for (int y = 0; y < height; y++)
+    {
+        const uint8_t *a = previous + y * row_bytes;
+        const uint8_t *b = current + y * row_bytes;
+        size_t left_bytes = static_cast<size_t>(left) * bpp, right_bytes = static_cast<size_t>(right) * bpp;
+        size_t first = FirstDifference(level, a, b, left_bytes);
+        bool changed = first < left_bytes;
+        // first 之前没有差异，最后一个差异只需从右边界和 first 中较大者开始找
+        size_t from = std::max(right_bytes, changed ? first : left_bytes);
+        size_t last = from + LastDifference(level, a + from, b + from, row_bytes - from);
+        if (changed)
+            left = static_cast<int>(first / bpp);
+        if (last > from)
+        {
+            right = static_cast<int>((last - 1) / bpp + 1);
+            changed = true;
+        }
+        if (!changed)
+            continue;
+        if (top < 0)
+            top = y;
+        bottom = y + 1;
+    }
+
+    DeltaRect rect;
+    if (top < 0)
+        return rect;
+    // 左右边界之间的差异不会扩大左右边界，但可能使下边界下移
+    const size_t begin = static_cast<size_t>(left) * bpp, span = static_cast<size_t>(right - left) * bpp;
+    for (int y = height - 1; y >= bottom; y--)
+    {
+        if (FirstDifference(level, previous + y * row_bytes + begin, current + y * row_bytes + begin, span) < span)
+        {
+            bottom = y + 1;
+            break;
+        }
+    }
+    rect.x = left;
+    rect.y = top;
+    rect.width = right - left;
+    rect.height = bottom - top;
+    return rect;
+}
+
+// 取出 rect 内的索引（indices 为整帧的索引平面），与上一帧相同的像素写为 transparent
+// rect 为空时输出 1x1 的透明像素（GIF的图像不能为空）
+inline void ExtractDelta(const uint8_t *previous, const uint8_t *current, int bpp, const uint8_t *indices, int width,
+                         DeltaRect &rect, uint8_t transparent, std::vector<uint8_t> &out,
+                         SimdLevel level = DetectSimdLevel())
+{
+    using namespace frame_delta_detail;
+
+    if (rect.empty())
+    {
+        rect = DeltaRect{0, 0, 1, 1};
+        out.assign(1, transparent);
+        return;
+    }
+    out.resize(static_cast<size_t>(rect.width) * rect.height);
+    for (int y = 0; y < rect.height; y++)
+    {
+        size_t offset = static_cast<size_t>(rect.y + y) * width + rect.x;
+        uint8_t *dst = out.data() + static_cast<size_t>(y) * rect.width;
+        if (bpp == 1)
+        {
+            Mask(level, previous + offset, current + offset, indices + offset, rect.width, transparent, dst);
+            continue;
+        }
+        for (int x = 0; x < rect.width; x++)
+        {
+            size_t at = (offset + x) * bpp;
+            dst[x] = SamePixel(previous + at, current + at, bpp) ? transparent : indices[offset + x];
+        }
+    }
+}
+
+#endif // GIFCMD_FRAME_DELTA_HPP
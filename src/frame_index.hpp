@@ -0,0 +1,170 @@
+#ifndef GIFCMD_FRAME_INDEX_HPP
+#define GIFCMD_FRAME_INDEX_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 帧索引条目：64位数字键 + 文件名在arena中的偏移和长度
+struct FrameEntry
+{
+    uint64_t key;
+    uint32_t name_offset;
+    uint32_t name_length;
+};
+
+// 从文件名末尾起提取最后一段连续数字并转换为整数
+// 无数字或超出uint64范围时返回false
+inline bool ExtractFrameKey(std::string_view filename, uint64_t &key)
+{
+    size_t end = filename.size();
+    while (end > 0 && (filename[end - 1] < '0' || filename[end - 1] > '9'))
+        end--;
+    if (end == 0)
+        return false;
+
+    size_t begin = end;
+    while (begin > 0 && filename[begin - 1] >= '0' && filename[begin - 1] <= '9')
+        begin--;
+
+    uint64_t value = 0;
+    for (size_t i = begin; i < end; i++)
+    {
+        uint64_t digit = static_cast<uint64_t>(filename[i] - '0');
+        if (value > (UINT64_MAX - digit) / 10)
+            return false;
+        value = value * 10 + digit;
+    }
+    key = value;
+    return true;
+}
+
+// 紧凑帧索引：所有文件名存放在同一块arena中，按数字键基数排序
+class FrameIndex
+{
+public:
+    void Clear()
+    {
+        entries_.clear();
+        names_.clear();
+        duplicates_ = 0;
+        overflowed_ = 0;
+    }
+
+    void Reserve(size_t frames, size_t name_bytes)
+    {
+        entries_.reserve(frames);
+        names_.reserve(name_bytes);
+    }
+
+    // 添加文件；文件名中没有数字时返回false
+    bool Add(std::string_view filename)
+    {
+        uint64_t key;
+        if (!ExtractFrameKey(filename, key))
+        {
+            // 有数字但超出范围的单独计数，以便报告
+            if (filename.find_first_of("0123456789") != std::string_view::npos)
+                overflowed_++;
+            return false;
+        }
+        AddWithKey(filename, key);
+        return true;
+    }
+
+    void AddWithKey(std::string_view filename, uint64_t key)
+    {
+        entries_.push_back({key, static_cast<uint32_t>(names_.size()), static_cast<uint32_t>(filename.size())});
+        names_.append(filename.data(), filename.size());
+    }
+
+    // 按数字键排序（稳定的LSD基数排序，跳过全部相同的字节位），
+    // 相同数字键的帧按文件名排序并计入重复数
+    void Sort()
+    {
+        const size_t n = entries_.size();
+        if (n > 1)
+        {
+            // 一次遍历统计全部8个字节位的直方图
+            std::vector<uint32_t> histogram(8 * 256, 0);
+            for (const auto &entry : entries_)
+            {
+                for (int b = 0; b < 8; b++)
+                    histogram[b * 256 + ((entry.key >> (8 * b)) & 0xFF)]++;
+            }
+
+            std::vector<FrameEntry> buffer(n);
+            for (int b = 0; b < 8; b++)
+            {
+                uint32_t *count = &histogram[b * 256];
+                // 该字节位所有键相同则无需这一趟
+                if (count[(entries_[0].key >> (8 * b)) & 0xFF] == n)
+                    continue;
+
+                uint32_t offset = 0;
+                for (int i = 0; i < 256; i++)
+                {
+                    uint32_t c = count[i];
+                    count[i] = offset;
+                    offset += c;
+                }
+                for (const auto &entry : entries_)
+                    buffer[count[(entry.key >> (8 * b)) & 0xFF]++] = entry;
+                entries_.swap(buffer);
+            }
+        }
+
+        // 数字键相同（如"001"与"1"）的帧全部保留，按文件名确定顺序
+        duplicates_ = 0;
+        for (size_t i = 0; i < n;)
+        {
+            size_t j = i + 1;
+            while (j < n && entries_[j].key == entries_[i].key)
+                j++;
+            if (j - i > 1)
+            {
+                duplicates_ += j - i - 1;
+                std::sort(entries_.begin() + i, entries_.begin() + j, [this](const FrameEntry &a, const FrameEntry &b)
+                          { return Name(a) < Name(b); });
+            }
+            i = j;
+        }
+    }
+
+    // 只保留 keep 中按升序列出的帧（去重后调用），文件名arena不变
+    void Retain(const std::vector<size_t> &keep)
+    {
+        for (size_t i = 0; i < keep.size(); i++)
+            entries_[i] = entries_[keep[i]];
+        entries_.resize(keep.size());
+    }
+
+    size_t size() const { return entries_.size(); }
+    bool empty() const { return entries_.empty(); }
+    uint64_t Key(size_t i) const { return entries_[i].key; }
+    std::string_view Name(size_t i) const { return Name(entries_[i]); }
+    std::string_view Name(const FrameEntry &entry) const
+    {
+        return std::string_view(names_.data() + entry.name_offset, entry.name_length);
+    }
+    const std::vector<FrameEntry> &Entries() const { return entries_; }
+    // 文件名arena（按添加顺序存放）及其当前长度
+    const std::string &NameArena() const { return names_; }
+    size_t NameBytes() const { return names_.size(); }
+
+    // 与前一帧数字键重复的帧数（排序后有效）
+    size_t DuplicateCount() const { return duplicates_; }
+    // 数字超出64位范围而被忽略的文件数；从缓存重建索引时由缓存恢复
+    size_t OverflowCount() const { return overflowed_; }
+    void SetOverflowCount(size_t count) { overflowed_ = count; }
+
+private:
+    std::vector<FrameEntry> entries_;
+    std::string names_;
+    size_t duplicates_ = 0;
+    size_t overflowed_ = 0;
+};
+
+#endif // GIFCMD_FRAME_INDEX_HPP
@@ -0,0 +1,392 @@
+#ifndef GIFCMD_FRAME_POOL_HPP
+#define GIFCMD_FRAME_POOL_HPP
+
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iterator>
+#include <map>
+#include <set>
+#include <mutex>
+#include <tuple>
+#include <utility>
+#include <vector>
+#include <sys/mman.h>
+
+// 帧缓冲池：按 宽 x 高 x 像素格式 分档缓存释放的帧缓冲区，同尺寸的帧再申请时直接复用，稳定运行时不再向系统申请内存
+//  - 每行起始地址按64字节对齐（行跨度取64的倍数），SIMD内核可以对齐读写
+//  - 可选大页：不小于2MB的缓冲区用mmap按2MB对齐分配并建议内核使用透明大页，减少TLB缺失
+//  - 缓冲区由 Handle 持有，析构时归还池中；池中空闲的总量超过缓存上限时直接释放
+//  - 池是进程共用的：同时运行的各使用者用 Require 登记自己的要求，生效的缓存上限取其中最大的，
+//    任一使用者要求大页时使用大页，不会互相覆盖
+enum class PixelFormat
+{
+    rgb24, // 每像素3字节
+};
+
+const size_t frame_row_alignment = 64;
+const size_t huge_page_size = 2u << 20;
+const size_t default_frame_pool_cache = 256u << 20;
+
+inline size_t PixelBytes(PixelFormat format)
+{
+    switch (format)
+    {
+    case PixelFormat::rgb24:
+        return 3;
+    }
+    return 1;
+}
+
+// 统计：hits / misses 为申请时命中池中缓冲区 / 须新分配的次数
+// live_bytes 为使用中的字节数，pooled_bytes 为池中空闲的字节数，peak_bytes 为两者之和的峰值
+struct FramePoolStats
+{
+    size_t hits = 0;
+    size_t misses = 0;
+    size_t live_bytes = 0;
+    size_t pooled_bytes = 0;
+    size_t peak_bytes = 0;
+};
+
+class FramePool
+{
+    struct Block
+    {
+        uint8_t *data = nullptr;
+        size_t bytes = 0;    // 可用字节数（行跨度 * 行数）
+        size_t mapped = 0;   // mmap 分配时映射的字节数，0 表示由 posix_memalign 分配
+    };
+
+    using Key = std::tuple<int, int, PixelFormat>;
+
+public:
+    // 一块帧缓冲区：只能移动，析构或 Release 时归还池中
+    class Handle
+    {
+    public:
+        Handle() = default;
+        Handle(const Handle &) = delete;
+        Handle &operator=(const Handle &) = delete;
+        Handle(Handle &&other) noexcept { *this = std::move(other); }
+        Handle &operator=(Handle &&other) noexcept
+        {
+            if (this != &other)
+            {
+                Release();
+                std::swap(pool_, other.pool_);
+                std::swap(block_, other.block_);
+                std::swap(key_, other.key_);
+                std::swap(stride_, other.stride_);
+            }
+            return *this;
+        }
+        ~Handle() { Release(); }
+
+        uint8_t *data() const { return block_.data; }
+        size_t stride() const { return stride_; } // 每行字节数，64的倍数
+        size_t bytes() const { return block_.bytes; }
+        explicit operator bool() const { return block_.data != nullptr; }
+
+        void Release()
+        {
+            if (pool_)
+                pool_->Return(key_, block_);
+            pool_ = nullptr;
+            block_ = Block();
+            stride_ = 0;
+        }
+
+    private:
+        friend class FramePool;
+        FramePool *pool_ = nullptr;
+        Block block_;
+        Key key_{0, 0, PixelFormat::rgb24};
+        size_t stride_ = 0;
+    };
+
+    // 一个使用者（如一个编码任务）登记的要求：只能移动，析构或 Release 时撤销
+    class Requirement
+    {
+    public:
+        Requirement() = default;
+        Requirement(const Requirement &) = delete;
+        Requirement &operator=(const Requirement &) = delete;
+        Requirement(Requirement &&other) noexcept { *this = std::move(other); }
+        Requirement &operator=(Requirement &&other) noexcept
+        {
+            if (this != &other)
+            {
+                Release();
+                std::swap(pool_, other.pool_);
+                std::swap(entry_, other.entry_);
+                std::swap(huge_pages_, other.huge_pages_);
+            }
+            return *this;
+        }
+        ~Requirement() { Release(); }
+
+        void Release()
+        {
+            if (pool_)
+                pool_->Withdraw(entry_, huge_pages_);
+            pool_ = nullptr;
+        }
+
+    private:
+        friend class FramePool;
+        FramePool *pool_ = nullptr;
+        std::multiset<size_t>::iterator entry_;
+        bool huge_pages_ = false;
+    };
+
+    FramePool() = default;
+    FramePool(const FramePool &) = delete;
+    FramePool &operator=(const FramePool &) = delete;
+    ~FramePool() { Trim(); }
+
+    // 进程共用的池（不析构：线程局部的缓冲区在线程退出时仍可归还）
+    static FramePool &Default()
+    {
+        static FramePool *pool = new FramePool();
+        return *pool;
+    }
+
+    static size_t RowStride(int width, PixelFormat format)
+    {
+        size_t row = static_cast<size_t>(width) * PixelBytes(format);
+        return (row + frame_row_alignment - 1) & ~(frame_row_alignment - 1);
+    }
+
+    // 申请 width x height 的缓冲区（内容未初始化）；尺寸为0或分配失败时返回空的 Handle
+    Handle Acquire(int width, int height, PixelFormat format)
+    {
+        Handle handle;
+        if (width <= 0 || height <= 0)
+            return handle;
+        const Key key{width, height, format};
+        const size_t stride = RowStride(width, format);
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            auto it = free_.find(key);
+            if (it != free_.end() && !it->second.empty())
+            {
+                handle.block_ = it->second.back();
+                it->second.pop_back();
+                stats_.hits++;
+                stats_.pooled_bytes -= handle.block_.bytes;
+                stats_.live_bytes += handle.block_.bytes;
+            }
+        }
+        if (!handle.block_.data)
+        {
+            handle.block_ = Allocate(stride * height);
+            if (!handle.block_.data)
+                return handle;
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.misses++;
+            stats_.live_bytes += handle.block_.bytes;
+            stats_.peak_bytes = std::max(stats_.peak_bytes, stats_.live_bytes + stats_.pooled_bytes);
+        }
+        handle.pool_ = this;
+        handle.key_ = key;
+        handle.stride_ = stride;
+        return handle;
+    }
+
+    // 没有登记要求时，之后新分配的大缓冲区是否使用大页（已缓存的缓冲区不变）
+    void SetHugePages(bool enabled)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        base_huge_pages_ = enabled;
+        huge_pages_ = base_huge_pages_ || huge_requirements_ > 0;
+    }
+
+    // 没有登记要求时池中空闲缓冲区的总量上限，超出的部分立即释放
+    void SetCacheLimit(size_t bytes)
+    {
+        std::vector<Block> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            base_cache_limit_ = bytes;
+            ApplyRequirements(evicted);
+        }
+        for (const Block &block : evicted)
+            Free(block);
+    }
+
+    // 登记一个使用者的要求，直到返回的 Requirement 析构：
+    // 生效的缓存上限为所有登记中最大的 cache_limit，任一登记要求大页时新分配的大缓冲区使用大页
+    Requirement Require(size_t cache_limit, bool huge_pages)
+    {
+        Requirement requirement;
+        std::vector<Block> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            requirement.entry_ = required_limits_.insert(cache_limit);
+            requirement.huge_pages_ = huge_pages;
+            requirement.pool_ = this;
+            if (huge_pages)
+                huge_requirements_++;
+            ApplyRequirements(evicted);
+        }
+        for (const Block &block : evicted)
+            Free(block);
+        return requirement;
+    }
+
+    // 当前生效的缓存上限和大页设置
+    size_t CacheLimit() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return cache_limit_;
+    }
+    bool HugePages() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return huge_pages_;
+    }
+
+    // 释放池中全部空闲缓冲区
+    void Trim()
+    {
+        std::vector<Block> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            for (auto &entry : free_)
+                evicted.insert(evicted.end(), entry.second.begin(), entry.second.end());
+            free_.clear();
+            stats_.pooled_bytes = 0;
+        }
+        for (const Block &block : evicted)
+            Free(block);
+    }
+
+    FramePoolStats Stats() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return stats_;
+    }
+
+private:
+    // 放回池中；空闲总量超出缓存上限时先淘汰其他尺寸（多半是不再使用的旧尺寸），仍超出时淘汰同尺寸的
+    void Return(const Key &key, const Block &block)
+    {
+        std::vector<Block> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats_.live_bytes -= block.bytes;
+            free_[key].push_back(block);
+            stats_.pooled_bytes += block.bytes;
+            if (stats_.pooled_bytes > cache_limit_)
+            {
+                Evict(evicted, &key);
+                Evict(evicted, nullptr);
+            }
+        }
+        for (const Block &stale : evicted)
+            Free(stale);
+    }
+
+    void Withdraw(std::multiset<size_t>::iterator entry, bool huge_pages)
+    {
+        std::vector<Block> evicted;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            required_limits_.erase(entry);
+            if (huge_pages)
+                huge_requirements_--;
+            ApplyRequirements(evicted);
+        }
+        for (const Block &block : evicted)
+            Free(block);
+    }
+
+    // 须持有锁：按登记的要求（没有登记时按基础设置）更新生效的设置，缓存上限变小时淘汰超出的部分
+    void ApplyRequirements(std::vector<Block> &evicted)
+    {
+        cache_limit_ = required_limits_.empty() ? base_cache_limit_ : *required_limits_.rbegin();
+        huge_pages_ = base_huge_pages_ || huge_requirements_ > 0;
+        Evict(evicted, nullptr);
+    }
+
+    // 须持有锁：把超出上限的空闲缓冲区（跳过 skip 尺寸）移到 evicted，由调用方在锁外释放
+    void Evict(std::vector<Block> &evicted, const Key *skip)
+    {
+        for (auto it = free_.begin(); it != free_.end() && stats_.pooled_bytes > cache_limit_;)
+        {
+            if (skip && it->first == *skip)
+            {
+                ++it;
+                continue;
+            }
+            while (!it->second.empty() && stats_.pooled_bytes > cache_limit_)
+            {
+                stats_.pooled_bytes -= it->second.back().bytes;
+                evicted.push_back(it->second.back());
+                it->second.pop_back();
+            }
+            it = it->second.empty() ? free_.erase(it) : std::next(it);
+        }
+    }
+
+    Block Allocate(size_t bytes)
+    {
+        Block block;
+        block.bytes = bytes;
+        bool huge;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            huge = huge_pages_;
+        }
+#ifdef MADV_HUGEPAGE
+        // 多映射一个大页，截去首尾使起始地址按2MB对齐
+        if (huge && bytes >= huge_page_size)
+        {
+            const size_t mapped = (bytes + huge_page_size - 1) & ~(huge_page_size - 1);
+            void *base = ::mmap(nullptr, mapped + huge_page_size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+            if (base != MAP_FAILED)
+            {
+                uintptr_t start = reinterpret_cast<uintptr_t>(base);
+                uintptr_t aligned = (start + huge_page_size - 1) & ~(huge_page_size - 1);
+                if (aligned > start)
+                    ::munmap(base, aligned - start);
+                if (size_t tail = start + mapped + huge_page_size - (aligned + mapped))
+                    ::munmap(reinterpret_cast<void *>(aligned + mapped), tail);
+                ::madvise(reinterpret_cast<void *>(aligned), mapped, MADV_HUGEPAGE);
+                block.data = reinterpret_cast<uint8_t *>(aligned);
+                block.mapped = mapped;
+                return block;
+            }
+        }
+#else
+        (void)huge;
+#endif
+        void *memory = nullptr;
+        if (::posix_memalign(&memory, frame_row_alignment, bytes) != 0)
+            return Block();
+        block.data = static_cast<uint8_t *>(memory);
+        return block;
+    }
+
+    static void Free(const Block &block)
+    {
+        if (block.mapped)
+            ::munmap(block.data, block.mapped);
+        else
+            std::free(block.data);
+    }
+
+    mutable std::mutex mutex_;
+    std::map<Key, std::vector<Block>> free_;
+    FramePoolStats stats_;
+    size_t cache_limit_ = default_frame_pool_cache; // 生效的缓存上限
+    bool huge_pages_ = false;                       // 生效的大页设置
+    size_t base_cache_limit_ = default_frame_pool_cache;
+    bool base_huge_pages_ = false;
+    std::multiset<size_t> required_limits_; // 各登记的缓存上限
+    size_t huge_requirements_ = 0;          // 要求大页的登记数
+};
+
+#endif // GIFCMD_FRAME_POOL_HPP
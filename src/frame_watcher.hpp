@@ -0,0 +1,271 @@
+#ifndef GIFCMD_FRAME_WATCHER_HPP
+#define GIFCMD_FRAME_WATCHER_HPP
+
+#include <atomic>
+#include <cstdint>
+#include <functional>
+#include <map>
+#include <mutex>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <unordered_map>
+#include <fcntl.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <poll.h>
+#include <sys/eventfd.h>
+#include <sys/inotify.h>
+#endif
+#include <ftxui/component/receiver.hpp>
+#include "dir_scanner.hpp"
+#include "frame_index.hpp"
+
+// 实时帧统计：帧数、缺帧数（首尾帧号之间缺失的帧号个数）及帧号范围
+struct FrameStats
+{
+    size_t count = 0;
+    size_t gaps = 0;
+    uint64_t first_key = 0;
+    uint64_t last_key = 0;
+
+    bool operator==(const FrameStats &other) const
+    {
+        return count == other.count && gaps == other.gaps &&
+               first_key == other.first_key && last_key == other.last_key;
+    }
+    bool operator!=(const FrameStats &other) const { return !(*this == other); }
+};
+
+// 基于inotify的帧目录监视线程：增量维护帧列表，通过Sender把统计推送给界面
+// notify 在每次推送后调用，用于唤醒界面刷新
+class FrameWatcher
+{
+public:
+    FrameWatcher(std::string directory, std::string extension,
+                 ftxui::Sender<FrameStats> sender, std::function<void()> notify)
+        : directory_(std::move(directory)), extension_(std::move(extension)),
+          sender_(std::move(sender)), notify_(std::move(notify))
+    {
+#ifdef __linux__
+        inotify_fd_ = ::inotify_init1(IN_NONBLOCK | IN_CLOEXEC);
+        wake_fd_ = ::eventfd(0, EFD_NONBLOCK | EFD_CLOEXEC);
+        if (inotify_fd_ >= 0 && wake_fd_ >= 0 &&
+            ::inotify_add_watch(inotify_fd_, directory_.c_str(),
+                                IN_CLOSE_WRITE | IN_MOVED_TO | IN_MOVED_FROM | IN_DELETE) >= 0)
+        {
+            thread_ = std::thread([this]
+                                  { Run(); });
+        }
+#endif
+    }
+
+    ~FrameWatcher() { Stop(); }
+    FrameWatcher(const FrameWatcher &) = delete;
+    FrameWatcher &operator=(const FrameWatcher &) = delete;
+
+    bool active() const { return thread_.joinable(); }
+
+    // 修改监视的文件后缀名，触发重新扫描
+    void SetExtension(const std::string &extension)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (extension == extension_)
+                return;
+            extension_ = extension;
+        }
+        reseed_ = true;
+        Wake();
+    }
+
+    // 暂停期间（程序自身重命名文件时）丢弃事件，恢复后重新扫描
+    void Pause() { paused_ = true; }
+    void Resume()
+    {
+        paused_ = false;
+        reseed_ = true;
+        Wake();
+    }
+
+    // 以当前帧列表填充并排序索引，避免点击生成时重新扫描目录
+    // 监视未就绪或后缀名不一致时返回false
+    bool Snapshot(const std::string &extension, FrameIndex &index)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        if (!seeded_ || paused_ || reseed_ || extension != extension_)
+            return false;
+        index.Clear();
+        index.Reserve(frames_.size(), frames_.size() * 16);
+        for (const auto &[name, key] : frames_)
+            index.AddWithKey(name, key);
+        index.Sort();
+        return true;
+    }
+
+    void Stop()
+    {
+        stop_ = true;
+        Wake();
+        if (thread_.joinable())
+            thread_.join();
+#ifdef __linux__
+        if (inotify_fd_ >= 0)
+            ::close(inotify_fd_);
+        if (wake_fd_ >= 0)
+            ::close(wake_fd_);
+        inotify_fd_ = wake_fd_ = -1;
+#endif
+    }
+
+private:
+    void Wake()
+    {
+#ifdef __linux__
+        if (wake_fd_ >= 0)
+        {
+            uint64_t one = 1;
+            ssize_t ignored = ::write(wake_fd_, &one, sizeof(one));
+            (void)ignored;
+        }
+#endif
+    }
+
+#ifdef __linux__
+    void Run()
+    {
+        Reseed();
+        Publish();
+        alignas(struct inotify_event) char buffer[1 << 16];
+        while (!stop_)
+        {
+            struct pollfd fds[2] = {{inotify_fd_, POLLIN, 0}, {wake_fd_, POLLIN, 0}};
+            if (::poll(fds, 2, -1) < 0)
+                continue;
+
+            if (fds[1].revents & POLLIN)
+            {
+                uint64_t value;
+                ssize_t ignored = ::read(wake_fd_, &value, sizeof(value));
+                (void)ignored;
+            }
+
+            // 一次读完全部待处理事件后再统一推送
+            ssize_t n;
+            while ((n = ::read(inotify_fd_, buffer, sizeof(buffer))) > 0)
+            {
+                if (paused_ || reseed_)
+                    continue;
+                for (char *p = buffer; p < buffer + n;)
+                {
+                    auto *event = reinterpret_cast<struct inotify_event *>(p);
+                    p += sizeof(struct inotify_event) + event->len;
+                    if (event->mask & IN_Q_OVERFLOW)
+                        reseed_ = true;
+                    else if (event->len > 0 && !(event->mask & IN_ISDIR))
+                        Apply(event->name, event->mask & (IN_CLOSE_WRITE | IN_MOVED_TO));
+                }
+            }
+
+            if (stop_)
+                break;
+            if (reseed_ && !paused_)
+                Reseed();
+            Publish();
+        }
+    }
+
+    void Apply(std::string_view name, bool added)
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        uint64_t key;
+        if (!HasFrameExtension(name, extension_) || !ExtractFrameKey(name, key))
+            return;
+
+        if (added)
+        {
+            if (frames_.emplace(std::string(name), key).second)
+                key_counts_[key]++;
+        }
+        else
+        {
+            auto it = frames_.find(std::string(name));
+            if (it == frames_.end())
+                return;
+            auto count = key_counts_.find(it->second);
+            if (--count->second == 0)
+                key_counts_.erase(count);
+            frames_.erase(it);
+        }
+    }
+
+    void Reseed()
+    {
+        reseed_ = false;
+        std::string extension;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            extension = extension_;
+        }
+
+        FrameIndex index;
+        ScanFrameDirectory(directory_.c_str(), extension, index);
+
+        std::lock_guard<std::mutex> lock(mutex_);
+        // 扫描期间后缀名又被修改，则下一轮重新扫描
+        if (extension != extension_)
+        {
+            reseed_ = true;
+            return;
+        }
+        frames_.clear();
+        key_counts_.clear();
+        frames_.reserve(index.size());
+        for (size_t i = 0; i < index.size(); i++)
+        {
+            frames_.emplace(std::string(index.Name(i)), index.Key(i));
+            key_counts_[index.Key(i)]++;
+        }
+        seeded_ = true;
+    }
+#endif
+
+    void Publish()
+    {
+        FrameStats stats;
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stats.count = frames_.size();
+            if (!key_counts_.empty())
+            {
+                stats.first_key = key_counts_.begin()->first;
+                stats.last_key = key_counts_.rbegin()->first;
+                stats.gaps = static_cast<size_t>(stats.last_key - stats.first_key + 1 - key_counts_.size());
+            }
+        }
+        if (stats == last_published_)
+            return;
+        last_published_ = stats;
+        sender_->Send(stats);
+        if (notify_)
+            notify_();
+    }
+
+    std::string directory_;
+    std::string extension_;
+    ftxui::Sender<FrameStats> sender_;
+    std::function<void()> notify_;
+    std::thread thread_;
+    std::mutex mutex_;
+    std::unordered_map<std::string, uint64_t> frames_; // 文件名 -> 帧号
+    std::map<uint64_t, size_t> key_counts_;             // 帧号 -> 文件数（用于统计缺帧）
+    FrameStats last_published_;
+    bool seeded_ = false;
+    std::atomic<bool> stop_{false};
+    std::atomic<bool> paused_{false};
+    std::atomic<bool> reseed_{false};
+    int inotify_fd_ = -1;
+    int wake_fd_ = -1;
+};
+
+#endif // GIFCMD_FRAME_WATCHER_HPP
@@ -0,0 +1,227 @@
+#ifndef GIFCMD_GIF_LZW_HPP
+#define GIFCMD_GIF_LZW_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+
+// GIF LZW 压缩内核
+//  - 码表直接按 (前缀码 << 最小码长 | 字符) 索引，每项16位（0表示没有该串），查找只有一次读取，
+//    没有散列和探测；最小码长为8时占2MB，每个线程一份。只记录本轮加入的项，清除码时只清零这些项
+//  - 位打包无分支：累加器每次整体写出8字节，再按已满的字节数前移；码流先连续写入，最后一次性切分为255字节的数据子块
+//  - 热循环中的状态都是局部变量，写出字节时编译器不必假设它们被改写
+//  - 4096个码用满后先输出当前前缀，再发送清除码并重置（与常见编码器相同）
+// 对象可重复使用（每个线程一个），表和缓冲区的内存在多次调用间复用
+class GifLzwEncoder
+{
+public:
+    GifLzwEncoder() : table_(size_t(max_codes) << 8, 0) {}
+
+    // 压缩 count 个调色板索引（每个索引小于 1 << min_code_size），min_code_size 为2-8
+    // 输出带最小码长字节、255字节分块和结尾0块的GIF图像数据
+    void Encode(const uint8_t *indices, size_t count, int min_code_size, std::vector<uint8_t> &out)
+    {
+        const uint32_t clear_code = 1u << min_code_size;
+        const uint32_t end_code = clear_code + 1;
+
+        // 码的个数不超过 count + 重置次数 + 3，每个码最多12位；末尾留出整体写入8字节的余量
+        raw_.resize((count + count / 2048 + 8) * 12 / 8 + 16);
+        uint8_t *raw = raw_.data();
+        uint16_t *table = table_.data();
+        uint64_t bits = 0;
+        int bit_count = 0;
+        auto emit = [&](uint32_t code, int width)
+        {
+            bits |= static_cast<uint64_t>(code) << bit_count;
+            bit_count += width;
+            StoreLittleEndian(raw, bits);
+            const int bytes = bit_count >> 3;
+            raw += bytes;
+            bits >>= bytes * 8;
+            bit_count &= 7;
+        };
+
+        const uint32_t first_code = end_code + 1;
+        uint32_t next_code = first_code;
+        int code_width = min_code_size + 1;
+        uint32_t width_limit = 1u << code_width; // 下一个码达到该值时加宽
+        // 清零本轮加入的项，使码表回到全空
+        auto reset = [&]
+        {
+            for (uint32_t code = first_code; code < next_code; code++)
+                table[keys_[code]] = 0;
+            next_code = first_code;
+            code_width = min_code_size + 1;
+            width_limit = 1u << code_width;
+        };
+        emit(clear_code, code_width);
+
+        if (count > 0)
+        {
+            uint32_t prefix = indices[0];
+            for (size_t i = 1; i < count; i++)
+            {
+                const uint32_t c = indices[i];
+                const uint32_t key = (prefix << min_code_size) | c;
+                if (const uint32_t code = table[key])
+                {
+                    prefix = code;
+                    continue;
+                }
+
+                emit(prefix, code_width);
+                if (next_code < max_codes)
+                {
+                    table[key] = static_cast<uint16_t>(next_code);
+                    keys_[next_code] = key;
+                    if (next_code == width_limit && code_width < 12)
+                    {
+                        code_width++;
+                        width_limit <<= 1;
+                    }
+                    next_code++;
+                }
+                else
+                {
+                    // 码表已满：发送清除码并重置
+                    emit(clear_code, code_width);
+                    reset();
+                }
+                prefix = c;
+            }
+            emit(prefix, code_width);
+        }
+        emit(end_code, code_width);
+        reset();
+        const size_t raw_size = static_cast<size_t>(raw - raw_.data()) + (bit_count > 0 ? 1 : 0);
+
+        // 切分为数据子块
+        size_t blocks = (raw_size + 254) / 255;
+        out.resize(1 + raw_size + blocks + 1);
+        uint8_t *dst = out.data();
+        *dst++ = static_cast<uint8_t>(min_code_size);
+        for (size_t offset = 0; offset < raw_size; offset += 255)
+        {
+            size_t length = std::min<size_t>(255, raw_size - offset);
+            *dst++ = static_cast<uint8_t>(length);
+            std::memcpy(dst, raw_.data() + offset, length);
+            dst += length;
+        }
+        *dst = 0;
+    }
+
+private:
+    static constexpr uint32_t max_codes = 4096;
+
+    static void StoreLittleEndian(uint8_t *p, uint64_t value)
+    {
+#if defined(__BYTE_ORDER__) && __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__
+        std::memcpy(p, &value, 8);
+#else
+        for (int k = 0; k < 8; k++)
+            p[k] = static_cast<uint8_t>(value >> (8 * k));
+#endif
+    }
+
+    std::vector<uint16_t> table_; // (前缀码 << 最小码长 | 字符) -> 码，0为没有
+    uint32_t keys_[max_codes];    // 本轮每个码在 table_ 中的位置，重置时据此清零
+    std::vector<uint8_t> raw_;    // 未分块的码流
+};
+
+// GIF LZW 解压：码表记录每个码的前缀、末字符、首字符和长度，按长度从后往前直接写入输出，不需要栈
+// 对象可重复使用
+class GifLzwDecoder
+{
+public:
+    // data 为最小码长字节之后的数据子块序列（含结尾的0块），解出 count 个索引写入 out
+    // 数据损坏或索引不足 count 个时返回false（已解出的部分仍写入 out）
+    bool Decode(const uint8_t *data, size_t size, int min_code_size, uint8_t *out, size_t count)
+    {
+        if (min_code_size < 1 || min_code_size > 11)
+            return false;
+        const uint32_t clear_code = 1u << min_code_size;
+        const uint32_t end_code = clear_code + 1;
+        for (uint32_t code = 0; code < clear_code; code++)
+        {
+            suffix_[code] = first_[code] = static_cast<uint8_t>(code);
+            length_[code] = 1;
+        }
+
+        uint32_t next_code = end_code + 1;
+        int code_width = min_code_size + 1;
+        int32_t previous = -1;
+        size_t written = 0;
+        size_t pos = 0, block_end = 0; // 当前子块在 data 中的结束位置
+        uint32_t bits = 0;
+        int bit_count = 0;
+
+        for (;;)
+        {
+            while (bit_count < code_width)
+            {
+                if (pos == block_end)
+                {
+                    if (pos >= size || data[pos] == 0)
+                        return written == count; // 数据结束（缺少结束码也可接受）
+                    block_end = pos + 1 + data[pos];
+                    pos++;
+                    if (block_end > size)
+                        return false;
+                }
+                bits |= static_cast<uint32_t>(data[pos++]) << bit_count;
+                bit_count += 8;
+            }
+            uint32_t code = bits & ((1u << code_width) - 1);
+            bits >>= code_width;
+            bit_count -= code_width;
+
+            if (code == clear_code)
+            {
+                next_code = end_code + 1;
+                code_width = min_code_size + 1;
+                previous = -1;
+                continue;
+            }
+            if (code == end_code)
+                return written == count;
+            if (code > next_code || (previous < 0 && code >= clear_code))
+                return false;
+
+            // 新码 = 前一个码的串 + 本码串的首字符（本码即新码时为前一个码串的首字符）
+            if (previous >= 0 && next_code < 4096)
+            {
+                prefix_[next_code] = static_cast<uint16_t>(previous);
+                suffix_[next_code] = code < next_code ? first_[code] : first_[previous];
+                first_[next_code] = first_[previous];
+                length_[next_code] = static_cast<uint16_t>(length_[previous] + 1);
+                next_code++;
+                if (next_code == (1u << code_width) && code_width < 12)
+                    code_width++;
+            }
+            else if (code == next_code)
+            {
+                return false;
+            }
+
+            size_t length = length_[code];
+            uint32_t walk = code;
+            for (size_t k = length; k-- > 0;)
+            {
+                if (written + k < count)
+                    out[written + k] = suffix_[walk];
+                walk = prefix_[walk];
+            }
+            written = std::min(count, written + length);
+            previous = static_cast<int32_t>(code);
+        }
+    }
+
+private:
+    uint16_t prefix_[4096] = {};
+    uint8_t suffix_[4096] = {};
+    uint8_t first_[4096] = {};
+    uint16_t length_[4096] = {};
+};
+
+#endif // GIFCMD_GIF_LZW_HPP
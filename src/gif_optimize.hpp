@@ -0,0 +1,235 @@
+#ifndef GIFCMD_GIF_OPTIMIZE_HPP
+#define GIFCMD_GIF_OPTIMIZE_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include "frame_delta.hpp"
+#include "gif_lzw.hpp"
+#include "gif_stitch.hpp"
+#include "gif_writer.hpp"
+
+// 帧间差分后处理：解码已生成的GIF，把每帧合成到画布上，与上一帧显示的画面比较，
+// 只重新写出变化像素的包围盒，未变化的像素写为透明色；重新压缩后不比原来小的帧保持原样
+//  - 变化的像素必然来自该帧自己的不透明像素，因此沿用该帧的颜色表，透明色取变化像素没有用到的索引
+//  - 所有帧都不清除画布（处置方式0/1），输出帧也都用处置方式1；遇到处置方式2/3或交错图像时不做处理
+namespace gif_optimize_detail
+{
+    using gif_stitch_detail::ReadLE16;
+    using gif_stitch_detail::SkipSubBlocks;
+
+    // 把数据子块序列拼接为连续的字节，返回结束后的位置；越界返回0
+    inline size_t CollectSubBlocks(const std::string &data, size_t pos, std::vector<uint8_t> &out)
+    {
+        out.clear();
+        while (pos < data.size())
+        {
+            size_t length = static_cast<unsigned char>(data[pos]);
+            if (pos + 1 + length > data.size())
+                return 0;
+            out.push_back(static_cast<uint8_t>(length));
+            out.insert(out.end(), data.begin() + pos + 1, data.begin() + pos + 1 + length);
+            pos += 1 + length;
+            if (length == 0)
+                return pos;
+        }
+        return 0;
+    }
+
+    inline void PutLE16(std::string &out, int value)
+    {
+        out.push_back(static_cast<char>(value & 0xFF));
+        out.push_back(static_cast<char>((value >> 8) & 0xFF));
+    }
+}
+
+// 对 path 处的GIF做帧间差分后处理（先写临时文件，完成后替换）
+// before / after 输出处理前后的文件大小（未处理时两者相等）；返回错误信息（成功时为空）
+inline std::string OptimizeGifFile(const std::string &path, size_t &before, size_t &after)
+{
+    using namespace gif_optimize_detail;
+
+    gif_stitch_detail::Segment gif;
+    {
+        std::ifstream in(path, std::ios::binary);
+        if (!in.is_open())
+            return "无法读取输出文件 " + path;
+        gif.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+    }
+    before = after = gif.data.size();
+    if (!gif_stitch_detail::ParseHeader(gif))
+        return "输出文件不是有效的GIF文件：" + path;
+
+    const std::string &d = gif.data;
+    const int width = gif.width, height = gif.height;
+    const size_t pixels = static_cast<size_t>(width) * height;
+    auto *bytes = reinterpret_cast<const unsigned char *>(d.data());
+
+    // 画布为RGBA，A为0表示尚未绘制；previous 为上一帧显示的画面
+    std::vector<uint8_t> previous(pixels * 4, 0), current;
+    std::vector<uint8_t> plane(pixels, 0); // 当前帧在画布坐标中的索引
+    std::vector<uint8_t> lzw, indices, delta, compressed;
+    GifLzwDecoder decoder;
+
+    std::string out(d, 0, gif.blocks_offset);
+    // 最近的图形控制扩展（属于下一幅图像）
+    size_t control_start = 0, control_end = 0;
+    int delay = 0, disposal = 0, transparent = -1;
+    size_t pos = gif.blocks_offset;
+    for (;;)
+    {
+        if (pos >= d.size())
+            return "输出文件数据不完整：" + path;
+        size_t start = pos;
+        unsigned char introducer = bytes[pos];
+        if (introducer == 0x3B)
+        {
+            out.push_back(0x3B);
+            break;
+        }
+        if (introducer == 0x21)
+        {
+            if (pos + 2 > d.size())
+                return "输出文件数据不完整：" + path;
+            pos = SkipSubBlocks(d, pos + 2);
+            if (pos == 0)
+                return "输出文件数据不完整：" + path;
+            if (bytes[start + 1] == 0xF9 && pos - start >= 8 && bytes[start + 2] == 4)
+            {
+                // 图形控制扩展先保留，写出图像时再决定是否改写
+                control_start = start;
+                control_end = pos;
+                disposal = (bytes[start + 3] >> 2) & 7;
+                transparent = (bytes[start + 3] & 1) ? bytes[start + 6] : -1;
+                delay = ReadLE16(bytes + start + 4);
+            }
+            else
+            {
+                out.append(d, start, pos - start);
+            }
+            continue;
+        }
+        if (introducer != 0x2C || pos + 10 > d.size())
+            return "输出文件包含未知的数据块：" + path;
+
+        // 图像描述符、颜色表和LZW数据
+        const int fx = ReadLE16(bytes + pos + 1), fy = ReadLE16(bytes + pos + 3);
+        const int fw = ReadLE16(bytes + pos + 5), fh = ReadLE16(bytes + pos + 7);
+        const unsigned char packed = bytes[pos + 9];
+        const bool local = packed & 0x80;
+        const size_t table_offset = local ? pos + 10 : gif.table_offset;
+        const int table_bits = local ? (packed & 0x07) + 1 : (gif.packed & 0x80 ? (gif.packed & 0x07) + 1 : 0);
+        const size_t data_start = pos + 10 + (local ? 3u << table_bits : 0);
+        if (data_start + 1 > d.size())
+            return "输出文件数据不完整：" + path;
+        pos = CollectSubBlocks(d, data_start + 1, lzw);
+        if (pos == 0)
+            return "输出文件数据不完整：" + path;
+
+        // 不支持的帧：放弃整个后处理，保留原文件
+        if ((packed & 0x40) || disposal >= 2 || table_bits == 0)
+            return "";
+        indices.resize(static_cast<size_t>(fw) * fh);
+        if (!decoder.Decode(lzw.data(), lzw.size(), bytes[data_start], indices.data(), indices.size()))
+            return "输出文件的图像数据无法解码：" + path;
+
+        // 把该帧画到画布上
+        current = previous;
+        const int table_entries = 1 << table_bits;
+        for (int y = 0; y < fh && fy + y < height; y++)
+        {
+            for (int x = 0; x < fw && fx + x < width; x++)
+            {
+                uint8_t index = indices[static_cast<size_t>(y) * fw + x];
+                if (index == transparent || index >= table_entries)
+                    continue;
+                size_t at = static_cast<size_t>(fy + y) * width + fx + x;
+                std::memcpy(&current[at * 4], bytes + table_offset + index * 3, 3);
+                current[at * 4 + 3] = 255;
+                plane[at] = index;
+            }
+        }
+
+        // 变化的像素都是本帧画上的，取它们没有用到的索引作为透明色（优先沿用原来的透明色）
+        DeltaRect rect = ChangedRect(previous.data(), current.data(), width, height, 4);
+        bool used[256] = {};
+        for (int y = rect.y; y < rect.y + rect.height; y++)
+        {
+            for (int x = rect.x; x < rect.x + rect.width; x++)
+            {
+                size_t at = static_cast<size_t>(y) * width + x;
+                if (std::memcmp(&previous[at * 4], &current[at * 4], 4) != 0)
+                    used[plane[at]] = true;
+            }
+        }
+        int key = transparent >= 0 && transparent < table_entries && !used[transparent] ? transparent : -1;
+        for (int index = 0; key < 0 && index < table_entries; index++)
+        {
+            if (!used[index])
+                key = index;
+        }
+
+        bool rewritten = false;
+        if (key >= 0)
+        {
+            ExtractDelta(previous.data(), current.data(), 4, plane.data(), width, rect, static_cast<uint8_t>(key), delta);
+            CompressGifFrame(delta.data(), delta.size(), table_bits, compressed);
+            // 原来的图像数据（含最小码长字节）与新数据比较
+            if (compressed.size() < pos - data_start)
+            {
+                const uint8_t control[] = {0x21, 0xF9, 0x04, static_cast<uint8_t>((1 << 2) | 1)};
+                out.append(reinterpret_cast<const char *>(control), sizeof(control));
+                PutLE16(out, delay);
+                out.push_back(static_cast<char>(key));
+                out.push_back(0);
+                out.push_back(0x2C);
+                PutLE16(out, rect.x);
+                PutLE16(out, rect.y);
+                PutLE16(out, rect.width);
+                PutLE16(out, rect.height);
+                out.push_back(static_cast<char>(packed & 0x87)); // 保留局部颜色表，去掉交错和排序标志
+                if (local)
+                    out.append(d, start + 10, data_start - start - 10);
+                out.append(reinterpret_cast<const char *>(compressed.data()), compressed.size());
+                rewritten = true;
+            }
+        }
+        if (!rewritten)
+        {
+            if (control_end > control_start)
+                out.append(d, control_start, control_end - control_start);
+            out.append(d, start, pos - start);
+        }
+
+        std::swap(previous, current);
+        control_start = control_end = 0;
+        delay = disposal = 0;
+        transparent = -1;
+    }
+
+    std::string temp_path = path + ".part";
+    {
+        std::ofstream file(temp_path, std::ios::binary | std::ios::trunc);
+        file.write(out.data(), out.size());
+        if (!file)
+        {
+            file.close();
+            std::remove(temp_path.c_str());
+            return "写入输出文件失败：" + path;
+        }
+    }
+    if (std::rename(temp_path.c_str(), path.c_str()) != 0)
+    {
+        std::remove(temp_path.c_str());
+        return "无法替换输出文件：" + path;
+    }
+    after = out.size();
+    return "";
+}
+
+#endif // GIFCMD_GIF_OPTIMIZE_HPP
@@ -0,0 +1,197 @@
+#ifndef GIFCMD_GIF_STITCH_HPP
+#define GIFCMD_GIF_STITCH_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <cstdio>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <string_view>
+#include <vector>
+
+// 按字节拼接多个GIF89a分段，不重新编码：
+//  - 文件头、逻辑屏幕描述符和全局颜色表取自第一段
+//  - 后续分段的应用扩展（NETSCAPE循环块）、其余文件头和结束符被丢弃
+//  - 后续分段的全局颜色表与第一段不同时，作为局部颜色表注入该段未带局部表的图像
+// 所有分段必须具有相同的逻辑屏幕尺寸
+namespace gif_stitch_detail
+{
+    inline uint16_t ReadLE16(const unsigned char *p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+    // 跳过以0长度结尾的数据子块序列，返回结束后的位置；越界返回0
+    inline size_t SkipSubBlocks(const std::string &data, size_t pos)
+    {
+        while (pos < data.size())
+        {
+            size_t length = static_cast<unsigned char>(data[pos]);
+            pos++;
+            if (length == 0)
+                return pos;
+            pos += length;
+        }
+        return 0;
+    }
+
+    struct Segment
+    {
+        std::string data;
+        uint16_t width = 0;
+        uint16_t height = 0;
+        unsigned char packed = 0; // 逻辑屏幕描述符的标志字节
+        size_t table_offset = 0;  // 全局颜色表位置（紧接描述符之后）
+        size_t table_size = 0;    // 全局颜色表字节数（无表为0）
+        size_t blocks_offset = 0; // 第一个扩展/图像块位置
+
+        std::string_view GlobalTable() const { return std::string_view(data).substr(table_offset, table_size); }
+    };
+
+    inline bool ParseHeader(Segment &segment)
+    {
+        const std::string &d = segment.data;
+        if (d.size() < 13 || (d.compare(0, 6, "GIF89a") != 0 && d.compare(0, 6, "GIF87a") != 0))
+            return false;
+        auto *p = reinterpret_cast<const unsigned char *>(d.data());
+        segment.width = ReadLE16(p + 6);
+        segment.height = ReadLE16(p + 8);
+        segment.packed = p[10];
+        segment.table_offset = 13;
+        segment.table_size = (segment.packed & 0x80) ? 3u << ((segment.packed & 0x07) + 1) : 0;
+        segment.blocks_offset = segment.table_offset + segment.table_size;
+        return segment.blocks_offset <= d.size();
+    }
+}
+
+// 拼接 segment_paths 中的GIF分段写入 output_path（先写临时文件，完成后重命名）
+// 返回错误信息（成功时为空）；frame_count 不为空时输出总帧数
+inline std::string StitchGifSegments(const std::vector<std::string> &segment_paths, const std::string &output_path,
+                                     size_t *frame_count = nullptr)
+{
+    using namespace gif_stitch_detail;
+
+    if (segment_paths.empty())
+        return "没有可拼接的GIF分段";
+
+    std::string temp_path = output_path + ".part";
+    std::ofstream out(temp_path, std::ios::binary | std::ios::trunc);
+    if (!out.is_open())
+        return "无法创建输出文件 " + temp_path;
+
+    auto fail = [&](const std::string &message)
+    {
+        out.close();
+        std::remove(temp_path.c_str());
+        return message;
+    };
+
+    Segment first;
+    size_t frames = 0;
+    for (size_t s = 0; s < segment_paths.size(); s++)
+    {
+        Segment current;
+        {
+            std::ifstream in(segment_paths[s], std::ios::binary);
+            if (!in.is_open())
+                return fail("无法读取分段 " + segment_paths[s]);
+            current.data.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        if (!ParseHeader(current))
+            return fail("分段不是有效的GIF文件：" + segment_paths[s]);
+
+        const std::string &d = current.data;
+        bool inject_table = false;
+        if (s == 0)
+        {
+            out.write(d.data(), current.blocks_offset); // 文件头 + 逻辑屏幕描述符 + 全局颜色表
+        }
+        else
+        {
+            if (current.width != first.width || current.height != first.height)
+                return fail("分段尺寸不一致：" + segment_paths[s]);
+            inject_table = current.table_size > 0 && current.GlobalTable() != first.GlobalTable();
+        }
+
+        size_t pos = current.blocks_offset;
+        bool trailer = false;
+        while (!trailer)
+        {
+            if (pos >= d.size())
+                return fail("分段数据不完整：" + segment_paths[s]);
+
+            size_t start = pos;
+            unsigned char introducer = static_cast<unsigned char>(d[pos]);
+            if (introducer == 0x3B)
+            {
+                trailer = true;
+            }
+            else if (introducer == 0x21)
+            {
+                if (pos + 2 > d.size())
+                    return fail("分段数据不完整：" + segment_paths[s]);
+                unsigned char label = static_cast<unsigned char>(d[pos + 1]);
+                pos = SkipSubBlocks(d, pos + 2);
+                if (pos == 0)
+                    return fail("分段数据不完整：" + segment_paths[s]);
+                // 循环次数等应用扩展只保留第一段的
+                if (s == 0 || label != 0xFF)
+                    out.write(d.data() + start, pos - start);
+            }
+            else if (introducer == 0x2C)
+            {
+                if (pos + 11 > d.size())
+                    return fail("分段数据不完整：" + segment_paths[s]);
+                unsigned char image_packed = static_cast<unsigned char>(d[pos + 9]);
+                size_t local_table = (image_packed & 0x80) ? 3u << ((image_packed & 0x07) + 1) : 0;
+                size_t data_start = pos + 10 + local_table; // LZW最小码长字节
+                pos = SkipSubBlocks(d, data_start + 1);
+                if (pos == 0)
+                    return fail("分段数据不完整：" + segment_paths[s]);
+
+                if (inject_table && local_table == 0)
+                {
+                    // 以本段的全局颜色表作为局部颜色表（去掉排序标志，保留交错标志）
+                    char descriptor[10];
+                    std::copy(d.data() + start, d.data() + start + 9, descriptor);
+                    descriptor[9] = static_cast<char>(0x80 | (image_packed & 0x40) | (current.packed & 0x07));
+                    out.write(descriptor, sizeof(descriptor));
+                    std::string_view table = current.GlobalTable();
+                    out.write(table.data(), table.size());
+                    out.write(d.data() + data_start, pos - data_start);
+                }
+                else
+                {
+                    out.write(d.data() + start, pos - start);
+                }
+                frames++;
+            }
+            else
+            {
+                return fail("分段包含未知的数据块：" + segment_paths[s]);
+            }
+        }
+
+        if (s == 0)
+        {
+            current.data.resize(current.blocks_offset); // 之后只需比较尺寸和全局颜色表
+            first = std::move(current);
+        }
+    }
+
+    out.put(0x3B);
+    out.close();
+    if (!out)
+    {
+        std::remove(temp_path.c_str());
+        return "写入输出文件失败：" + output_path;
+    }
+    if (std::rename(temp_path.c_str(), output_path.c_str()) != 0)
+    {
+        std::remove(temp_path.c_str());
+        return "无法替换输出文件：" + output_path;
+    }
+    if (frame_count)
+        *frame_count = frames;
+    return "";
+}
+
+#endif // GIFCMD_GIF_STITCH_HPP
@@ -0,0 +1,127 @@
+#ifndef GIFCMD_GIF_WRITER_HPP
+#define GIFCMD_GIF_WRITER_HPP
+
+#include <cstdint>
+#include <cstdio>
+#include <string>
+#include <vector>
+#include "color_quantizer.hpp"
+#include "gif_lzw.hpp"
+
+// GIF LZW 压缩：输入为调色板索引，输出为已按255字节分块的图像数据（含最小码长字节和结尾的0块）
+// 各帧互不依赖，可在不同线程中并行调用（每个线程复用自己的编码器）
+inline void CompressGifFrame(const uint8_t *indices, size_t count, int palette_bits, std::vector<uint8_t> &out)
+{
+    thread_local GifLzwEncoder encoder;
+    encoder.Encode(indices, count, std::max(2, palette_bits), out);
+}
+
+// 调色板位数：能容纳 size 种颜色的最小位数（1-8）
+inline int PaletteBits(int size)
+{
+    int bits = 1;
+    while ((1 << bits) < size)
+        bits++;
+    return bits;
+}
+
+// 顺序写出GIF89a文件：全局调色板、循环扩展和逐帧的图像块
+class GifWriter
+{
+public:
+    ~GifWriter()
+    {
+        if (file_)
+            std::fclose(file_);
+    }
+
+    // loop_count：0为无限循环
+    bool Open(const std::string &path, int width, int height, const Palette &palette, int loop_count)
+    {
+        file_ = std::fopen(path.c_str(), "wb");
+        if (!file_)
+            return false;
+
+        int bits = PaletteBits(palette.size);
+        std::string header = "GIF89a";
+        Put(header.data(), header.size());
+        PutLE16(width);
+        PutLE16(height);
+        PutByte(static_cast<uint8_t>(0x80 | ((bits - 1) << 4) | (bits - 1))); // 全局颜色表
+        PutByte(0);                                                           // 背景色
+        PutByte(0);                                                           // 像素宽高比
+        PutPalette(palette, bits);
+
+        // NETSCAPE2.0 循环扩展
+        const uint8_t netscape[] = {0x21, 0xFF, 0x0B, 'N', 'E', 'T', 'S', 'C', 'A', 'P', 'E', '2', '.', '0', 0x03, 0x01};
+        Put(netscape, sizeof(netscape));
+        PutLE16(loop_count);
+        PutByte(0);
+        return !std::ferror(file_);
+    }
+
+    // 写出一帧：delay 单位为1/100秒；compressed 为 CompressGifFrame 的输出
+    // local_palette 不为空时作为局部颜色表；transparent_index >= 0 时启用透明色
+    void WriteFrame(int x, int y, int width, int height, int delay, const std::vector<uint8_t> &compressed,
+                    const Palette *local_palette = nullptr, int transparent_index = -1, int disposal = 1)
+    {
+        const uint8_t control[] = {0x21, 0xF9, 0x04,
+                                   static_cast<uint8_t>((disposal << 2) | (transparent_index >= 0 ? 1 : 0))};
+        Put(control, sizeof(control));
+        PutLE16(delay);
+        PutByte(static_cast<uint8_t>(transparent_index >= 0 ? transparent_index : 0));
+        PutByte(0);
+
+        PutByte(0x2C);
+        PutLE16(x);
+        PutLE16(y);
+        PutLE16(width);
+        PutLE16(height);
+        if (local_palette)
+        {
+            int bits = PaletteBits(local_palette->size);
+            PutByte(static_cast<uint8_t>(0x80 | (bits - 1)));
+            PutPalette(*local_palette, bits);
+        }
+        else
+        {
+            PutByte(0);
+        }
+        Put(compressed.data(), compressed.size());
+    }
+
+    // 写入结束符并关闭文件；返回是否全部写入成功
+    bool Close()
+    {
+        if (!file_)
+            return false;
+        PutByte(0x3B);
+        bool ok = !std::ferror(file_);
+        ok = std::fclose(file_) == 0 && ok;
+        file_ = nullptr;
+        return ok;
+    }
+
+private:
+    void Put(const void *data, size_t size) { std::fwrite(data, 1, size, file_); }
+    void PutByte(uint8_t value) { std::fputc(value, file_); }
+    void PutLE16(int value)
+    {
+        PutByte(static_cast<uint8_t>(value & 0xFF));
+        PutByte(static_cast<uint8_t>((value >> 8) & 0xFF));
+    }
+    void PutPalette(const Palette &palette, int bits)
+    {
+        for (int i = 0; i < (1 << bits); i++)
+        {
+            if (i < palette.size)
+                Put(palette.colors[i], 3);
+            else
+                Put("\0\0\0", 3);
+        }
+    }
+
+    std::FILE *file_ = nullptr;
+};
+
+#endif // GIFCMD_GIF_WRITER_HPP
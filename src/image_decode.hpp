@@ -0,0 +1,333 @@
+#ifndef GIFCMD_IMAGE_DECODE_HPP
+#define GIFCMD_IMAGE_DECODE_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "frame_pool.hpp"
+
+#ifdef GIFCMD_WITH_LIBJPEG
+#include <csetjmp>
+#include <jpeglib.h>
+#endif
+#ifdef GIFCMD_WITH_LIBPNG
+#include <png.h>
+#endif
+
+// 进程内图像解码：内置 PPM/PGM（P5/P6）和未压缩 BMP（8/24/32位）解码器
+// 编译时定义 GIFCMD_WITH_LIBJPEG / GIFCMD_WITH_LIBPNG（并链接 -ljpeg / -lpng）可额外解码JPEG/PNG
+// 其余格式不在进程内解码，由调用方回退到ffmpeg
+
+// 8位RGB图像：缓冲区来自帧缓冲池，每行起始地址按64字节对齐，行尾可能有填充（行之间不连续）
+// 只能移动；尺寸不变时 Resize 沿用原缓冲区，尺寸改变时把原缓冲区归还池中再取同尺寸的缓冲区
+// 分配失败（如文件头声明了过大的尺寸）时 Resize 返回false，图像变为 0x0 且没有缓冲区，调用方不能再访问 Row
+struct RgbImage
+{
+    int width = 0;
+    int height = 0;
+    FramePool::Handle buffer;
+
+    uint8_t *Row(int y) { return buffer.data() + static_cast<size_t>(y) * buffer.stride(); }
+    const uint8_t *Row(int y) const { return buffer.data() + static_cast<size_t>(y) * buffer.stride(); }
+    size_t stride() const { return buffer.stride(); }
+    size_t bytes() const { return buffer.bytes(); }
+    bool Resize(int w, int h)
+    {
+        if (w == width && h == height && buffer)
+            return true;
+        buffer.Release();
+        buffer = FramePool::Default().Acquire(w, h, PixelFormat::rgb24);
+        width = buffer ? w : 0;
+        height = buffer ? h : 0;
+        return static_cast<bool>(buffer);
+    }
+};
+
+// 后缀名（不含点，大小写不敏感）是否可以在进程内解码
+inline bool CanDecodeNatively(std::string_view extension)
+{
+    std::string ext;
+    for (char c : extension)
+        ext.push_back(static_cast<char>(c >= 'A' && c <= 'Z' ? c - 'A' + 'a' : c));
+    if (ext == "ppm" || ext == "pgm" || ext == "pnm" || ext == "bmp")
+        return true;
+#ifdef GIFCMD_WITH_LIBJPEG
+    if (ext == "jpg" || ext == "jpeg")
+        return true;
+#endif
+#ifdef GIFCMD_WITH_LIBPNG
+    if (ext == "png")
+        return true;
+#endif
+    return false;
+}
+
+namespace image_decode_detail
+{
+    // 读取整个文件（相对 dirfd）
+    inline bool ReadFile(int dirfd, const char *name, std::vector<uint8_t> &data)
+    {
+        int fd = ::openat(dirfd, name, O_RDONLY | O_CLOEXEC);
+        if (fd < 0)
+            return false;
+        struct stat st;
+        if (::fstat(fd, &st) != 0)
+        {
+            ::close(fd);
+            return false;
+        }
+        data.resize(static_cast<size_t>(st.st_size));
+        size_t done = 0;
+        while (done < data.size())
+        {
+            ssize_t n = ::read(fd, data.data() + done, data.size() - done);
+            if (n < 0 && errno == EINTR)
+                continue;
+            if (n <= 0)
+                break;
+            done += static_cast<size_t>(n);
+        }
+        ::close(fd);
+        data.resize(done);
+        return true;
+    }
+
+    inline uint32_t ReadLE32(const uint8_t *p) { return p[0] | (p[1] << 8) | (p[2] << 16) | (static_cast<uint32_t>(p[3]) << 24); }
+    inline uint16_t ReadLE16(const uint8_t *p) { return static_cast<uint16_t>(p[0] | (p[1] << 8)); }
+
+    // PNM头部的下一个十进制数（跳过空白和#注释）
+    inline bool NextNumber(const uint8_t *data, size_t size, size_t &pos, int &value)
+    {
+        for (;;)
+        {
+            while (pos < size && (data[pos] == ' ' || data[pos] == '\t' || data[pos] == '\r' || data[pos] == '\n'))
+                pos++;
+            if (pos < size && data[pos] == '#')
+            {
+                while (pos < size && data[pos] != '\n')
+                    pos++;
+                continue;
+            }
+            break;
+        }
+        if (pos >= size || data[pos] < '0' || data[pos] > '9')
+            return false;
+        value = 0;
+        while (pos < size && data[pos] >= '0' && data[pos] <= '9')
+        {
+            value = value * 10 + (data[pos++] - '0');
+            if (value > (1 << 24))
+                return false;
+        }
+        return true;
+    }
+
+    inline bool DecodePnm(const std::vector<uint8_t> &file, RgbImage &image)
+    {
+        const uint8_t *data = file.data();
+        size_t size = file.size();
+        if (size < 3 || data[0] != 'P' || (data[1] != '5' && data[1] != '6'))
+            return false;
+        bool gray = data[1] == '5';
+        size_t pos = 2;
+        int width, height, maxval;
+        if (!NextNumber(data, size, pos, width) || !NextNumber(data, size, pos, height) ||
+            !NextNumber(data, size, pos, maxval) || width <= 0 || height <= 0 || maxval <= 0 || maxval > 65535)
+            return false;
+        pos++; // 头部之后的单个空白
+
+        int channels = gray ? 1 : 3;
+        int sample_bytes = maxval > 255 ? 2 : 1;
+        size_t needed = static_cast<size_t>(width) * height * channels * sample_bytes;
+        if (pos > size || size - pos < needed)
+            return false;
+
+        if (!image.Resize(width, height))
+            return false;
+        const size_t row_samples = static_cast<size_t>(width) * channels;
+        for (int y = 0; y < height; y++)
+        {
+            const uint8_t *src = data + pos + static_cast<size_t>(y) * row_samples * sample_bytes;
+            uint8_t *dst = image.Row(y);
+            for (size_t i = 0; i < row_samples; i++)
+            {
+                uint32_t v = sample_bytes == 2 ? (src[2 * i] << 8) | src[2 * i + 1] : src[i];
+                uint8_t out = maxval == 255 ? static_cast<uint8_t>(v) : static_cast<uint8_t>((v * 255 + maxval / 2) / maxval);
+                if (gray)
+                {
+                    dst[3 * i] = dst[3 * i + 1] = dst[3 * i + 2] = out;
+                }
+                else
+                {
+                    dst[i] = out;
+                }
+            }
+        }
+        return true;
+    }
+
+    inline bool DecodeBmp(const std::vector<uint8_t> &file, RgbImage &image)
+    {
+        const uint8_t *data = file.data();
+        size_t size = file.size();
+        if (size < 54 || data[0] != 'B' || data[1] != 'M')
+            return false;
+        uint32_t pixel_offset = ReadLE32(data + 10);
+        uint32_t header_size = ReadLE32(data + 14);
+        if (header_size < 40 || 14 + header_size > size)
+            return false;
+        int32_t width = static_cast<int32_t>(ReadLE32(data + 18));
+        int32_t height = static_cast<int32_t>(ReadLE32(data + 22));
+        uint16_t bpp = ReadLE16(data + 28);
+        uint32_t compression = ReadLE32(data + 30);
+        uint32_t colors_used = ReadLE32(data + 46);
+
+        // 只支持未压缩（BI_RGB）和32位的BI_BITFIELDS（按BGRA处理）
+        if (!(compression == 0 || (compression == 3 && bpp == 32)))
+            return false;
+        if (bpp != 8 && bpp != 24 && bpp != 32)
+            return false;
+        bool top_down = height < 0;
+        if (top_down)
+            height = -height;
+        if (width <= 0 || height <= 0 || width > (1 << 16) || height > (1 << 16))
+            return false;
+
+        const uint8_t *palette = data + 14 + header_size;
+        size_t palette_entries = colors_used ? colors_used : 256;
+        if (bpp == 8 && (palette_entries > 256 || 14 + header_size + palette_entries * 4 > size))
+            return false;
+
+        size_t stride = (static_cast<size_t>(width) * bpp / 8 + 3) & ~static_cast<size_t>(3);
+        if (pixel_offset > size || size - pixel_offset < stride * height)
+            return false;
+
+        if (!image.Resize(width, height))
+            return false;
+        for (int y = 0; y < height; y++)
+        {
+            const uint8_t *src = data + pixel_offset + stride * (top_down ? y : height - 1 - y);
+            uint8_t *dst = image.Row(y);
+            for (int x = 0; x < width; x++, dst += 3)
+            {
+                const uint8_t *bgr;
+                if (bpp == 8)
+                {
+                    size_t index = src[x] < palette_entries ? src[x] : 0;
+                    bgr = palette + index * 4;
+                }
+                else
+                {
+                    bgr = src + static_cast<size_t>(x) * (bpp / 8);
+                }
+                dst[0] = bgr[2];
+                dst[1] = bgr[1];
+                dst[2] = bgr[0];
+            }
+        }
+        return true;
+    }
+
+#ifdef GIFCMD_WITH_LIBJPEG
+    struct JpegError
+    {
+        jpeg_error_mgr manager;
+        jmp_buf jump;
+    };
+
+    inline bool DecodeJpeg(const std::vector<uint8_t> &file, RgbImage &image)
+    {
+        jpeg_decompress_struct info;
+        JpegError error;
+        info.err = jpeg_std_error(&error.manager);
+        error.manager.error_exit = [](j_common_ptr cinfo)
+        { longjmp(reinterpret_cast<JpegError *>(cinfo->err)->jump, 1); };
+        if (setjmp(error.jump))
+        {
+            jpeg_destroy_decompress(&info);
+            return false;
+        }
+        jpeg_create_decompress(&info);
+        jpeg_mem_src(&info, file.data(), static_cast<unsigned long>(file.size()));
+        jpeg_read_header(&info, TRUE);
+        info.out_color_space = JCS_RGB;
+        jpeg_start_decompress(&info);
+        if (!image.Resize(static_cast<int>(info.output_width), static_cast<int>(info.output_height)))
+        {
+            jpeg_destroy_decompress(&info);
+            return false;
+        }
+        while (info.output_scanline < info.output_height)
+        {
+            JSAMPROW row = image.Row(static_cast<int>(info.output_scanline));
+            jpeg_read_scanlines(&info, &row, 1);
+        }
+        jpeg_finish_decompress(&info);
+        jpeg_destroy_decompress(&info);
+        return true;
+    }
+#endif
+
+#ifdef GIFCMD_WITH_LIBPNG
+    inline bool DecodePng(const std::vector<uint8_t> &file, RgbImage &image)
+    {
+        png_image png;
+        std::memset(&png, 0, sizeof(png));
+        png.version = PNG_IMAGE_VERSION;
+        if (!png_image_begin_read_from_memory(&png, file.data(), file.size()))
+            return false;
+        png.format = PNG_FORMAT_RGB;
+        if (!image.Resize(static_cast<int>(png.width), static_cast<int>(png.height)))
+        {
+            png_image_free(&png);
+            return false;
+        }
+        bool ok = png_image_finish_read(&png, nullptr, image.Row(0), static_cast<png_int_32>(image.stride()), nullptr) != 0;
+        png_image_free(&png);
+        return ok;
+    }
+#endif
+}
+
+// 读取 dirfd 目录中的文件到 file（复用其容量）；失败时返回false
+inline bool ReadImageFile(int dirfd, const std::string &name, std::vector<uint8_t> &file)
+{
+    return image_decode_detail::ReadFile(dirfd, name.c_str(), file);
+}
+
+// 解码内存中的图像文件，按文件头判断格式；失败时返回false
+inline bool DecodeImage(const std::vector<uint8_t> &file, RgbImage &image)
+{
+    using namespace image_decode_detail;
+
+    if (file.size() < 4)
+        return false;
+    if (file[0] == 'P' && (file[1] == '5' || file[1] == '6'))
+        return DecodePnm(file, image);
+    if (file[0] == 'B' && file[1] == 'M')
+        return DecodeBmp(file, image);
+#ifdef GIFCMD_WITH_LIBJPEG
+    if (file[0] == 0xFF && file[1] == 0xD8)
+        return DecodeJpeg(file, image);
+#endif
+#ifdef GIFCMD_WITH_LIBPNG
+    if (file[0] == 0x89 && file[1] == 'P' && file[2] == 'N' && file[3] == 'G')
+        return DecodePng(file, image);
+#endif
+    return false;
+}
+
+// 解码 dirfd 目录中的图像文件；失败时返回false
+inline bool DecodeImageFile(int dirfd, const std::string &name, RgbImage &image)
+{
+    std::vector<uint8_t> file;
+    return ReadImageFile(dirfd, name, file) && DecodeImage(file, image);
+}
+
+#endif // GIFCMD_IMAGE_DECODE_HPP
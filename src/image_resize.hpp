@@ -0,0 +1,476 @@
+#ifndef GIFCMD_IMAGE_RESIZE_HPP
+#define GIFCMD_IMAGE_RESIZE_HPP
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <vector>
+#include "cpu_features.hpp"
+#include "image_decode.hpp"
+
+// 进程内缩放
+//  1. 缩小倍数较大时先按整数倍做区域平均（box）预缩小，使剩余倍数落在 [2, 4) 之间
+//  2. 再做可分离的卷积缩放：先水平后垂直，滤波器为 Lanczos3 或双线性（三角形），缩小时按倍数展宽以抗混叠
+// 系数为14位定点整数；AVX2/SSE4.1内核与标量实现的结果逐字节相同
+enum class ResizeFilter
+{
+    bilinear,
+    lanczos,
+};
+
+// 按宽度等比缩放时的目标高度（与 ffmpeg scale=W:-1 一致，至少为1）
+inline int ScaledHeight(int src_width, int src_height, int width)
+{
+    if (src_width <= 0)
+        return 0;
+    long long h = (static_cast<long long>(src_height) * width + src_width / 2) / src_width;
+    return static_cast<int>(std::max(1LL, h));
+}
+
+namespace image_resize_detail
+{
+    const int coefficient_bits = 14;
+    const int max_box_factor = 64;
+
+    // 一个方向的滤波系数：每个输出位置从 start[i] 开始的 taps 个输入，系数按偶数个补零（SIMD按两个一组相乘）
+    struct FilterBank
+    {
+        int taps = 0;
+        int stride = 0; // taps 向上取偶数
+        std::vector<int> start;
+        std::vector<int16_t> weights; // 输出数 * stride
+
+        const int16_t *Weights(int i) const { return weights.data() + static_cast<size_t>(i) * stride; }
+    };
+
+    inline double Lanczos3(double x)
+    {
+        x = std::fabs(x);
+        if (x < 1e-8)
+            return 1.0;
+        if (x >= 3.0)
+            return 0.0;
+        const double pi = 3.14159265358979323846;
+        double px = pi * x;
+        return 3.0 * std::sin(px) * std::sin(px / 3.0) / (px * px);
+    }
+
+    inline double Triangle(double x)
+    {
+        x = std::fabs(x);
+        return x < 1.0 ? 1.0 - x : 0.0;
+    }
+
+    // in_size 个输入映射到 out_size 个输出；in_extent 为输入覆盖的长度（预缩小时末尾的不完整块使其不是整数）
+    inline FilterBank BuildFilterBank(int in_size, double in_extent, int out_size, ResizeFilter filter)
+    {
+        const double scale = in_extent / out_size;
+        const double filter_scale = std::max(1.0, scale);
+        const double support = (filter == ResizeFilter::lanczos ? 3.0 : 1.0) * filter_scale;
+
+        FilterBank bank;
+        bank.taps = std::min(in_size, static_cast<int>(std::ceil(support)) * 2 + 1);
+        bank.stride = (bank.taps + 1) & ~1;
+        bank.start.resize(out_size);
+        bank.weights.assign(static_cast<size_t>(out_size) * bank.stride, 0);
+
+        std::vector<double> w(bank.taps);
+        for (int i = 0; i < out_size; i++)
+        {
+            double center = (i + 0.5) * scale;
+            int lo = std::max(0, static_cast<int>(std::floor(center - support + 0.5)));
+            int hi = std::min(in_size, static_cast<int>(std::floor(center + support + 0.5)));
+            int start = std::clamp(lo, 0, in_size - bank.taps);
+            hi = std::min(hi, start + bank.taps);
+            lo = std::max(lo, start);
+
+            double sum = 0;
+            std::fill(w.begin(), w.end(), 0.0);
+            for (int x = lo; x < hi; x++)
+            {
+                double value = filter == ResizeFilter::lanczos ? Lanczos3((x + 0.5 - center) / filter_scale)
+                                                               : Triangle((x + 0.5 - center) / filter_scale);
+                w[x - start] = value;
+                sum += value;
+            }
+            if (sum == 0) // 放大时落在边缘之外：取最近的输入
+            {
+                w[std::clamp(static_cast<int>(center) - start, 0, bank.taps - 1)] = 1.0;
+                sum = 1.0;
+            }
+
+            // 量化后把舍入误差加到最大的系数上，使系数和精确为 1 << coefficient_bits（纯色保持不变）
+            int16_t *out = bank.weights.data() + static_cast<size_t>(i) * bank.stride;
+            int total = 0, largest = 0;
+            for (int j = 0; j < bank.taps; j++)
+            {
+                out[j] = static_cast<int16_t>(std::lround(w[j] / sum * (1 << coefficient_bits)));
+                total += out[j];
+                if (out[j] > out[largest])
+                    largest = j;
+            }
+            out[largest] = static_cast<int16_t>(out[largest] + (1 << coefficient_bits) - total);
+            bank.start[i] = start;
+        }
+        return bank;
+    }
+
+    inline uint8_t ClampPixel(int value)
+    {
+        return static_cast<uint8_t>(std::clamp(value >> coefficient_bits, 0, 255));
+    }
+
+    // 区域平均的垂直部分：sums[i] += row[i]（n 个字节）
+    inline void AccumulateRowScalar(const uint8_t *row, size_t n, uint16_t *sums)
+    {
+        for (size_t i = 0; i < n; i++)
+            sums[i] += row[i];
+    }
+
+    // 水平卷积：row 为补齐过的一行像素（末尾至少8个0字节），输出 out_width 个像素
+    inline void HorizontalScalar(const uint8_t *row, const FilterBank &bank, int out_width, uint8_t *out)
+    {
+        for (int x = 0; x < out_width; x++)
+        {
+            const uint8_t *p = row + bank.start[x] * 3;
+            const int16_t *w = bank.Weights(x);
+            int acc[3] = {1 << (coefficient_bits - 1), 1 << (coefficient_bits - 1), 1 << (coefficient_bits - 1)};
+            for (int j = 0; j < bank.taps; j++, p += 3)
+            {
+                acc[0] += w[j] * p[0];
+                acc[1] += w[j] * p[1];
+                acc[2] += w[j] * p[2];
+            }
+            out[x * 3] = ClampPixel(acc[0]);
+            out[x * 3 + 1] = ClampPixel(acc[1]);
+            out[x * 3 + 2] = ClampPixel(acc[2]);
+        }
+    }
+
+    // 垂直卷积：rows 为 stride 个输入行（补齐的行系数为0），每行 n 个字节
+    inline void VerticalScalar(const uint8_t *const *rows, const int16_t *w, int taps, size_t begin, size_t n,
+                               uint8_t *out)
+    {
+        for (size_t i = begin; i < n; i++)
+        {
+            int acc = 1 << (coefficient_bits - 1);
+            for (int j = 0; j < taps; j++)
+                acc += w[j] * rows[j][i];
+            out[i] = ClampPixel(acc);
+        }
+    }
+
+#ifdef GIFCMD_X86
+    GIFCMD_TARGET_SSE41 inline void AccumulateRowSse41(const uint8_t *row, size_t n, uint16_t *sums)
+    {
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i v = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(row + i)));
+            __m128i s = _mm_loadu_si128(reinterpret_cast<const __m128i *>(sums + i));
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(sums + i), _mm_add_epi16(s, v));
+        }
+        AccumulateRowScalar(row + i, n - i, sums + i);
+    }
+
+    GIFCMD_TARGET_AVX2 inline void AccumulateRowAvx2(const uint8_t *row, size_t n, uint16_t *sums)
+    {
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i v = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(row + i)));
+            __m256i s = _mm256_loadu_si256(reinterpret_cast<const __m256i *>(sums + i));
+            _mm256_storeu_si256(reinterpret_cast<__m256i *>(sums + i), _mm256_add_epi16(s, v));
+        }
+        AccumulateRowScalar(row + i, n - i, sums + i);
+    }
+
+    // 相邻两个输入像素 (r0 g0 b0 r1 g1 b1) 重排为 16 位的 (r0 r1 g0 g1 b0 b1 0 0)，与系数对 (w0 w1) 做 madd
+    GIFCMD_TARGET_SSE41 inline __m128i PixelPairMask()
+    {
+        return _mm_setr_epi8(0, -1, 3, -1, 1, -1, 4, -1, 2, -1, 5, -1, -1, -1, -1, -1);
+    }
+
+    GIFCMD_TARGET_SSE41 inline void StorePixel(__m128i acc, uint8_t *out)
+    {
+        __m128i v = _mm_srai_epi32(acc, coefficient_bits);
+        v = _mm_packus_epi16(_mm_packs_epi32(v, v), v);
+        uint32_t rgb = static_cast<uint32_t>(_mm_cvtsi128_si32(v));
+        std::memcpy(out, &rgb, 3);
+    }
+
+    // 计算第 x 个输出像素
+    GIFCMD_TARGET_SSE41 inline void HorizontalPixelSse41(const uint8_t *row, const FilterBank &bank, int x, uint8_t *out)
+    {
+        const __m128i mask = PixelPairMask();
+        const uint8_t *p = row + bank.start[x] * 3;
+        const int16_t *w = bank.Weights(x);
+        __m128i acc = _mm_set1_epi32(1 << (coefficient_bits - 1));
+        for (int j = 0; j < bank.stride; j += 2, p += 6)
+        {
+            int32_t pair;
+            std::memcpy(&pair, w + j, 4);
+            __m128i pixels = _mm_shuffle_epi8(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p)), mask);
+            acc = _mm_add_epi32(acc, _mm_madd_epi16(pixels, _mm_set1_epi32(pair)));
+        }
+        StorePixel(acc, out + x * 3);
+    }
+
+    GIFCMD_TARGET_SSE41 inline void HorizontalSse41(const uint8_t *row, const FilterBank &bank, int out_width,
+                                                    uint8_t *out)
+    {
+        for (int x = 0; x < out_width; x++)
+            HorizontalPixelSse41(row, bank, x, out);
+    }
+
+    // 两个输出像素分别放在高低两个128位通道中，奇数宽度的最后一个像素用SSE4.1计算
+    GIFCMD_TARGET_AVX2 inline void HorizontalAvx2(const uint8_t *row, const FilterBank &bank, int out_width,
+                                                  uint8_t *out)
+    {
+        const __m256i mask = _mm256_broadcastsi128_si256(PixelPairMask());
+        const __m256i round = _mm256_set1_epi32(1 << (coefficient_bits - 1));
+        int x = 0;
+        for (; x + 2 <= out_width; x += 2)
+        {
+            const uint8_t *p0 = row + bank.start[x] * 3;
+            const uint8_t *p1 = row + bank.start[x + 1] * 3;
+            const int16_t *w0 = bank.Weights(x);
+            const int16_t *w1 = bank.Weights(x + 1);
+            __m256i acc = round;
+            for (int j = 0; j < bank.stride; j += 2, p0 += 6, p1 += 6)
+            {
+                int32_t pair0, pair1;
+                std::memcpy(&pair0, w0 + j, 4);
+                std::memcpy(&pair1, w1 + j, 4);
+                __m256i pixels = _mm256_inserti128_si256(
+                    _mm256_castsi128_si256(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(p0))),
+                    _mm_loadl_epi64(reinterpret_cast<const __m128i *>(p1)), 1);
+                __m256i weights = _mm256_setr_epi32(pair0, pair0, pair0, pair0, pair1, pair1, pair1, pair1);
+                acc = _mm256_add_epi32(acc, _mm256_madd_epi16(_mm256_shuffle_epi8(pixels, mask), weights));
+            }
+            StorePixel(_mm256_castsi256_si128(acc), out + x * 3);
+            StorePixel(_mm256_extracti128_si256(acc, 1), out + (x + 1) * 3);
+        }
+        if (x < out_width)
+            HorizontalPixelSse41(row, bank, x, out);
+    }
+
+    GIFCMD_TARGET_SSE41 inline void VerticalSse41(const uint8_t *const *rows, const int16_t *w, int taps, size_t n,
+                                                  uint8_t *out)
+    {
+        const __m128i round = _mm_set1_epi32(1 << (coefficient_bits - 1));
+        const int stride = (taps + 1) & ~1;
+        size_t i = 0;
+        for (; i + 8 <= n; i += 8)
+        {
+            __m128i acc0 = round, acc1 = round;
+            for (int j = 0; j < stride; j += 2)
+            {
+                int32_t pair;
+                std::memcpy(&pair, w + j, 4);
+                __m128i weights = _mm_set1_epi32(pair);
+                __m128i a = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[j] + i)));
+                __m128i b = _mm_cvtepu8_epi16(_mm_loadl_epi64(reinterpret_cast<const __m128i *>(rows[j + 1] + i)));
+                acc0 = _mm_add_epi32(acc0, _mm_madd_epi16(_mm_unpacklo_epi16(a, b), weights));
+                acc1 = _mm_add_epi32(acc1, _mm_madd_epi16(_mm_unpackhi_epi16(a, b), weights));
+            }
+            __m128i v = _mm_packs_epi32(_mm_srai_epi32(acc0, coefficient_bits), _mm_srai_epi32(acc1, coefficient_bits));
+            _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(v, v));
+        }
+        VerticalScalar(rows, w, taps, i, n, out);
+    }
+
+    GIFCMD_TARGET_AVX2 inline void VerticalAvx2(const uint8_t *const *rows, const int16_t *w, int taps, size_t n,
+                                                uint8_t *out)
+    {
+        const __m256i round = _mm256_set1_epi32(1 << (coefficient_bits - 1));
+        const int stride = (taps + 1) & ~1;
+        size_t i = 0;
+        for (; i + 16 <= n; i += 16)
+        {
+            __m256i acc0 = round, acc1 = round;
+            for (int j = 0; j < stride; j += 2)
+            {
+                int32_t pair;
+                std::memcpy(&pair, w + j, 4);
+                __m256i weights = _mm256_set1_epi32(pair);
+                __m256i a = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[j] + i)));
+                __m256i b = _mm256_cvtepu8_epi16(_mm_loadu_si128(reinterpret_cast<const __m128i *>(rows[j + 1] + i)));
+                acc0 = _mm256_add_epi32(acc0, _mm256_madd_epi16(_mm256_unpacklo_epi16(a, b), weights));
+                acc1 = _mm256_add_epi32(acc1, _mm256_madd_epi16(_mm256_unpackhi_epi16(a, b), weights));
+            }
+            // unpack 在128位通道内交错，packs 恰好恢复原顺序：[0-3 4-7 | 8-11 12-15]
+            __m256i v = _mm256_packs_epi32(_mm256_srai_epi32(acc0, coefficient_bits),
+                                           _mm256_srai_epi32(acc1, coefficient_bits));
+            v = _mm256_permute4x64_epi64(_mm256_packus_epi16(v, v), 0x08);
+            _mm_storeu_si128(reinterpret_cast<__m128i *>(out + i), _mm256_castsi256_si128(v));
+        }
+        VerticalScalar(rows, w, taps, i, n, out);
+    }
+#endif
+
+    inline void AccumulateRow(SimdLevel level, const uint8_t *row, size_t n, uint16_t *sums)
+    {
+#ifdef GIFCMD_X86
+        if (level == SimdLevel::avx2)
+            return AccumulateRowAvx2(row, n, sums);
+        if (level == SimdLevel::sse41)
+            return AccumulateRowSse41(row, n, sums);
+#endif
+        AccumulateRowScalar(row, n, sums);
+    }
+
+    inline void Horizontal(SimdLevel level, const uint8_t *row, const FilterBank &bank, int out_width, uint8_t *out)
+    {
+#ifdef GIFCMD_X86
+        if (level == SimdLevel::avx2)
+            return HorizontalAvx2(row, bank, out_width, out);
+        if (level == SimdLevel::sse41)
+            return HorizontalSse41(row, bank, out_width, out);
+#endif
+        HorizontalScalar(row, bank, out_width, out);
+    }
+
+    inline void Vertical(SimdLevel level, const uint8_t *const *rows, const int16_t *w, int taps, size_t n,
+                         uint8_t *out)
+    {
+#ifdef GIFCMD_X86
+        if (level == SimdLevel::avx2)
+            return VerticalAvx2(rows, w, taps, n, out);
+        if (level == SimdLevel::sse41)
+            return VerticalSse41(rows, w, taps, n, out);
+#endif
+        VerticalScalar(rows, w, taps, 0, n, out);
+    }
+
+    // 同一线程上次生成的滤波系数：连续缩放相同尺寸的帧时不再重新计算和分配
+    struct FilterBankCache
+    {
+        int in_size = -1;
+        double in_extent = 0;
+        int out_size = -1;
+        ResizeFilter filter = ResizeFilter::lanczos;
+        FilterBank bank;
+    };
+
+    inline const FilterBank &CachedFilterBank(FilterBankCache &cache, int in_size, double in_extent, int out_size,
+                                              ResizeFilter filter)
+    {
+        if (cache.in_size != in_size || cache.in_extent != in_extent || cache.out_size != out_size ||
+            cache.filter != filter)
+        {
+            cache.bank = BuildFilterBank(in_size, in_extent, out_size, filter);
+            cache.in_size = in_size;
+            cache.in_extent = in_extent;
+            cache.out_size = out_size;
+            cache.filter = filter;
+        }
+        return cache.bank;
+    }
+
+    // 区域平均预缩小：每 kx * ky 块取平均，右侧和底部不完整的块按实际像素数平均；分配失败时返回false
+    inline bool BoxReduce(const RgbImage &src, int kx, int ky, RgbImage &dst, SimdLevel level)
+    {
+        const int width = (src.width + kx - 1) / kx;
+        const int height = (src.height + ky - 1) / ky;
+        if (!dst.Resize(width, height))
+            return false;
+        const size_t row_bytes = static_cast<size_t>(src.width) * 3;
+        thread_local std::vector<uint16_t> sums;
+        sums.resize(row_bytes);
+        for (int by = 0; by < height; by++)
+        {
+            int y0 = by * ky, y1 = std::min(src.height, y0 + ky);
+            std::fill(sums.begin(), sums.end(), 0);
+            for (int y = y0; y < y1; y++)
+                AccumulateRow(level, src.Row(y), row_bytes, sums.data());
+
+            uint8_t *out = dst.Row(by);
+            for (int bx = 0; bx < width; bx++)
+            {
+                int x0 = bx * kx, x1 = std::min(src.width, x0 + kx);
+                uint32_t count = static_cast<uint32_t>((x1 - x0) * (y1 - y0));
+                uint32_t acc[3] = {count / 2, count / 2, count / 2};
+                for (const uint16_t *s = sums.data() + x0 * 3, *end = sums.data() + x1 * 3; s < end; s += 3)
+                {
+                    acc[0] += s[0];
+                    acc[1] += s[1];
+                    acc[2] += s[2];
+                }
+                out[bx * 3] = static_cast<uint8_t>(acc[0] / count);
+                out[bx * 3 + 1] = static_cast<uint8_t>(acc[1] / count);
+                out[bx * 3 + 2] = static_cast<uint8_t>(acc[2] / count);
+            }
+        }
+        return true;
+    }
+}
+
+// 缩放 src 到 width x height；level 一般取默认值（运行时检测），指定时可用于核对各实现的结果
+// 中间结果取自帧缓冲池，系数和行缓冲区按线程复用，稳定运行时不分配内存
+// 帧缓冲池分配失败时返回false，dst 为 0x0
+inline bool ResizeImage(const RgbImage &src, int width, int height, RgbImage &dst,
+                        ResizeFilter filter = ResizeFilter::lanczos, SimdLevel level = DetectSimdLevel())
+{
+    using namespace image_resize_detail;
+
+    if (!dst.Resize(width, height))
+        return false;
+    if (src.width == width && src.height == height)
+    {
+        for (int y = 0; y < height; y++)
+            std::memcpy(dst.Row(y), src.Row(y), static_cast<size_t>(width) * 3);
+        return true;
+    }
+
+    // 剩余倍数保持在 [2, 4) 之间，由卷积滤波完成最后的缩小
+    const int kx = std::clamp(src.width / width / 2, 1, max_box_factor);
+    const int ky = std::clamp(src.height / height / 2, 1, max_box_factor);
+    RgbImage reduced;
+    const RgbImage *input = &src;
+    if (kx > 1 || ky > 1)
+    {
+        if (!BoxReduce(src, kx, ky, reduced, level))
+        {
+            dst.Resize(0, 0);
+            return false;
+        }
+        input = &reduced;
+    }
+
+    thread_local FilterBankCache column_cache, row_cache;
+    const FilterBank &columns =
+        CachedFilterBank(column_cache, input->width, static_cast<double>(src.width) / kx, width, filter);
+    const FilterBank &rows = CachedFilterBank(row_cache, input->height, static_cast<double>(src.height) / ky, height, filter);
+
+    // 水平方向：只处理垂直滤波用到的输入行；每行复制到末尾补0的缓冲区，SIMD内核可以多读几个字节
+    const int first_row = rows.start.front();
+    const int last_row = rows.start.back() + rows.taps; // 不含
+    RgbImage horizontal;
+    if (!horizontal.Resize(width, last_row - first_row))
+    {
+        dst.Resize(0, 0);
+        return false;
+    }
+    thread_local std::vector<uint8_t> padded;
+    padded.assign(static_cast<size_t>(input->width) * 3 + 16, 0);
+    for (int y = first_row; y < last_row; y++)
+    {
+        std::memcpy(padded.data(), input->Row(y), static_cast<size_t>(input->width) * 3);
+        Horizontal(level, padded.data(), columns, width, horizontal.Row(y - first_row));
+    }
+
+    // 垂直方向：补齐到偶数个的行指向最后一个有效行（系数为0）
+    thread_local std::vector<const uint8_t *> taps;
+    taps.resize(rows.stride);
+    for (int y = 0; y < height; y++)
+    {
+        for (int j = 0; j < rows.stride; j++)
+            taps[j] = horizontal.Row(rows.start[y] + std::min(j, rows.taps - 1) - first_row);
+        Vertical(level, taps.data(), rows.Weights(y), rows.taps, static_cast<size_t>(width) * 3, dst.Row(y));
+    }
+    return true;
+}
+
+#endif // GIFCMD_IMAGE_RESIZE_HPP
@@ -0,0 +1,281 @@
+#ifndef GIFCMD_INDEX_CACHE_HPP
+#define GIFCMD_INDEX_CACHE_HPP
+
+#include <cstdint>
+#include <cstring>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include "dir_scanner.hpp"
+#include "frame_index.hpp"
+
+// 帧索引缓存：每个目录一个可mmap的旁路文件，记录每帧的inode、mtime、大小和数字键
+// 目录的 (dev, inode, mtime) 未变时直接载入，否则只对新增或inode变化的文件做stat
+// 注意：原地覆盖写入（不改变目录项）的文件不会被检测到
+const char frame_cache_path[] = ".gifcmd_index";
+
+struct CachedFrameRecord
+{
+    uint64_t ino;
+    int64_t mtime_ns;
+    uint64_t size;
+    uint64_t key;
+    uint32_t name_offset; // 在缓存文件名区中的偏移
+    uint32_t name_length;
+};
+
+struct FrameCacheHeader
+{
+    char magic[4];
+    uint32_t version;
+    uint64_t dir_dev;
+    uint64_t dir_ino;
+    int64_t dir_mtime_ns; // 扫描前记录的目录mtime
+    uint64_t count;
+    uint64_t name_bytes;
+    uint64_t overflowed;   // 帧号超出范围而被忽略的文件数，缓存命中时原样报告
+    uint32_t racy;         // 扫描时目录刚被修改过，同一时间粒度内的改动可能未被发现
+    uint32_t extension_length;
+    char extension[16];
+};
+
+// 一次载入的统计信息
+struct FrameCacheStats
+{
+    bool cache_hit = false; // 目录未变，直接使用缓存
+    size_t reused = 0;      // 增量扫描时复用的条目数
+    size_t stat_calls = 0;  // 增量扫描时执行的stat次数
+};
+
+namespace index_cache_detail
+{
+    const char magic[4] = {'G', 'C', 'I', 'X'};
+    const uint32_t version = 2;
+
+    inline int64_t ToNanoseconds(const struct timespec &ts)
+    {
+        return static_cast<int64_t>(ts.tv_sec) * 1000000000LL + ts.tv_nsec;
+    }
+
+    // 只读映射的缓存文件；析构时解除映射
+    class MappedCache
+    {
+    public:
+        explicit MappedCache(int dirfd)
+        {
+            int fd = ::openat(dirfd, frame_cache_path, O_RDONLY | O_CLOEXEC);
+            if (fd < 0)
+                return;
+            struct stat st;
+            if (::fstat(fd, &st) == 0 && st.st_size >= static_cast<off_t>(sizeof(FrameCacheHeader)))
+            {
+                void *p = ::mmap(nullptr, static_cast<size_t>(st.st_size), PROT_READ, MAP_PRIVATE, fd, 0);
+                if (p != MAP_FAILED)
+                {
+                    data_ = static_cast<const char *>(p);
+                    size_ = static_cast<size_t>(st.st_size);
+                }
+            }
+            ::close(fd);
+            if (data_ && !Validate())
+            {
+                ::munmap(const_cast<char *>(data_), size_);
+                data_ = nullptr;
+            }
+        }
+        ~MappedCache()
+        {
+            if (data_)
+                ::munmap(const_cast<char *>(data_), size_);
+        }
+        MappedCache(const MappedCache &) = delete;
+        MappedCache &operator=(const MappedCache &) = delete;
+
+        bool valid() const { return data_ != nullptr; }
+        const FrameCacheHeader &header() const { return *reinterpret_cast<const FrameCacheHeader *>(data_); }
+        const CachedFrameRecord *records() const
+        {
+            return reinterpret_cast<const CachedFrameRecord *>(data_ + sizeof(FrameCacheHeader));
+        }
+        std::string_view Name(const CachedFrameRecord &record) const
+        {
+            return std::string_view(names_ + record.name_offset, record.name_length);
+        }
+
+    private:
+        bool Validate()
+        {
+            const FrameCacheHeader &h = header();
+            if (std::memcmp(h.magic, magic, sizeof(magic)) != 0 || h.version != version ||
+                h.extension_length > sizeof(h.extension))
+                return false;
+            uint64_t body = sizeof(FrameCacheHeader) + h.count * sizeof(CachedFrameRecord);
+            if (h.count > size_ / sizeof(CachedFrameRecord) || body + h.name_bytes != size_)
+                return false;
+            names_ = data_ + body;
+            for (uint64_t i = 0; i < h.count; i++)
+            {
+                const CachedFrameRecord &r = records()[i];
+                if (static_cast<uint64_t>(r.name_offset) + r.name_length > h.name_bytes)
+                    return false;
+            }
+            return true;
+        }
+
+        const char *data_ = nullptr;
+        const char *names_ = nullptr;
+        size_t size_ = 0;
+    };
+
+    // 原地重写缓存文件：先作废文件头，再写入数据，最后写入文件头
+    // 缓存文件只在首次创建时改变目录项，之后的重写不会改变目录mtime
+    inline bool WriteCache(int fd, const FrameCacheHeader &header,
+                           const std::vector<CachedFrameRecord> &records, const std::string &names)
+    {
+        FrameCacheHeader blank{};
+        size_t records_bytes = records.size() * sizeof(CachedFrameRecord);
+        off_t body = static_cast<off_t>(sizeof(FrameCacheHeader));
+        return ::pwrite(fd, &blank, sizeof(blank), 0) == static_cast<ssize_t>(sizeof(blank)) &&
+               ::ftruncate(fd, body + static_cast<off_t>(records_bytes + names.size())) == 0 &&
+               ::pwrite(fd, records.data(), records_bytes, body) == static_cast<ssize_t>(records_bytes) &&
+               ::pwrite(fd, names.data(), names.size(), body + static_cast<off_t>(records_bytes)) == static_cast<ssize_t>(names.size()) &&
+               ::pwrite(fd, &header, sizeof(header), 0) == static_cast<ssize_t>(sizeof(header));
+    }
+}
+
+// 载入目录的帧索引（已排序）：优先使用缓存，目录有变化时增量扫描并更新缓存
+inline bool LoadFrameIndex(const char *directory, std::string_view extension, FrameIndex &index,
+                           FrameCacheStats *stats = nullptr)
+{
+    using namespace index_cache_detail;
+
+    FrameCacheStats local_stats;
+    FrameCacheStats &st = stats ? *stats : local_stats;
+    st = FrameCacheStats();
+    index.Clear();
+
+#ifdef __linux__
+    int dirfd = ::open(directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+        return false;
+
+    // 缓存文件须在记录目录mtime之前存在，否则它的创建会使缓存立刻失效
+    int cache_fd = ::openat(dirfd, frame_cache_path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+
+    struct stat dir_stat;
+    struct timespec now;
+    if (::fstat(dirfd, &dir_stat) != 0)
+    {
+        if (cache_fd >= 0)
+            ::close(cache_fd);
+        ::close(dirfd);
+        return false;
+    }
+    ::clock_gettime(CLOCK_REALTIME, &now);
+    int64_t dir_mtime = ToNanoseconds(dir_stat.st_mtim);
+
+    MappedCache cache(dirfd);
+    bool same_extension = cache.valid() &&
+                          std::string_view(cache.header().extension, cache.header().extension_length) == extension;
+
+    // 目录未变：直接从缓存重建索引
+    if (same_extension && !cache.header().racy &&
+        cache.header().dir_dev == static_cast<uint64_t>(dir_stat.st_dev) &&
+        cache.header().dir_ino == static_cast<uint64_t>(dir_stat.st_ino) &&
+        cache.header().dir_mtime_ns == dir_mtime)
+    {
+        const FrameCacheHeader &h = cache.header();
+        index.Reserve(h.count, h.name_bytes);
+        for (uint64_t i = 0; i < h.count; i++)
+            index.AddWithKey(cache.Name(cache.records()[i]), cache.records()[i].key);
+        index.SetOverflowCount(h.overflowed);
+        index.Sort();
+        st.cache_hit = true;
+        if (cache_fd >= 0)
+            ::close(cache_fd);
+        ::close(dirfd);
+        return true;
+    }
+
+    // 目录有变化：按文件名查找旧条目，inode一致则复用，否则stat
+    std::unordered_map<std::string_view, const CachedFrameRecord *> previous;
+    if (same_extension)
+    {
+        previous.reserve(cache.header().count);
+        for (uint64_t i = 0; i < cache.header().count; i++)
+            previous.emplace(cache.Name(cache.records()[i]), &cache.records()[i]);
+    }
+
+    std::vector<CachedFrameRecord> records;
+    if (same_extension)
+    {
+        records.reserve(cache.header().count);
+        index.Reserve(cache.header().count, cache.header().name_bytes);
+    }
+
+    bool ok = ScanDirectoryEntries(dirfd, extension, [&](int fd, std::string_view name, uint64_t ino)
+                                   {
+        CachedFrameRecord record{};
+        record.name_offset = static_cast<uint32_t>(index.NameBytes());
+        record.name_length = static_cast<uint32_t>(name.size());
+        if (!index.Add(name))
+            return;
+        record.key = index.Entries().back().key;
+        record.ino = ino;
+
+        auto it = previous.find(name);
+        if (it != previous.end() && it->second->ino == ino)
+        {
+            record.mtime_ns = it->second->mtime_ns;
+            record.size = it->second->size;
+            st.reused++;
+        }
+        else
+        {
+            struct stat file_stat;
+            if (::fstatat(fd, std::string(name).c_str(), &file_stat, 0) == 0)
+            {
+                record.mtime_ns = ToNanoseconds(file_stat.st_mtim);
+                record.size = static_cast<uint64_t>(file_stat.st_size);
+            }
+            st.stat_calls++;
+        }
+        records.push_back(record); });
+    index.Sort();
+
+    // 写回缓存（扩展名过长时不缓存）
+    if (ok && cache_fd >= 0 && extension.size() <= sizeof(FrameCacheHeader::extension))
+    {
+        FrameCacheHeader header{};
+        std::memcpy(header.magic, magic, sizeof(magic));
+        header.version = version;
+        header.dir_dev = static_cast<uint64_t>(dir_stat.st_dev);
+        header.dir_ino = static_cast<uint64_t>(dir_stat.st_ino);
+        header.dir_mtime_ns = dir_mtime;
+        header.count = records.size();
+        header.name_bytes = index.NameBytes();
+        header.overflowed = index.OverflowCount();
+        header.racy = (ToNanoseconds(now) - dir_mtime) < 1000000000LL ? 1 : 0;
+        header.extension_length = static_cast<uint32_t>(extension.size());
+        std::memcpy(header.extension, extension.data(), extension.size());
+        WriteCache(cache_fd, header, records, index.NameArena());
+    }
+
+    if (cache_fd >= 0)
+        ::close(cache_fd);
+    ::close(dirfd);
+    return ok;
+#else
+    bool ok = ScanFrameDirectory(directory, extension, index);
+    index.Sort();
+    return ok;
+#endif
+}
+
+#endif // GIFCMD_INDEX_CACHE_HPP
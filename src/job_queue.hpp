@@ -0,0 +1,122 @@
+#ifndef GIFCMD_JOB_QUEUE_HPP
+#define GIFCMD_JOB_QUEUE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include <unistd.h>
+
+// 按CPU核数和可用内存确定工作线程数：每个任务预留 per_job_bytes 内存
+inline size_t DefaultWorkerCount(uint64_t per_job_bytes)
+{
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    size_t workers = cores;
+#ifdef _SC_AVPHYS_PAGES
+    long pages = ::sysconf(_SC_AVPHYS_PAGES);
+    long page_size = ::sysconf(_SC_PAGESIZE);
+    if (pages > 0 && page_size > 0 && per_job_bytes > 0)
+    {
+        uint64_t available = static_cast<uint64_t>(pages) * static_cast<uint64_t>(page_size);
+        workers = std::min<size_t>(workers, static_cast<size_t>(available / per_job_bytes));
+    }
+#endif
+    return std::max<size_t>(1, workers);
+}
+
+// 同时运行 active_jobs 个任务时每个任务内部的线程数：各任务平分CPU核数，
+// 而不是每个任务都按全部核数开线程（多个任务并行时线程数约为核数的平方）
+// reserved 为任务另外占用的核数（如接收原始帧的ffmpeg进程）
+inline size_t ThreadsPerJob(size_t active_jobs, size_t reserved = 0)
+{
+    size_t cores = std::max(1u, std::thread::hardware_concurrency());
+    size_t share = cores / std::max<size_t>(1, active_jobs);
+    return share > reserved + 1 ? share - reserved : 1;
+}
+
+// 有界任务队列 + 固定数量的工作线程
+// 提交不阻塞（队列满时返回false），析构时丢弃未开始的任务并等待运行中的任务结束
+template <class Job>
+class JobQueue
+{
+public:
+    JobQueue(size_t capacity, size_t workers, std::function<void(Job &)> handler)
+        : capacity_(capacity), handler_(std::move(handler))
+    {
+        for (size_t i = 0; i < workers; i++)
+            threads_.emplace_back([this]
+                                  { Run(); });
+    }
+
+    ~JobQueue()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            closed_ = true;
+            pending_.clear();
+        }
+        available_.notify_all();
+        for (auto &thread : threads_)
+            thread.join();
+    }
+
+    JobQueue(const JobQueue &) = delete;
+    JobQueue &operator=(const JobQueue &) = delete;
+
+    bool TrySubmit(Job job)
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            if (closed_ || pending_.size() >= capacity_)
+                return false;
+            pending_.push_back(std::move(job));
+        }
+        available_.notify_one();
+        return true;
+    }
+
+    size_t Pending() const
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        return pending_.size();
+    }
+    size_t Active() const { return active_.load(std::memory_order_relaxed); }
+    size_t workers() const { return threads_.size(); }
+
+private:
+    void Run()
+    {
+        for (;;)
+        {
+            Job job;
+            {
+                std::unique_lock<std::mutex> lock(mutex_);
+                available_.wait(lock, [this]
+                                { return closed_ || !pending_.empty(); });
+                if (closed_)
+                    return;
+                job = std::move(pending_.front());
+                pending_.pop_front();
+                active_++;
+            }
+            handler_(job);
+            active_--;
+        }
+    }
+
+    size_t capacity_;
+    std::function<void(Job &)> handler_;
+    mutable std::mutex mutex_;
+    std::condition_variable available_;
+    std::deque<Job> pending_;
+    bool closed_ = false;
+    std::atomic<size_t> active_{0};
+    std::vector<std::thread> threads_;
+};
+
+#endif // GIFCMD_JOB_QUEUE_HPP
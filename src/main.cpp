@@ -1,13 +1,36 @@
+#include <cerrno>
+#include <csignal>
 #include <cstdlib>
+#include <cstring>
 #include <string>
 #include <vector>
 #include <thread>
 #include <atomic>
-#include <regex>
 #include <filesystem>
 #include <chrono>
 #include <fstream>
+#include <iostream>
+#include <map>
+#include <mutex>
+#include <set>
+#include "ffmpeg_process.hpp"
+#include "frame_dedup.hpp"
+#include "frame_index.hpp"
+#include "frame_watcher.hpp"
+#include "gif_optimize.hpp"
+#include "gif_stitch.hpp"
+#include "index_cache.hpp"
+#include "job_queue.hpp"
+#include "native_encoder.hpp"
+#include "palette_cache.hpp"
+#include "progress_gauge.hpp"
+#include "redraw_scheduler.hpp"
+#include "rename_journal.hpp"
+#include "run_state.hpp"
+#include "settings_model.hpp"
+#include "stage_pipeline.hpp"
 #include <ftxui/screen/screen.hpp>
+#include <ftxui/screen/terminal.hpp>
 #include <ftxui/dom/elements.hpp>
 #include <ftxui/component/component.hpp>
 #include <ftxui/component/screen_interactive.hpp>
@@ -15,365 +38,1151 @@
 using namespace ftxui;
 namespace fs = std::filesystem;
 
+// 界面上的一行任务：任务本身、最近收到的状态和它的进度条组件
+struct JobRow
+{
+    std::shared_ptr<EncodeJob> job;
+    RunState state;
+    Component gauge;
+};
+
 // 全局变量存储用户输入参数
-std::string output_path = "output.gif";
-std::string framerate = "10";
-std::string width = "320";
-std::string quality = "";            // 质量参数（默认留空）
-std::string loop_count = "0";        // 循环次数（0=无限）
-std::string extension = "jpg";       // 文件后缀名
-std::string command_display;         // 实时显示生成的命令
-std::string error_message;           // 错误提示信息
-std::string result_message;          // 运行结果信息
-std::atomic<float> progress{0};      // 进度条值（0.0 - 1.0）
-std::atomic<bool> is_running{false}; // 是否正在运行
-
-const std::string log_file_path = "ffmpeg.log"; // 日志文件路径
-std::map<std::string, std::string> fileMap;     // 存储文件名和数字部分的映射
-
-bool isValidNumber(const std::string &s, int &value);
-std::string extractNumberFromFilename(const std::string &filename);
-void RenameFiles();
-void GenerateCommand();
-void ExecuteCommand();
+SettingsModel settingsModel;         // 输入框绑定的设置模型（仅界面线程访问）
+std::string batch_directories;       // 批量任务目录（以;分隔）
+std::string error_message;           // 提交任务时的错误提示信息
+std::string result_message;          // 最近一次结束的任务结果
+bool result_succeeded = false;
+std::string scan_message;            // 扫描警告信息（重复帧号等）
 
-// ---------------------------------------------------
-// 检查字符串是否为有效整数
-bool isValidNumber(const std::string &s, int &value)
+const std::string log_file_path = "ffmpeg.log";        // 日志文件路径（位于任务目录中）
+const size_t max_job_rows = 8;                         // 界面最多显示的任务行数
+const size_t palette_sample_frames = 500;              // 分段模式生成全局调色板时最多抽样的帧数
+FrameIndex frameIndex;                                 // 当前目录的帧索引（界面显示用）
+std::unique_ptr<FrameWatcher> frameWatcher;            // 目录监视线程（实时帧统计）
+Receiver<FrameStats> frameStatsReceiver = MakeReceiver<FrameStats>();
+RedrawScheduler redrawScheduler;                       // 合并工作线程的刷新请求
+FrameStats liveFrameStats;                             // 最近一次收到的帧统计
+bool hasLiveFrameStats = false;
+Receiver<RunState> runStateReceiver = MakeReceiver<RunState>();
+Sender<RunState> runStateSender = runStateReceiver->MakeSender(); // 所有工作线程共用
+std::unique_ptr<JobQueue<std::shared_ptr<EncodeJob>>> jobQueue;   // 批量编码任务队列
+std::map<int, JobRow> jobRows;                         // 任务编号 -> 界面行
+std::set<std::string> activeDirectories;               // 已提交但未结束的任务目录
+int nextJobId = 1;
+
+// 一个任务运行期间的上下文：状态副本、日志文件，以及保护两者的互斥锁
+// 分段编码时多个读取线程同时更新状态，单进程阶段同样加锁以保持一致
+// 发布状态后请求界面刷新（由调度器合并）
+struct JobContext : RunStatePublisher
 {
-    try
+    explicit JobContext(EncodeJob &encode_job)
+        : RunStatePublisher(encode_job.id, runStateSender, []
+                            { redrawScheduler.Notify(); }),
+          job(encode_job)
     {
-        value = std::stoi(s);
-        return true;
     }
-    catch (...)
+
+    // 写入日志文件并捕获错误信息
+    void OnStderrLine(std::string_view line)
     {
-        return false;
+        std::lock_guard<std::mutex> lock(mutex);
+        log_file << line << '\n';
+        if (line.find("Error") != std::string_view::npos || line.find("failed") != std::string_view::npos)
+        {
+            state.result_message.append(line.data(), line.size());
+            state.result_message += '\n';
+            Publish();
+        }
     }
-}
 
-// 从文件名中提取数字部分
-std::string extractNumberFromFilename(const std::string &filename)
+    EncodeJob &job;
+    std::ofstream log_file;
+};
+
+std::string ScanFrames(const std::string &directory, const std::string &extension, FrameIndex &index);
+std::string RenameFiles(const std::string &directory, const EncodeSettings &settings, const FrameIndex &index,
+                        std::vector<RenameJournalEntry> &journal, bool watched);
+std::string WriteConcatList(const std::string &directory, const EncodeSettings &settings, const FrameIndex &index,
+                            const std::vector<uint32_t> &lengths);
+std::string WriteFrameList(const std::string &directory, const std::vector<std::string_view> &names, double duration,
+                           const std::string &list_name, const uint32_t *lengths = nullptr);
+std::string RestoreOriginalFilenames(const std::string &directory, std::vector<RenameJournalEntry> &journal, bool watched);
+std::string RecoverFromJournal(const std::string &directory, bool watched);
+int RunFFmpeg(JobContext &ctx, const std::vector<std::string> &args, size_t total_frames,
+              const std::function<void(int)> &stdin_writer = nullptr);
+std::string PreparePalette(JobContext &ctx, const std::vector<std::string_view> &names, size_t stride, uint64_t key,
+                           std::string &palette);
+std::string DeduplicateFrames(JobContext &ctx, FrameIndex &index, std::vector<uint32_t> &lengths);
+std::string EncodeSegments(JobContext &ctx, const std::vector<std::string_view> &names,
+                           const std::vector<uint32_t> &lengths, const std::string &palette);
+std::string EncodeNative(JobContext &ctx, const FrameIndex &index, const std::vector<uint32_t> &lengths);
+std::string EncodePiped(JobContext &ctx, const FrameIndex &index, const std::string &palette);
+void RunEncodeJob(EncodeJob &job);
+
+// ---------------------------------------------------
+// 扫描目录并按数字部分排序帧文件，返回警告信息
+std::string ScanFrames(const std::string &directory, const std::string &extension, FrameIndex &index)
 {
-    std::string number;
-    bool foundDigit = false;
+    std::string warnings;
 
-    // 从文件名末尾开始遍历
-    for (auto it = filename.rbegin(); it != filename.rend(); ++it)
+    // 载入已排序的帧索引（目录未变时直接使用缓存）
+    if (!LoadFrameIndex(directory.c_str(), extension, index))
     {
-        if (std::isdigit(*it))
-        {
-            foundDigit = true;
-            number.push_back(*it);
-        }
-        else if (foundDigit)
-        {
-            // 遇到第一个非数字字符时停止
-            break;
-        }
+        warnings = "警告：读取目录失败，帧列表可能不完整";
     }
 
-    // 反转数字部分以恢复原始顺序
-    std::reverse(number.begin(), number.end());
-    return number;
+    // 报告重复或超出范围的帧号（不会丢弃任何帧）
+    if (index.DuplicateCount() > 0)
+    {
+        if (!warnings.empty())
+            warnings += "\n";
+        warnings += "警告：" + std::to_string(index.DuplicateCount()) + " 个文件的帧号与其他文件重复，已按文件名排序";
+    }
+    if (index.OverflowCount() > 0)
+    {
+        if (!warnings.empty())
+            warnings += "\n";
+        warnings += "警告：" + std::to_string(index.OverflowCount()) + " 个文件的帧号超出范围，已忽略";
+    }
+    return warnings;
 }
 
-// 重命名文件函数
-void RenameFiles()
+// 重命名文件函数，返回错误信息（成功时为空）
+std::string RenameFiles(const std::string &directory, const EncodeSettings &settings, const FrameIndex &index,
+                        std::vector<RenameJournalEntry> &journal, bool watched)
 {
-    fileMap.clear(); // 清空 fileMap，避免重复填充
+    journal.clear();
+
+    int dirfd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+    {
+        return "错误：无法打开目录 " + directory;
+    }
 
     // 打开日志文件
-    std::ofstream log_file("rename_log.txt");
+    std::ofstream log_file(fs::path(directory) / "rename_log.txt");
     if (!log_file.is_open())
     {
-        error_message = "错误：无法创建日志文件";
-        return;
+        ::close(dirfd);
+        return "错误：无法创建日志文件";
     }
 
-    // 遍历目录中的文件
-    for (const auto &entry : fs::directory_iterator("."))
+    // 重命名期间暂停目录监视，恢复文件名后重新扫描
+    if (watched && frameWatcher)
     {
-        if (entry.is_regular_file() && entry.path().extension() == "." + extension)
-        {
-            std::string filename = entry.path().filename().string();
-            std::string number = extractNumberFromFilename(filename);
+        frameWatcher->Pause();
+    }
 
-            if (!number.empty())
-            {
-                fileMap[number] = filename;                                          // 确保映射关系正确
-                log_file << "Mapped: " << number << " -> " << filename << std::endl; // 输出到日志
-            }
-        }
+    // 先生成全部重命名条目
+    journal.reserve(index.size());
+    for (size_t i = 0; i < index.size(); i++)
+    {
+        log_file << "Mapped: " << index.Key(i) << " -> " << index.Name(i) << '\n'; // 输出到日志
+
+        std::ostringstream newFilenameStream;
+        newFilenameStream << "image_" << std::setw(3) << std::setfill('0') << (i + 1) << "." << settings.extension;
+        journal.push_back({newFilenameStream.str(), std::string(index.Name(i))});
     }
 
-    // 按照数字部分排序
-    std::vector<std::pair<std::string, std::string>> sortedFiles(fileMap.begin(), fileMap.end());
-    std::sort(sortedFiles.begin(), sortedFiles.end(), [](const auto &a, const auto &b)
-              { return std::stoi(a.first) < std::stoi(b.first); });
+    // 帧号整体增大（如从 image_000 开始）时倒序执行，避免目标被下一帧占用；
+    // 按执行顺序在重命名开始前将日志落盘，崩溃后可据此回滚
+    std::string error;
+    if (!OrderRenameJournal(journal))
+    {
+        error = "错误：重命名的目标互相占用，无法安全重命名";
+        journal.clear();
+    }
+    else if (!WriteRenameJournal(dirfd, journal))
+    {
+        error = "错误：无法写入重命名日志";
+        journal.clear();
+    }
 
-    // 重命名文件
-    int counter = 1;
-    for (const auto &[number, filename] : sortedFiles)
+    // 重命名文件：目标名已被其他文件占用时不覆盖，中途失败则倒序回滚已完成的重命名
+    size_t renamed = ApplyRenameJournal(dirfd, journal);
+    const int rename_errno = errno; // 之后写日志可能改变 errno
+    for (size_t i = 0; i < renamed; i++)
     {
-        std::ostringstream newFilenameStream;
-        newFilenameStream << "image_" << std::setw(3) << std::setfill('0') << counter << "." << extension;
-        std::string newFilename = newFilenameStream.str();
+        log_file << "Renamed: " << journal[i].original_name << " -> " << journal[i].temp_name << '\n'; // 输出到日志
+    }
+    if (renamed < journal.size())
+    {
+        const RenameJournalEntry &entry = journal[renamed];
+        log_file << "Error: Failed to rename: " << entry.original_name << " -> " << entry.temp_name << ": "
+                 << std::strerror(rename_errno) << '\n';
+        if (rename_errno == EEXIST)
+            error = "错误：重命名的目标 " + entry.temp_name + " 已被其他文件占用（" + entry.original_name + "），已回滚";
+        else
+            error = "错误：重命名失败：" + entry.original_name;
+        ReplayRenameJournal(dirfd, journal);
+        RemoveRenameJournal(dirfd);
+        journal.clear();
+    }
 
-        fs::rename(filename, newFilename);
-        log_file << "Renamed: " << filename << " -> " << newFilename << std::endl; // 输出到日志
-        counter++;
+    if (!error.empty() && watched && frameWatcher)
+    {
+        frameWatcher->Resume();
     }
 
+    ::close(dirfd);
     log_file.close(); // 关闭日志文件
+    return error;
 }
 
-// 生成FFmpeg命令的函数
-void GenerateCommand()
+// 写出concat分离器列表，按顺序引用原始文件，无需重命名；返回错误信息
+// lengths 不为空时为去重后每帧代表的原始帧数
+std::string WriteConcatList(const std::string &directory, const EncodeSettings &settings, const FrameIndex &index,
+                            const std::vector<uint32_t> &lengths)
 {
-    // 清空错误信息
-    error_message.clear();
-
-    // 检查参数有效性
-    std::vector<std::string> errors;
-    int tmp;
-
-    // 帧率检查
-    if (!isValidNumber(framerate, tmp) || tmp <= 0)
+    std::vector<std::string_view> names;
+    names.reserve(index.size());
+    for (size_t i = 0; i < index.size(); i++)
     {
-        errors.push_back("帧率必须为正整数");
+        names.push_back(index.Name(i));
     }
 
-    // 宽度检查
-    if (!isValidNumber(width, tmp) || tmp <= 0)
+    // 每帧持续时间由帧率决定（合并了重复帧的按原始帧数延长）
+    return WriteFrameList(directory, names, 1.0 / settings.framerate, concat_list_path,
+                          lengths.empty() ? nullptr : lengths.data());
+}
+
+// 按给定顺序写出concat列表（每帧持续 duration 秒，lengths 不为空时第i帧持续 duration * lengths[i] 秒）
+// 返回错误信息
+std::string WriteFrameList(const std::string &directory, const std::vector<std::string_view> &names, double duration,
+                           const std::string &list_name, const uint32_t *lengths)
+{
+    std::ofstream list_file(fs::path(directory) / list_name);
+    if (!list_file.is_open())
     {
-        errors.push_back("宽度必须为正整数");
+        return "错误：无法创建concat列表文件";
     }
 
-    // 质量检查（可选参数）
-    if (!quality.empty())
+    list_file << "ffconcat version 1.0\n";
+    for (size_t i = 0; i < names.size(); i++)
     {
-        int q;
-        if (!isValidNumber(quality, q) || q < 1 || q > 31)
+        std::string_view filename = names[i];
+        // 单引号需转义为 '\''
+        std::string escaped;
+        for (char c : filename)
         {
-            errors.push_back("质量参数应为1-31（值越小质量越高）");
+            if (c == '\'')
+                escaped += "'\\''";
+            else
+                escaped.push_back(c);
         }
+        list_file << "file '" << escaped << "'\n";
+        list_file << "duration " << (lengths ? duration * lengths[i] : duration) << "\n";
     }
 
-    // 循环次数检查
-    if (!isValidNumber(loop_count, tmp) || tmp < 0)
+    // 磁盘已满等写入错误可能到 close() 刷新缓冲区时才出现
+    if (!list_file)
+    {
+        return "错误：无法写入concat列表文件";
+    }
+    list_file.close();
+    if (!list_file)
     {
-        errors.push_back("循环次数必须为非负整数（0=无限循环）");
+        return "错误：无法写入concat列表文件";
     }
+    return "";
+}
 
-    // 合并错误信息
-    if (!errors.empty())
+// 恢复原始文件名：按重命名日志倒序线性回放，返回错误信息（成功时为空）
+// 在工作线程中调用，不修改界面状态
+std::string RestoreOriginalFilenames(const std::string &directory, std::vector<RenameJournalEntry> &journal, bool watched)
+{
+    int dirfd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
     {
-        error_message = "错误：";
-        for (const auto &err : errors)
+        return "错误：无法打开目录 " + directory + "，文件名未恢复";
+    }
+
+    std::vector<std::string> failed;
+    size_t restored = ReplayRenameJournal(dirfd, journal, &failed);
+
+    // 打开日志文件
+    std::ofstream log_file(fs::path(directory) / "restore_log.txt");
+    if (log_file.is_open())
+    {
+        log_file << "Restored: " << restored << " / " << journal.size() << '\n';
+        for (const auto &line : failed)
         {
-            error_message += "\n  • " + err;
+            log_file << "Error: Failed to restore: " << line << '\n';
         }
+        log_file.close(); // 关闭日志文件
     }
 
-    // 生成命令（如果无错误）
-    command_display.clear();
-    if (error_message.empty())
+    // 全部恢复后才删除日志，否则保留以便下次启动重试
+    if (failed.empty())
     {
-        command_display = "ffmpeg -hide_banner -loglevel info -framerate " + framerate +
-                          " -i image_%03d." + extension +
-                          " -vf \"scale=" + width + ":-1\"";
+        RemoveRenameJournal(dirfd);
+    }
+    journal.clear();
+    ::close(dirfd);
+
+    if (watched && frameWatcher)
+    {
+        frameWatcher->Resume();
+    }
+
+    if (!failed.empty())
+    {
+        return "错误：" + std::to_string(failed.size()) + " 个文件名未能恢复，详见restore_log.txt";
+    }
+    return "";
+}
+
+// 检测目录中残留的重命名日志并自动回滚，返回提示信息（无残留时为空）
+std::string RecoverFromJournal(const std::string &directory, bool watched)
+{
+    int dirfd = ::open(directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+        return "";
+
+    if (!HasRenameJournal(dirfd))
+    {
+        ::close(dirfd);
+        return "";
+    }
+
+    std::vector<RenameJournalEntry> journal;
+    if (!ReadRenameJournal(dirfd, journal))
+    {
+        ::close(dirfd);
+        return "错误：发现损坏的重命名日志 " + (fs::path(directory) / rename_journal_path).string() + "，请手动检查";
+    }
+    ::close(dirfd);
+
+    size_t total = journal.size();
+    std::string restore_error = RestoreOriginalFilenames(directory, journal, watched);
+    if (!restore_error.empty())
+        return restore_error;
+    return "已从上次中断的运行中恢复文件名（共 " + std::to_string(total) + " 个，详见restore_log.txt）";
+}
+
+// 在任务目录中运行一个ffmpeg进程：已处理帧数按 total_frames 换算为进度
+// stdin_writer 不为空时由它向ffmpeg的stdin写入数据
+// 返回进程退出码；无法启动时返回-1
+int RunFFmpeg(JobContext &ctx, const std::vector<std::string> &args, size_t total_frames,
+              const std::function<void(int)> &stdin_writer)
+{
+    // 解析 -progress 输出的键值流：只发布原始进度，不在读取线程中等待
+    ProgressParser parser([&](const FFmpegProgress &sample)
+                          {
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        float target_progress = total_frames > 0 ? static_cast<float>(sample.frame) / total_frames : 0.0f;
+        ctx.job.progress = std::min(target_progress, 1.0f);
+        ctx.state.last_sample = sample;
+        ctx.Publish(); });
 
-        // 添加质量参数
-        if (!quality.empty())
+    // stdout为进度流，stderr为日志
+    return RunProcess(
+        args,
+        [&](const char *data, size_t size)
+        { parser.Feed(data, size); },
+        [&](std::string_view line)
+        { ctx.OnStderrLine(line); },
+        ctx.job.directory, stdin_writer);
+}
+
+// 第一遍：由 names 中每隔 stride 帧取一帧生成调色板，结果放入调色板缓存
+// 缓存中已有同一键的调色板时跳过；成功时 palette 为调色板路径（相对任务目录），返回错误信息
+std::string PreparePalette(JobContext &ctx, const std::vector<std::string_view> &names, size_t stride, uint64_t key,
+                           std::string &palette)
+{
+    const EncodeSettings &settings = *ctx.job.settings;
+    int dirfd = ::open(ctx.job.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+    {
+        return "错误：无法打开目录 " + ctx.job.directory;
+    }
+    if (UseCachedPalette(dirfd, key))
+    {
+        ::close(dirfd);
+        palette = PaletteCachePath(key);
+        ctx.state.palette_cached = true;
+        return "";
+    }
+    if (!EnsurePaletteCacheDirectory(dirfd))
+    {
+        ::close(dirfd);
+        return "错误：无法创建调色板缓存目录";
+    }
+
+    std::vector<std::string_view> samples;
+    for (size_t i = 0; i < names.size(); i += stride)
+    {
+        samples.push_back(names[i]);
+    }
+    std::string error = WriteFrameList(ctx.job.directory, samples, 1.0 / settings.framerate, palette_list_path);
+    if (error.empty())
+    {
+        int exit_code = RunFFmpeg(ctx, PaletteCommandArgs(settings, PaletteTempPath(key)), samples.size());
+        if (exit_code < 0)
+        {
+            error = "错误：无法启动ffmpeg进程";
+        }
+        else if (exit_code != 0)
         {
-            command_display += " -q:v " + quality;
+            error = "错误：生成调色板失败（ffmpeg退出码 " + std::to_string(exit_code) + "）";
         }
+        else if (!CommitCachedPalette(dirfd, key))
+        {
+            error = "错误：无法写入调色板缓存";
+        }
+    }
+    if (!error.empty())
+    {
+        ::unlinkat(dirfd, PaletteTempPath(key).c_str(), 0);
+    }
+    ::unlinkat(dirfd, palette_list_path, 0);
+    ::close(dirfd);
 
-        // 添加循环参数
-        command_display += " -loop " + loop_count + " -y " + output_path; // 添加 -y 参数
+    if (error.empty())
+    {
+        palette = PaletteCachePath(key);
     }
+    return error;
 }
 
-// 执行命令并捕获进度
-// 恢复原始文件名
-void RestoreOriginalFilenames()
+// 去除连续的重复帧：index 只保留每段重复帧的第一帧，lengths 输出每个保留帧代表的原始帧数（没有重复时为空）
+// 有重复帧且使用ffmpeg编码时，改用带时长的concat列表输入（重命名后的序列和原始帧管道都只能按固定帧率）
+// 返回错误信息（成功时为空）
+std::string DeduplicateFrames(JobContext &ctx, FrameIndex &index, std::vector<uint32_t> &lengths)
 {
-    // 打开日志文件
-    std::ofstream log_file("restore_log.txt");
-    if (!log_file.is_open())
+    const EncodeSettings &settings = *ctx.job.settings;
+    int dirfd = ::open(ctx.job.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
     {
-        error_message = "错误：无法创建日志文件";
-        return;
+        return "错误：无法打开目录 " + ctx.job.directory;
     }
 
-    // 遍历从 1 到 fileMap.size() 的序号
-    for (int i = 1; i <= fileMap.size(); i++)
+    std::vector<std::string> names;
+    names.reserve(index.size());
+    for (size_t i = 0; i < index.size(); i++)
     {
-        // 构造临时文件名
-        std::ostringstream newFilenameStream;
-        newFilenameStream << "image_" << std::setw(3) << std::setfill('0') << i << "." << extension;
-        std::string newFilename = newFilenameStream.str();
+        names.emplace_back(index.Name(i));
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        ctx.state.deduplicating = true;
+        ctx.Publish();
+    }
+    std::vector<size_t> keep;
+    size_t workers = ThreadsPerJob(jobQueue->Active());
+    std::string error = FindDuplicateFrames(
+        dirfd, names, CanDecodeNatively(settings.extension), settings.dedup_threshold, workers, keep, lengths,
+        [&](size_t done, size_t total)
+        {
+            std::lock_guard<std::mutex> lock(ctx.mutex);
+            ctx.state.last_sample.frame = static_cast<int64_t>(done);
+            ctx.job.progress = static_cast<float>(done) / total;
+            ctx.Publish();
+        });
+    ::close(dirfd);
 
-        // 检查源文件是否存在
-        if (!fs::exists(newFilename))
+    std::lock_guard<std::mutex> lock(ctx.mutex);
+    ctx.state.deduplicating = false;
+    ctx.state.last_sample = FFmpegProgress();
+    ctx.job.progress = 0;
+    if (!error.empty())
+    {
+        lengths.clear();
+        ctx.Publish();
+        return "错误：" + error;
+    }
+    ctx.state.dropped_frames = index.size() - keep.size();
+    if (ctx.state.dropped_frames == 0)
+    {
+        lengths.clear();
+    }
+    else
+    {
+        index.Retain(keep);
+        if (!(settings.native_encoder && CanDecodeNatively(settings.extension)))
         {
-            log_file << "Error: Source file not found: " << newFilename << std::endl;
-            continue;
+            auto adjusted = std::make_shared<EncodeSettings>(settings);
+            adjusted->rename_free = true;
+            adjusted->decode_pipe = false;
+            adjusted->command_args = EncodeCommandArgs(*adjusted, "");
+            ctx.job.settings = std::move(adjusted);
         }
+    }
+    ctx.state.total_frames = index.size();
+    ctx.Publish();
+    return "";
+}
 
-        // 找到对应的原始文件名
-        auto it = std::next(fileMap.begin(), i - 1); // 获取第 i 个键值对
-        std::string originalFilename = it->second;
+// 分段并行编码：将帧序列均分为若干段，每段由一个ffmpeg进程用同一全局调色板编码（paletteuse），
+// 最后按字节拼接为一个GIF；names 为各帧当前的文件名，lengths 不为空时为去重后每帧代表的原始帧数
+// 返回错误信息（成功时为空）
+std::string EncodeSegments(JobContext &ctx, const std::vector<std::string_view> &names,
+                           const std::vector<uint32_t> &lengths, const std::string &palette)
+{
+    const EncodeSettings &settings = *ctx.job.settings;
+    const std::string &directory = ctx.job.directory;
+    const size_t total = names.size();
+    const size_t segments = std::min<size_t>(settings.segments, total);
 
-        log_file << "Processing: " << newFilename << " -> " << originalFilename << std::endl;
+    // 结束时删除分段列表和分段GIF
+    std::vector<std::string> temp_files;
+    auto cleanup = [&]
+    {
+        std::error_code ec;
+        for (const auto &file : temp_files)
+            fs::remove(fs::path(directory) / file, ec);
+    };
 
-        // 检查目标文件是否存在
-        if (fs::exists(originalFilename))
+    std::vector<size_t> starts(segments + 1);
+    for (size_t k = 0; k <= segments; k++)
+    {
+        starts[k] = total * k / segments;
+    }
+    for (size_t k = 0; k < segments; k++)
+    {
+        temp_files.push_back(SegmentOutputPath(k));
+        if (settings.rename_free)
         {
-            log_file << "Warning: Target file already exists: " << originalFilename << std::endl;
-
-            // 如果目标文件已存在，先删除它
-            if (fs::remove(originalFilename))
+            temp_files.push_back(SegmentListPath(k));
+            std::vector<std::string_view> segment_names(names.begin() + starts[k], names.begin() + starts[k + 1]);
+            std::string error = WriteFrameList(directory, segment_names, 1.0 / settings.framerate, SegmentListPath(k),
+                                               lengths.empty() ? nullptr : lengths.data() + starts[k]);
+            if (!error.empty())
             {
-                log_file << "Deleted existing target file: " << originalFilename << std::endl;
+                cleanup();
+                return error;
             }
-            else
+        }
+    }
+
+    // 各段并行编码，进度为各段已完成帧数之和
+    std::vector<int64_t> segment_frames(segments, 0);
+    std::vector<double> segment_fps(segments, 0);
+    std::vector<int> exit_codes(segments, 0);
+    std::vector<std::thread> threads;
+    for (size_t k = 0; k < segments; k++)
+    {
+        threads.emplace_back([&, k]
+                             {
+            ProgressParser parser([&](const FFmpegProgress &sample)
+                                  {
+                std::lock_guard<std::mutex> lock(ctx.mutex);
+                segment_frames[k] = sample.frame;
+                segment_fps[k] = sample.finished ? 0 : sample.fps;
+                ctx.state.last_sample = sample;
+                ctx.state.last_sample.frame = 0;
+                ctx.state.last_sample.fps = 0;
+                for (size_t i = 0; i < segments; i++) {
+                    ctx.state.last_sample.frame += segment_frames[i];
+                    ctx.state.last_sample.fps += segment_fps[i];
+                }
+                ctx.job.progress = std::min(static_cast<float>(ctx.state.last_sample.frame) / total, 1.0f);
+                ctx.Publish(); });
+            exit_codes[k] = RunProcess(
+                EncodeCommandArgs(settings, palette, k, starts[k], starts[k + 1] - starts[k]),
+                [&](const char *data, size_t size)
+                { parser.Feed(data, size); },
+                [&](std::string_view line)
+                { ctx.OnStderrLine(line); },
+                directory); });
+    }
+    for (auto &thread : threads)
+    {
+        thread.join();
+    }
+
+    for (size_t k = 0; k < segments; k++)
+    {
+        if (exit_codes[k] != 0)
+        {
+            cleanup();
+            if (exit_codes[k] < 0)
+                return "错误：无法启动ffmpeg进程";
+            return "错误：第 " + std::to_string(k + 1) + " 段编码失败（ffmpeg退出码 " + std::to_string(exit_codes[k]) + "）";
+        }
+    }
+
+    // 拼接各段（全局调色板相同，通常无需注入局部颜色表）
+    std::vector<std::string> segment_paths;
+    for (size_t k = 0; k < segments; k++)
+    {
+        segment_paths.push_back((fs::path(directory) / SegmentOutputPath(k)).string());
+    }
+    std::string error = StitchGifSegments(segment_paths, (fs::path(directory) / settings.output_path).string());
+    cleanup();
+    if (!error.empty())
+    {
+        return "错误：拼接GIF失败：" + error;
+    }
+    return "";
+}
+
+// 内置编码器：直接读取原始文件，不重命名也不启动ffmpeg；返回错误信息（成功时为空）
+std::string EncodeNative(JobContext &ctx, const FrameIndex &index, const std::vector<uint32_t> &lengths)
+{
+    const EncodeSettings &settings = *ctx.job.settings;
+    int dirfd = ::open(ctx.job.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+    {
+        return "错误：无法打开目录 " + ctx.job.directory;
+    }
+
+    std::vector<std::string> names;
+    names.reserve(index.size());
+    for (size_t i = 0; i < index.size(); i++)
+    {
+        names.emplace_back(index.Name(i));
+    }
+
+    // 进度：每个阶段单独计数，帧率按本阶段的平均速度计算
+    auto stage_start = std::chrono::steady_clock::now();
+    size_t workers = ThreadsPerJob(jobQueue->Active());
+    std::string error = EncodeGifNative(
+        dirfd, names, lengths, settings, (fs::path(ctx.job.directory) / settings.output_path).string(), workers,
+        [&](int stage, size_t done, size_t total)
+        {
+            std::lock_guard<std::mutex> lock(ctx.mutex);
+            auto now = std::chrono::steady_clock::now();
+            if (stage != ctx.state.stage)
             {
-                log_file << "Error: Failed to delete existing target file: " << originalFilename << std::endl;
-                continue;
+                ctx.state.stage = stage;
+                stage_start = now;
             }
-        }
+            double seconds = std::chrono::duration<double>(now - stage_start).count();
+            ctx.state.last_sample.frame = static_cast<int64_t>(done);
+            ctx.state.last_sample.fps = seconds > 0 ? done / seconds : 0;
+            ctx.job.progress = static_cast<float>(done) / total;
+            ctx.Publish();
+        },
+        [&](const std::vector<StageLoad> &loads)
+        {
+            std::lock_guard<std::mutex> lock(ctx.mutex);
+            ctx.state.stage_loads = loads; // 随下一次进度一起发布
+            ctx.UpdatePoolStats();
+        });
+    ::close(dirfd);
+    ctx.state.stage_loads.clear();
+
+    if (!error.empty())
+    {
+        return "错误：" + error;
+    }
+    return "";
+}
+
+// 并行解码：读取、解码、缩放各为流水线的一个阶段，写出线程按顺序把rgb24原始帧写入ffmpeg的stdin
+// 不重命名也不写concat列表；流水线中的帧数受 settings.memory_budget 限制。返回错误信息（成功时为空）
+std::string EncodePiped(JobContext &ctx, const FrameIndex &index, const std::string &palette)
+{
+    const EncodeSettings &settings = *ctx.job.settings;
+    int dirfd = ::open(ctx.job.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (dirfd < 0)
+    {
+        return "错误：无法打开目录 " + ctx.job.directory;
+    }
+
+    std::vector<std::string> names;
+    names.reserve(index.size());
+    for (size_t i = 0; i < index.size(); i++)
+    {
+        names.emplace_back(index.Name(i));
+    }
+
+    // 第一帧决定输出高度，之后的帧都缩放到同一尺寸；它的解码结果直接交给流水线，不再读取和解码第二次
+    std::vector<uint8_t> first_file;
+    RgbImage first;
+    if (!ReadImageFile(dirfd, names[0], first_file) || !DecodeImage(first_file, first))
+    {
+        ::close(dirfd);
+        return "错误：无法解码 " + names[0];
+    }
+    const int width = settings.width;
+    const int height = ScaledHeight(first.width, first.height, width);
+
+    // 留一个核心给ffmpeg；每帧持有文件、原始尺寸的解码结果和缩放结果
+    struct PipedFrame
+    {
+        std::vector<uint8_t> file;
+        RgbImage decoded;
+        RgbImage scaled;
+    };
+    size_t workers = ThreadsPerJob(jobQueue->Active(), 1);
+    size_t frame_bytes = first_file.size() + first.bytes() + FramePool::RowStride(width, PixelFormat::rgb24) * height;
+    size_t stage_threads = 0;
+    for (size_t k = 0; k < 3; k++)
+    {
+        stage_threads += settings.StageThreads(k, workers);
+    }
+    size_t in_flight = std::clamp<size_t>(settings.memory_budget / frame_bytes, 1, stage_threads * 2);
 
-        // 恢复原始文件名
-        try
+    std::atomic<size_t> failed_frame{names.size()};
+    std::atomic<bool> resize_failed{false};
+    StagePipeline<PipedFrame> pipeline;
+    pipeline.AddStage("读取", settings.StageThreads(0, workers), [&](size_t i, PipedFrame &frame)
+                      {
+        if (i == 0)
         {
-            fs::rename(newFilename, originalFilename);
-            log_file << "Restored: " << newFilename << " -> " << originalFilename << std::endl;
+            frame.file = std::move(first_file); // 缓冲区留给之后的帧复用
+            return true;
         }
-        catch (const std::exception &e)
+        if (ReadImageFile(dirfd, names[i], frame.file))
+            return true;
+        failed_frame = i;
+        return false; });
+    pipeline.AddStage("解码", settings.StageThreads(1, workers), [&](size_t i, PipedFrame &frame)
+                      {
+        if (i == 0)
         {
-            log_file << "Error: Failed to restore: " << newFilename << " -> " << originalFilename << std::endl;
+            frame.decoded = std::move(first);
+            return true;
         }
-    }
+        if (DecodeImage(frame.file, frame.decoded))
+            return true;
+        failed_frame = i;
+        return false; });
+    pipeline.AddStage("缩放", settings.StageThreads(2, workers), [&](size_t i, PipedFrame &frame)
+                      {
+        if (ResizeImage(frame.decoded, width, height, frame.scaled))
+            return true;
+        resize_failed = true;
+        failed_frame = i;
+        return false; });
 
-    log_file.close(); // 关闭日志文件
+    std::vector<StageLoad> loads;
+    std::vector<uint8_t> packed; // 行尾有填充时先拼成紧密排列的一帧再写入
+    int exit_code = RunFFmpeg(
+        ctx, RawVideoCommandArgs(settings, palette, height), index.size(),
+        [&](int fd)
+        {
+            pipeline.Run(names.size(), in_flight, "写入管道", [&](size_t, PipedFrame &frame)
+                         {
+                const RgbImage &image = frame.scaled;
+                const size_t row_bytes = static_cast<size_t>(image.width) * 3;
+                const uint8_t *data = image.Row(0);
+                if (image.stride() != row_bytes)
+                {
+                    packed.resize(row_bytes * image.height);
+                    for (int y = 0; y < image.height; y++)
+                        std::memcpy(packed.data() + y * row_bytes, image.Row(y), row_bytes);
+                    data = packed.data();
+                }
+                if (!WriteAll(fd, data, row_bytes * image.height))
+                    return false;
+                // 负载随ffmpeg的下一次进度一起发布
+                pipeline.Loads(loads);
+                std::lock_guard<std::mutex> lock(ctx.mutex);
+                ctx.state.stage_loads = loads;
+                ctx.UpdatePoolStats();
+                return true; });
+        });
+    ::close(dirfd);
+    ctx.state.stage_loads.clear();
+
+    // 解码失败时stdin提前关闭，ffmpeg仍会正常结束，须单独报告
+    if (failed_frame < names.size())
+    {
+        if (resize_failed)
+            return "错误：内存不足，无法缩放 " + names[failed_frame.load()];
+        return "错误：无法解码 " + names[failed_frame.load()];
+    }
+    if (exit_code < 0)
+    {
+        return "错误：无法启动ffmpeg进程";
+    }
+    if (exit_code != 0 && ctx.state.result_message.empty())
+    {
+        return "ffmpeg退出码 " + std::to_string(exit_code) + "，详见" + log_file_path;
+    }
+    return "";
 }
 
-// 执行命令并捕获进度
-void ExecuteCommand()
+// 执行一个编码任务：扫描、重命名或写concat列表、（生成调色板、）运行ffmpeg、恢复文件名
+// 在任务队列的工作线程中运行，状态只写入本任务的副本，变化时整体发送给界面
+void RunEncodeJob(EncodeJob &job)
 {
-    char buffer[64];
-    int last_frame = 0;                // 上一次的帧数
-    int current_frame = 0;             // 当前的帧数
-    int total_frames = fileMap.size(); // 总帧数
-    const float smooth_step = 0.01f;   // 每次增加的进度步长
-
-    if (!error_message.empty())
-        return;
+    auto start_time = std::chrono::steady_clock::now();
+    JobContext ctx(job);
+    RunState &state = ctx.state;
 
     // 重置进度和结果信息
-    progress = 0;
-    result_message.clear();
-    is_running = true;
+    job.progress = 0;
+    state.running = true;
+    ctx.Publish();
 
-    // 打开日志文件
-    std::ofstream log_file(log_file_path);
-    if (!log_file.is_open())
+    // 上次在该目录的运行若中途退出，先恢复原始文件名
+    std::string notes = RecoverFromJournal(job.directory, job.watched);
+
+    // 扫描帧文件：监视中的目录直接使用监视线程维护的帧列表
+    FrameIndex index;
+    if (!(job.watched && frameWatcher && frameWatcher->Snapshot(job.settings->extension, index)))
     {
-        result_message = "错误：无法创建日志文件";
-        is_running = false;
-        return;
+        std::string warnings = ScanFrames(job.directory, job.settings->extension, index);
+        if (!warnings.empty())
+            notes += (notes.empty() ? "" : "\n") + warnings;
     }
+    state.total_frames = index.size();
+    ctx.Publish();
 
-    // 启动ffmpeg进程
-    FILE *pipe = popen((command_display + " 2>&1").c_str(), "r"); // 捕获标准错误
-    if (!pipe)
+    // 进程内解码的帧缓冲取自进程共用的帧缓冲池：任务运行期间登记本任务的内存上限和大页设置，
+    // 池按所有运行中任务里最大的上限缓存空闲缓冲区，任务结束时撤销
+    FramePool::Requirement pool_requirement =
+        FramePool::Default().Require(job.settings->memory_budget, job.settings->huge_pages);
+
+    // 去除重复帧（可能改用concat列表输入，因此在确定编码方式之前）
+    std::string error;
+    std::vector<uint32_t> frame_lengths; // 去重后每帧代表的原始帧数（没有去掉帧时为空）
+    if (!index.empty() && job.settings->dedup)
     {
-        result_message = "错误：无法启动ffmpeg进程";
-        is_running = false;
-        return;
+        error = DeduplicateFrames(ctx, index, frame_lengths);
+        if (error.empty() && state.dropped_frames > 0)
+        {
+            notes += (notes.empty() ? "" : "\n") + std::string("去重：") + std::to_string(state.dropped_frames) +
+                     " 帧重复，已合并到前一帧的时长中";
+        }
     }
 
-    // 正则表达式解析 frame
-    std::regex frame_regex(R"(frame=\s*(\d+))");
-    std::smatch matches;
-    std::string line;
+    const EncodeSettings &settings = *job.settings;
+    // 内置编码器只处理可在进程内解码的格式，其余格式仍使用ffmpeg
+    bool native = settings.native_encoder && CanDecodeNatively(settings.extension);
+    bool piped = settings.UsesDecodePipe(); // 并行解码，原始帧经管道送入ffmpeg
+    // 内置编码器逐帧量化时没有生成调色板的阶段
+    bool per_frame_palette = native && settings.palette_mode == PaletteMode::per_frame;
+    state.stage_count = (native && !per_frame_palette) || settings.UsesPalette() ? 2 : 1;
+    state.stage = 1;
+    ctx.Publish();
 
-    // 读取ffmpeg输出
-    while (fgets(buffer, sizeof(buffer), pipe) != nullptr)
+    // 调色板缓存键：在重命名之前按原始文件名计算；分段模式只用抽样帧生成调色板
+    size_t palette_stride = 1;
+    uint64_t palette_key = 0;
+    if (error.empty() && index.empty())
     {
-        line = buffer;
-        log_file << line; // 将输出写入日志文件
+        error = "错误：目录中没有找到 ." + settings.extension + " 帧文件";
+    }
+    else if (error.empty() && !native && settings.UsesPalette())
+    {
+        if (settings.segments > 1)
+        {
+            palette_stride = (index.size() + palette_sample_frames - 1) / palette_sample_frames;
+        }
+        int dirfd = ::open(job.directory.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        if (dirfd < 0 || !PaletteCacheKey(dirfd, index, palette_stride, settings.width, settings.framerate, palette_key))
+        {
+            error = "错误：无法读取帧文件信息";
+        }
+        if (dirfd >= 0)
+        {
+            ::close(dirfd);
+        }
+    }
 
-        // 解析 frame
-        if (std::regex_search(line, matches, frame_regex))
+    // 准备输入：重命名文件或写出concat列表（进程内解码时直接读取原始文件）
+    std::vector<RenameJournalEntry> journal;
+    bool renamed = !settings.rename_free && !native && !piped;
+    bool concat_listed = settings.rename_free && !native && !piped;
+    if (error.empty() && renamed)
+    {
+        error = RenameFiles(job.directory, settings, index, journal, job.watched); // 先重命名文件
+    }
+    else if (error.empty() && concat_listed)
+    {
+        error = WriteConcatList(job.directory, settings, index, frame_lengths); // 按顺序写出concat列表，不改动源文件
+    }
+
+    // 打开日志文件
+    if (error.empty() && !native)
+    {
+        ctx.log_file.open(fs::path(job.directory) / log_file_path);
+        if (!ctx.log_file.is_open())
+            error = "错误：无法创建日志文件";
+    }
+
+    if (!error.empty())
+    {
+        state.result_message = error;
+    }
+    else if (native)
+    {
+        state.result_message = EncodeNative(ctx, index, frame_lengths);
+    }
+    else
+    {
+        // 各帧当前的文件名（重命名模式为重命名后的文件名）
+        std::vector<std::string_view> names;
+        names.reserve(index.size());
+        for (size_t i = 0; i < index.size(); i++)
         {
-            current_frame = std::stoi(matches[1]); // 更新当前帧数
+            names.push_back(renamed ? std::string_view(journal[i].temp_name) : index.Name(i));
         }
 
-        // 平滑插值更新进度
-        float target_progress = static_cast<float>(current_frame) / total_frames;
-        while (progress < target_progress)
+        // 第一遍：生成调色板（缓存命中时跳过）
+        std::string palette;
+        if (settings.UsesPalette())
         {
-            progress = progress + smooth_step; // 逐步增加进度
-            if (progress > target_progress)
+            error = PreparePalette(ctx, names, palette_stride, palette_key, palette);
+            if (error.empty())
             {
-                progress = target_progress;
+                state.stage = 2;
+                state.last_sample = FFmpegProgress();
+                job.progress = 0;
+                ctx.Publish();
             }
+        }
 
-            // 主动触发界面刷新
-            ScreenInteractive::Active()->PostEvent(Event::Custom);
-
-            // 稍微延迟一下，避免进度条更新过快
-            std::this_thread::sleep_for(std::chrono::milliseconds(10));
+        if (error.empty() && settings.segments > 1 && index.size() > 1)
+        {
+            error = EncodeSegments(ctx, names, frame_lengths, palette);
+        }
+        else if (error.empty() && piped)
+        {
+            error = EncodePiped(ctx, index, palette);
+        }
+        else if (error.empty())
+        {
+            // 启动ffmpeg进程（在任务目录中运行）
+            const auto &args = palette.empty() ? settings.command_args : EncodeCommandArgs(settings, palette);
+            int exit_code = RunFFmpeg(ctx, args, state.total_frames);
+            if (exit_code < 0)
+            {
+                error = "错误：无法启动ffmpeg进程";
+            }
+            else if (exit_code != 0 && state.result_message.empty())
+            {
+                error = "ffmpeg退出码 " + std::to_string(exit_code) + "，详见" + log_file_path;
+            }
         }
 
-        // 捕获错误信息
-        if (line.find("Error") != std::string::npos || line.find("failed") != std::string::npos)
+        // 帧间差分后处理（内置编码器在编码时已做差分）
+        if (error.empty() && state.result_message.empty() && settings.frame_delta)
         {
-            result_message += line;
+            size_t before = 0, after = 0;
+            error = OptimizeGifFile((fs::path(job.directory) / settings.output_path).string(), before, after);
+            if (error.empty() && after < before)
+            {
+                notes += (notes.empty() ? "" : "\n") + std::string("帧间差分：") + std::to_string(before / 1024) +
+                         " KB → " + std::to_string(after / 1024) + " KB";
+            }
         }
-    }
+        state.result_message += error;
 
-    // 关闭管道和日志文件
-    pclose(pipe);
-    log_file.close();
-    is_running = false;
+        // 关闭日志文件
+        ctx.log_file.close();
+    }
 
     // 更新结果信息
-    if (result_message.empty())
+    state.succeeded = state.result_message.empty();
+    if (state.succeeded)
     {
-        result_message = "成功：GIF已生成！";
+        state.result_message = "成功：GIF已生成！";
     }
     else
     {
-        result_message = "失败：\n" + result_message;
+        state.result_message = "失败：\n" + state.result_message;
     }
 
-    // 恢复原始文件名
-    RestoreOriginalFilenames();
+    // 恢复原始文件名（免重命名模式只需删除concat列表）
+    if (renamed && !journal.empty())
+    {
+        std::string restore_error = RestoreOriginalFilenames(job.directory, journal, job.watched);
+        if (!restore_error.empty())
+        {
+            state.succeeded = false;
+            state.result_message += "\n" + restore_error;
+        }
+    }
+    else if (concat_listed)
+    {
+        std::error_code ec;
+        fs::remove(fs::path(job.directory) / concat_list_path, ec);
+    }
+    ctx.UpdatePoolStats();
+    if (state.pool_stats.hits + state.pool_stats.misses > 0)
+    {
+        notes += (notes.empty() ? "" : "\n") + std::string("帧缓冲池：复用 ") + std::to_string(state.pool_stats.hits) +
+                 " 次，新分配 " + std::to_string(state.pool_stats.misses) + " 次，峰值 " +
+                 std::to_string(state.pool_stats.peak_bytes >> 20) + " MB";
+    }
+    if (!notes.empty())
+    {
+        state.result_message += "\n" + notes;
+    }
 
     // 最后一次刷新界面
-    ScreenInteractive::Active()->PostEvent(Event::Custom);
+    state.running = false;
+    state.finished = true;
+    state.elapsed_seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start_time).count();
+    ctx.Publish();
 }
+
+// 提交一个任务（界面线程调用）：同一目录同时只允许一个任务
+bool SubmitJob(const std::string &directory, Component &rows_container)
+{
+    auto settings = settingsModel.Snapshot();
+    if (!settings)
+    {
+        return false;
+    }
+
+    std::error_code ec;
+    if (!fs::is_directory(directory, ec))
+    {
+        error_message = "错误：目录不存在：" + directory;
+        return false;
+    }
+    std::string key = fs::weakly_canonical(directory, ec).string();
+    if (activeDirectories.count(key))
+    {
+        error_message = "错误：该目录已有任务在运行：" + directory;
+        return false;
+    }
+
+    auto job = std::make_shared<EncodeJob>();
+    job->id = nextJobId++;
+    job->directory = directory;
+    job->watched = fs::equivalent(directory, ".", ec);
+    job->settings = settings; // 工作线程持有提交时的设置快照，之后的输入修改不影响本任务
+    if (!jobQueue->TrySubmit(job))
+    {
+        error_message = "错误：任务队列已满";
+        return false;
+    }
+    activeDirectories.insert(key);
+
+    // 只保留最近的若干行，先移除已结束的旧任务
+    for (auto it = jobRows.begin(); jobRows.size() >= max_job_rows && it != jobRows.end();)
+    {
+        if (it->second.state.finished)
+        {
+            it->second.gauge->Detach();
+            it = jobRows.erase(it);
+        }
+        else
+        {
+            ++it;
+        }
+    }
+
+    JobRow row;
+    row.job = job;
+    row.state.job_id = job->id;
+    row.gauge = Make<ProgressGauge>(&job->progress);
+    rows_container->Add(row.gauge);
+    jobRows.emplace(job->id, std::move(row));
+    return true;
+}
+
 int main()
 {
-    // 定义输入组件
-    Component output_path_input = Input(&output_path, "输出路径");
-    Component framerate_input = Input(&framerate, "帧率（如10）");
-    Component width_input = Input(&width, "宽度（如320）");
-    Component quality_input = Input(&quality, "质量（1-31，可选）");
-    Component loop_input = Input(&loop_count, "循环次数（0=无限）");
-    Component extension_input = Input(&extension, "文件后缀名（如jpg）");
-
-    // 定义按钮组件
-    Component execute_button = Button("生成GIF", []
+    // 并行解码模式向ffmpeg的stdin写入；ffmpeg提前退出时写入返回错误而不是终止本进程
+    std::signal(SIGPIPE, SIG_IGN);
+
+    // 上次运行若中途退出，先恢复原始文件名
+    std::string recovered = RecoverFromJournal(".", false);
+    if (!recovered.empty())
+    {
+        result_message = recovered;
+        result_succeeded = recovered.find("错误") == std::string::npos;
+    }
+
+    // 预先载入帧索引，显示当前帧数
+    scan_message = ScanFrames(".", settingsModel.extension, frameIndex);
+
+    // 启动目录监视线程，帧统计通过Receiver传给界面
+    frameWatcher = std::make_unique<FrameWatcher>(".", settingsModel.extension, frameStatsReceiver->MakeSender(), []
+                                                  { redrawScheduler.Notify(); });
+
+    // 启动任务队列：工作线程数按CPU核数和可用内存确定（每个ffmpeg任务预留512MiB）
+    jobQueue = std::make_unique<JobQueue<std::shared_ptr<EncodeJob>>>(
+        1024, DefaultWorkerCount(512ull << 20), [](std::shared_ptr<EncodeJob> &job)
+        { RunEncodeJob(*job); });
+
+    // 定义输入组件：内容变化时标记设置已修改
+    auto input_option = []
+    {
+        InputOption option;
+        option.on_change = []
+        { settingsModel.MarkDirty(); };
+        return option;
+    };
+    Component output_path_input = Input(&settingsModel.output_path, "输出路径", input_option());
+    Component framerate_input = Input(&settingsModel.framerate, "帧率（如10）", input_option());
+    Component width_input = Input(&settingsModel.width, "宽度（如320）", input_option());
+    Component quality_input = Input(&settingsModel.quality, "质量（1-31，可选）", input_option());
+    Component loop_input = Input(&settingsModel.loop_count, "循环次数（0=无限）", input_option());
+    InputOption extension_option = input_option();
+    extension_option.on_change = []
+    {
+        settingsModel.MarkDirty();
+        if (frameWatcher)
+            frameWatcher->SetExtension(settingsModel.extension);
+    };
+    Component extension_input = Input(&settingsModel.extension, "文件后缀名（如jpg）", extension_option);
+    CheckboxOption rename_free_option = CheckboxOption::Simple();
+    rename_free_option.on_change = []
+    { settingsModel.MarkDirty(); };
+    Component rename_free_checkbox = Checkbox("免重命名（concat列表输入）", &settingsModel.rename_free, rename_free_option);
+    CheckboxOption two_pass_option = CheckboxOption::Simple();
+    two_pass_option.on_change = []
+    { settingsModel.MarkDirty(); };
+    Component two_pass_checkbox = Checkbox("两遍编码（生成调色板）", &settingsModel.two_pass, two_pass_option);
+    CheckboxOption native_option = CheckboxOption::Simple();
+    native_option.on_change = []
+    { settingsModel.MarkDirty(); };
+    Component native_checkbox = Checkbox("内置编码器（PPM/BMP，其余格式使用ffmpeg）", &settingsModel.native_encoder, native_option);
+    CheckboxOption decode_pipe_option = CheckboxOption::Simple();
+    decode_pipe_option.on_change = []
+    { settingsModel.MarkDirty(); };
+    Component decode_pipe_checkbox = Checkbox("并行解码（原始帧经管道送入ffmpeg）", &settingsModel.decode_pipe, decode_pipe_option);
+    CheckboxOption frame_delta_option = CheckboxOption::Simple();
+    frame_delta_option.on_change = []
+    { settingsModel.MarkDirty(); };
+    Component frame_delta_checkbox = Checkbox("帧间差分（只写变化区域，未变像素透明）", &settingsModel.frame_delta, frame_delta_option);
+    CheckboxOption dedup_option = CheckboxOption::Simple();
+    dedup_option.on_change = []
+    { settingsModel.MarkDirty(); };
+    Component dedup_checkbox = Checkbox("去除重复帧（合并时长）", &settingsModel.dedup, dedup_option);
+    Component dedup_threshold_input = Input(&settingsModel.dedup_threshold, "近似阈值（0-255，0=完全相同）", input_option());
+    Component memory_budget_input = Input(&settingsModel.memory_budget, "内存上限（MB，如256）", input_option());
+    Component stage_threads_input = Input(&settingsModel.stage_threads, "读取,解码,缩放,量化,压缩（如1,4,2,4,4，留空自动）", input_option());
+    CheckboxOption huge_pages_option = CheckboxOption::Simple();
+    huge_pages_option.on_change = []
+    { settingsModel.MarkDirty(); };
+    Component huge_pages_checkbox = Checkbox("帧缓冲使用大页（2MB以上的缓冲区，需内核开启透明大页）", &settingsModel.huge_pages, huge_pages_option);
+    Component segments_input = Input(&settingsModel.segments, "分段数（1=不分段）", input_option());
+    Component palette_colors_input = Input(&settingsModel.palette_colors, "颜色数（2-256，留空按质量）", input_option());
+    auto toggle_option = []
+    {
+        MenuOption option = MenuOption::Toggle();
+        option.on_change = []
+        { settingsModel.MarkDirty(); };
+        return option;
+    };
+    Component quantizer_toggle = Menu(&quantizer_names, &settingsModel.quantizer, toggle_option());
+    Component palette_mode_toggle = Menu(&palette_mode_names, &settingsModel.palette_mode, toggle_option());
+    Component dither_toggle = Menu(&dither_names, &settingsModel.dither, toggle_option());
+    Component batch_input = Input(&batch_directories, "批量目录（以;分隔）");
+    Component job_gauges = Container::Vertical({}); // 各任务的进度条组件
+
+    // 定义按钮组件：当前目录作为一个任务提交
+    Component execute_button = Button("生成GIF", [&]
                                       {
-        RenameFiles(); // 先重命名文件
-        GenerateCommand();
-        if (error_message.empty()) {
-            std::thread(ExecuteCommand).detach(); // 异步执行
+        error_message.clear();
+        SubmitJob(".", job_gauges); });
+    Component batch_button = Button("加入批量任务", [&]
+                                    {
+        error_message.clear();
+        std::string list = batch_directories;
+        size_t start = 0;
+        while (start <= list.size()) {
+            size_t end = list.find(';', start);
+            if (end == std::string::npos)
+                end = list.size();
+            std::string directory = list.substr(start, end - start);
+            directory.erase(0, directory.find_first_not_of(" \t"));
+            directory.erase(directory.find_last_not_of(" \t") + 1);
+            if (!directory.empty() && !SubmitJob(directory, job_gauges))
+                break;
+            start = end + 1;
         } });
     Component quit_button = Button("退出", [&]
                                    { ScreenInteractive::Active()->Exit(); });
@@ -386,16 +1195,34 @@ int main()
         quality_input,
         loop_input,
         extension_input,
+        rename_free_checkbox,
+        two_pass_checkbox,
+        native_checkbox,
+        palette_colors_input,
+        quantizer_toggle,
+        palette_mode_toggle,
+        dither_toggle,
+        frame_delta_checkbox,
+        dedup_checkbox,
+        dedup_threshold_input,
+        decode_pipe_checkbox,
+        memory_budget_input,
+        stage_threads_input,
+        huge_pages_checkbox,
+        segments_input,
+        batch_input,
         Container::Horizontal({
             execute_button,
+            batch_button,
             quit_button,
         }),
+        job_gauges,
     });
 
     // 渲染界面
     auto renderer = Renderer(layout, [&]
                              {
-        GenerateCommand(); // 实时更新命令和错误信息
+        settingsModel.Refresh(); // 仅在设置变化时重新校验并生成命令
 
         Elements display_elements;
         display_elements.push_back(hbox(text(" 输出文件路径:  "), output_path_input->Render()));
@@ -404,9 +1231,54 @@ int main()
         display_elements.push_back(hbox(text(" 质量 (1-31):   "), quality_input->Render()));
         display_elements.push_back(hbox(text(" 循环次数:      "), loop_input->Render()));
         display_elements.push_back(hbox(text(" 文件后缀名:    "), extension_input->Render()));
+        display_elements.push_back(hbox(text(" 输入模式:      "), rename_free_checkbox->Render()));
+        display_elements.push_back(hbox(text(" 调色板:        "), two_pass_checkbox->Render()));
+        display_elements.push_back(hbox(text(" 编码器:        "), native_checkbox->Render()));
+        display_elements.push_back(hbox(text(" 调色板颜色:    "), palette_colors_input->Render()));
+        display_elements.push_back(hbox(text(" 量化算法:      "), quantizer_toggle->Render()));
+        display_elements.push_back(hbox(text(" 调色板范围:    "), palette_mode_toggle->Render()));
+        display_elements.push_back(hbox(text(" 抖动:          "), dither_toggle->Render()));
+        display_elements.push_back(hbox(text(" 帧间差分:      "), frame_delta_checkbox->Render()));
+        display_elements.push_back(hbox(text(" 去重:          "), dedup_checkbox->Render()));
+        display_elements.push_back(hbox(text(" 近似阈值:      "), dedup_threshold_input->Render()));
+        display_elements.push_back(hbox(text(" 解码:          "), decode_pipe_checkbox->Render()));
+        display_elements.push_back(hbox(text(" 内存上限 (MB): "), memory_budget_input->Render()));
+        display_elements.push_back(hbox(text(" 阶段线程:      "), stage_threads_input->Render()));
+        display_elements.push_back(hbox(text(" 大页内存:      "), huge_pages_checkbox->Render()));
+        display_elements.push_back(hbox(text(" 并行分段:      "), segments_input->Render()));
+        display_elements.push_back(hbox(text(" 批量目录:      "), batch_input->Render()));
+
+        // 实时帧统计（监视线程推送）
+        FrameStats received;
+        while (frameStatsReceiver->ReceiveNonBlocking(&received)) {
+            liveFrameStats = received;
+            hasLiveFrameStats = true;
+        }
+        size_t frame_count = hasLiveFrameStats ? liveFrameStats.count : frameIndex.size();
+        std::string frame_info = " 帧数:          " + std::to_string(frame_count);
+        if (hasLiveFrameStats && liveFrameStats.gaps > 0) {
+            frame_info += "  缺帧: " + std::to_string(liveFrameStats.gaps);
+        }
+        int fps = 0;
+        if (ParseIntSetting(settingsModel.framerate, fps) && fps > 0) {
+            std::ostringstream duration;
+            duration << std::fixed << std::setprecision(1) << static_cast<double>(frame_count) / fps;
+            frame_info += "  预计时长: " + duration.str() + "s";
+        }
+        display_elements.push_back(text(frame_info));
         display_elements.push_back(separator());
 
+        // 扫描警告显示
+        if (!scan_message.empty()) {
+            display_elements.push_back(text(scan_message) | color(Color::Yellow));
+            display_elements.push_back(separator());
+        }
+
         // 错误信息显示
+        if (!settingsModel.error_message().empty()) {
+            display_elements.push_back(text(settingsModel.error_message()) | color(Color::Red) | bold);
+            display_elements.push_back(separator());
+        }
         if (!error_message.empty()) {
             display_elements.push_back(text(error_message) | color(Color::Red) | bold);
             display_elements.push_back(separator());
@@ -414,46 +1286,88 @@ int main()
 
         // FFmpeg命令显示
         display_elements.push_back(text(" FFmpeg命令:"));
-        display_elements.push_back(text(command_display) | border | flex);
+        display_elements.push_back(text(settingsModel.command_display()) | border | flex);
         display_elements.push_back(separator());
 
-        // 进度条显示
-        if (is_running) {
-            display_elements.push_back(hbox({
-                text(" 进度: "),
-                gauge(progress) | flex,
-            }));
+        // 接收工作线程发送的任务状态
+        RunState received_state;
+        while (runStateReceiver->ReceiveNonBlocking(&received_state)) {
+            auto it = jobRows.find(received_state.job_id);
+            if (received_state.finished) {
+                result_message = received_state.result_message;
+                result_succeeded = received_state.succeeded;
+                if (it != jobRows.end()) {
+                    std::error_code ec;
+                    activeDirectories.erase(fs::weakly_canonical(it->second.job->directory, ec).string());
+                }
+            }
+            if (it != jobRows.end()) {
+                it->second.state = std::move(received_state);
+            }
+        }
+
+        // 任务队列及每个任务的进度
+        if (!jobRows.empty()) {
+            display_elements.push_back(text(" 任务队列: 等待 " + std::to_string(jobQueue->Pending()) +
+                                            "  运行 " + std::to_string(jobQueue->Active()) +
+                                            "  工作线程 " + std::to_string(jobQueue->workers())));
+            for (auto &[id, row] : jobRows) {
+                const RunState &st = row.state;
+                ftxui::Color status_color = ftxui::Color::Default;
+                if (st.finished) {
+                    status_color = st.succeeded ? ftxui::Color::Green : ftxui::Color::Red;
+                }
+                display_elements.push_back(hbox({
+                    text(" #" + std::to_string(id) + " " + row.job->directory + " "),
+                    row.gauge->Render() | flex,
+                    text(FormatRunStatus(st)) | color(status_color),
+                }));
+                if (st.running && !st.stage_loads.empty()) {
+                    display_elements.push_back(text(FormatStageLoads(st)) | dim);
+                }
+            }
             display_elements.push_back(separator());
         }
 
         // 运行结果显示
         if (!result_message.empty()) {
-            ftxui::Color result_color;
-            if (is_running) {
-                result_color = ftxui::Color::Default;
-            } else {
-                if (result_message.find("成功") != std::string::npos) {
-                    result_color = ftxui::Color::Green;
-                } else {
-                    result_color = ftxui::Color::Red;
-                }
-            }
-            display_elements.push_back(text(result_message) | color(result_color));
+            display_elements.push_back(text(result_message) | color(result_succeeded ? ftxui::Color::Green : ftxui::Color::Red));
             display_elements.push_back(separator());
         }
+
+        // 刷新统计：实际渲染帧数 / 收到的刷新请求数
+        redrawScheduler.OnFrameRendered();
+        display_elements.push_back(text(" 刷新: 渲染 " + std::to_string(redrawScheduler.FramesRendered()) +
+                                        " 帧 / 更新请求 " + std::to_string(redrawScheduler.UpdatesReceived()) + " 次") |
+                                   dim);
+
         // 按钮布局
         auto buttons = hbox({
             execute_button->Render() | border | color(Color::Green),
             text(" "),
+            batch_button->Render() | border | color(Color::Blue),
+            text(" "),
             quit_button->Render() | border | color(Color::Red),
         }) | center;
 
-        display_elements.push_back(buttons);
-
-        return vbox(display_elements) | border | flex | size(HEIGHT, LESS_THAN, 24); });
+        // 设置项和任务列表超出终端高度时在框内滚动（跟随焦点所在的输入框），按钮始终显示在底部
+        const int panel_height = std::max(Terminal::Size().dimy - 1, 12);
+        return vbox({
+                   vbox(display_elements) | vscroll_indicator | yframe | flex,
+                   buttons,
+               }) |
+               border | size(HEIGHT, LESS_THAN, panel_height); });
 
     // 启动交互式界面
     auto screen = ScreenInteractive::TerminalOutput();
     screen.Loop(renderer);
+
+    // 丢弃尚未开始的任务，等待运行中的任务结束（确保文件名已恢复）
+    if (jobQueue->Active() > 0)
+    {
+        std::cout << "等待 " << jobQueue->Active() << " 个正在运行的任务结束..." << std::endl;
+    }
+    jobQueue.reset();
+    frameWatcher.reset();
     return 0;
 }
\ No newline at end of file
@@ -0,0 +1,440 @@
+#ifndef GIFCMD_NATIVE_ENCODER_HPP
+#define GIFCMD_NATIVE_ENCODER_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <cmath>
+#include <condition_variable>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "color_quantizer.hpp"
+#include "dither.hpp"
+#include "frame_delta.hpp"
+#include "gif_writer.hpp"
+#include "image_decode.hpp"
+#include "image_resize.hpp"
+#include "ordered_work.hpp"
+#include "palette_mapper.hpp"
+#include "settings_model.hpp"
+#include "stage_pipeline.hpp"
+
+// 内置GIF编码器：进程内解码、缩放、量化、LZW压缩并写出GIF89a，不启动ffmpeg
+// 分两个阶段：1. 统计颜色直方图生成调色板；2. 读取/解码/缩放/映射（可抖动）/压缩组成流水线，按顺序写出
+// 流水线中的帧数受内存上限约束，与总帧数无关；各帧已分在不同线程中处理，抖动在各自的线程内单线程进行
+// 图像缓冲区取自帧缓冲池，其余缓冲区随帧对象或按线程循环使用：全局/按场景调色板时稳定运行后每帧不再分配内存
+//  - 全局：第一阶段只统计均匀抽样的帧，全部帧共用一个调色板
+//  - 按场景：第一阶段统计全部帧，相邻帧的粗直方图差别大时开始新场景，每个场景一个调色板
+//  - 逐帧：没有第一阶段，每帧在第二阶段各自量化
+// 第一个调色板写作全局颜色表，其余调色板作为所在帧的局部颜色表
+// 帧间差分时每个调色板末尾多留一个透明色，第 i 帧在映射后取得第 i-1 帧的映射结果，只压缩变化区域
+const size_t native_palette_sample_frames = 64; // 生成全局调色板时最多抽样的帧数
+const float scene_cut_threshold = 0.5f;         // 相邻帧粗直方图的L1距离（0-2）超过该值视为场景切换
+
+// 从第 start 个原始帧起持续 length 帧的延迟（1/100秒）：按累计时间取整，避免帧率不能整除100时的累积误差
+// 去重合并的帧 length 大于1；超出GIF的16位上限时截断
+inline int FrameDelay(size_t start, size_t length, int framerate)
+{
+    auto at = [framerate](size_t frame)
+    { return static_cast<long long>(std::llround(100.0 * frame / framerate)); };
+    return static_cast<int>(std::min(at(start + length) - at(start), 65535ll));
+}
+
+// 场景检测用的粗直方图：每通道取高2位共64个桶，按像素数归一化
+struct SceneSignature
+{
+    float bins[64] = {};
+
+    explicit SceneSignature(const ColorHistogram &histogram)
+    {
+        const auto &counts = histogram.counts();
+        for (int bucket = 0; bucket < static_cast<int>(counts.size()); bucket++)
+            bins[((bucket >> 13) << 4) | (((bucket >> 8) & 3) << 2) | ((bucket >> 3) & 3)] += counts[bucket];
+        float scale = histogram.total() ? 1.0f / histogram.total() : 0.0f;
+        for (float &bin : bins)
+            bin *= scale;
+    }
+
+    float Distance(const SceneSignature &other) const
+    {
+        float distance = 0;
+        for (int i = 0; i < 64; i++)
+            distance += std::fabs(bins[i] - other.bins[i]);
+        return distance;
+    }
+};
+
+// 一帧映射后的结果：帧间差分时由下一帧比较
+struct MappedFrame
+{
+    Palette palette;
+    std::vector<uint8_t> indices;
+};
+
+// 第二阶段相邻帧之间交接映射结果：第 i 帧在量化阶段发布到第 i % slots 个槽位，第 i+1 帧在压缩阶段读取
+// 槽位数为流水线中的帧数加1：第 i + slots 帧进入流水线时第 i+1 帧已经写出，槽位不会被提前覆盖；
+// 槽位的缓冲区循环使用，稳定后不再分配内存
+// 帧按顺序进入流水线，量化阶段不等待其他帧，因此不会死锁；任一帧失败时调用 Abort 唤醒等待者
+class FrameHandoff
+{
+public:
+    explicit FrameHandoff(size_t slots) : slots_(slots) {}
+
+    // 发布第 i 帧的映射结果，返回槽位中的副本（在第 i+1 帧写出之前有效）
+    const MappedFrame *Publish(size_t i, const Palette &palette, const std::vector<uint8_t> &indices)
+    {
+        Slot &slot = slots_[i % slots_.size()];
+        std::lock_guard<std::mutex> lock(mutex_);
+        slot.frame.palette = palette;
+        slot.frame.indices.assign(indices.begin(), indices.end());
+        slot.index = i;
+        published_.notify_all();
+        return &slot.frame;
+    }
+
+    void Abort()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        aborted_ = true;
+        published_.notify_all();
+    }
+
+    // 等待第 i 帧发布；已中止时返回空
+    const MappedFrame *Take(size_t i)
+    {
+        Slot &slot = slots_[i % slots_.size()];
+        std::unique_lock<std::mutex> lock(mutex_);
+        published_.wait(lock, [&]
+                        { return aborted_ || slot.index == i; });
+        return aborted_ ? nullptr : &slot.frame;
+    }
+
+private:
+    struct Slot
+    {
+        size_t index = SIZE_MAX; // 最近发布到该槽位的帧
+        MappedFrame frame;
+    };
+
+    std::mutex mutex_;
+    std::condition_variable published_;
+    std::vector<Slot> slots_;
+    bool aborted_ = false;
+};
+
+// 相对上一帧的差分：调色板相同时比较索引，否则比较映射后的颜色；结果写入 out，返回其在画面中的位置
+inline DeltaRect MappedFrameDelta(const MappedFrame &previous, const MappedFrame &current, int width, int height,
+                                  uint8_t transparent, std::vector<uint8_t> &out)
+{
+    DeltaRect rect;
+    if (previous.palette.size == current.palette.size &&
+        std::memcmp(previous.palette.colors, current.palette.colors, previous.palette.size * 3) == 0)
+    {
+        rect = ChangedRect(previous.indices.data(), current.indices.data(), width, height, 1);
+        ExtractDelta(previous.indices.data(), current.indices.data(), 1, current.indices.data(), width, rect,
+                     transparent, out);
+        return rect;
+    }
+
+    thread_local std::vector<uint8_t> before, after;
+    auto expand = [](const MappedFrame &frame, std::vector<uint8_t> &rgb)
+    {
+        rgb.resize(frame.indices.size() * 3);
+        for (size_t i = 0; i < frame.indices.size(); i++)
+            std::memcpy(&rgb[i * 3], frame.palette.colors[frame.indices[i]], 3);
+    };
+    expand(previous, before);
+    expand(current, after);
+    rect = ChangedRect(before.data(), after.data(), width, height, 3);
+    ExtractDelta(before.data(), after.data(), 3, current.indices.data(), width, rect, transparent, out);
+    return rect;
+}
+
+// 编码 dirfd 目录中按顺序排列的 names 帧，写出到 output_path（先写临时文件，完成后重命名）
+// lengths 为去重后每帧代表的原始帧数（为空时每帧都是1），帧延迟按原始帧的累计时间计算
+// workers 为未设置各阶段线程数时每个计算阶段的线程数
+// on_progress(stage, done, total) 在每处理完一帧后调用（stage 1 为生成调色板，2 为编码）；
+// on_loads 在第二阶段每写出一帧后、on_progress 之前调用，参数为各阶段的负载
+// 返回错误信息（成功时为空）
+inline std::string EncodeGifNative(int dirfd, const std::vector<std::string> &names,
+                                   const std::vector<uint32_t> &lengths, const EncodeSettings &settings,
+                                   const std::string &output_path, size_t workers,
+                                   const std::function<void(int, size_t, size_t)> &on_progress,
+                                   const std::function<void(const std::vector<StageLoad> &)> &on_loads = nullptr)
+{
+    if (names.empty())
+        return "没有帧可编码";
+
+    // 第一帧决定输出尺寸，之后的帧都缩放到同一尺寸；
+    // 它的解码结果直接用作第一阶段的第0个样本，再交给第二阶段的流水线，不再读取和解码第二次
+    std::vector<uint8_t> first_file;
+    RgbImage first;
+    if (!ReadImageFile(dirfd, names[0], first_file) || !DecodeImage(first_file, first))
+        return "无法解码 " + names[0];
+    const int width = settings.width;
+    const int height = ScaledHeight(first.width, first.height, width);
+    if (width > 65535 || height > 65535)
+        return "输出尺寸超出GIF限制";
+    const size_t pixels = static_cast<size_t>(width) * height;
+    // 第一阶段每个结果持有一帧文件、解码结果和缩放结果，数量同样受内存上限约束
+    const size_t window =
+        std::clamp<size_t>(settings.memory_budget / (first_file.size() + first.bytes() + pixels * 3), 1, workers * 2);
+    const int colors = NativePaletteSize(settings);
+    const bool per_frame = settings.palette_mode == PaletteMode::per_frame;
+
+    // 第一阶段生成的调色板：scene_starts[k] 为使用第k个调色板的第一帧
+    std::vector<Palette> palettes;
+    std::vector<std::unique_ptr<PaletteMapper>> mappers;
+    std::vector<size_t> scene_starts;
+    auto add_palette = [&](const ColorHistogram &histogram, size_t start)
+    {
+        palettes.push_back(Quantize(histogram, colors, settings.quantizer));
+        mappers.push_back(std::make_unique<PaletteMapper>(palettes.back()));
+        scene_starts.push_back(start);
+    };
+
+    // 第一阶段：各线程统计自己那一帧的直方图，调用线程按顺序合并，按场景时在切换处生成上一场景的调色板
+    if (!per_frame)
+    {
+        struct SampledFrame
+        {
+            std::vector<uint8_t> file;
+            RgbImage decoded;
+            RgbImage scaled;
+            ColorHistogram histogram;
+        };
+        const bool scenes = settings.palette_mode == PaletteMode::per_scene;
+        size_t stride = scenes ? 1 : (names.size() + native_palette_sample_frames - 1) / native_palette_sample_frames;
+        size_t samples = (names.size() + stride - 1) / stride;
+        ColorHistogram accumulated;
+        std::unique_ptr<SceneSignature> previous;
+        size_t scene_start = 0;
+        bool ok = ParallelOrdered<SampledFrame>(
+            samples, std::min(workers, window), window,
+            [&](size_t i, SampledFrame &frame)
+            {
+                const RgbImage *decoded = &first;
+                if (i > 0)
+                {
+                    if (!ReadImageFile(dirfd, names[i * stride], frame.file) || !DecodeImage(frame.file, frame.decoded))
+                        return false;
+                    decoded = &frame.decoded;
+                }
+                if (!ResizeImage(*decoded, width, height, frame.scaled))
+                    return false;
+                frame.histogram.Clear();
+                frame.histogram.Add(frame.scaled);
+                return true;
+            },
+            [&](size_t i, SampledFrame &frame)
+            {
+                if (scenes)
+                {
+                    auto signature = std::make_unique<SceneSignature>(frame.histogram);
+                    if (previous && signature->Distance(*previous) > scene_cut_threshold)
+                    {
+                        add_palette(accumulated, scene_start);
+                        accumulated.Clear();
+                        scene_start = i;
+                    }
+                    previous = std::move(signature);
+                }
+                accumulated.Merge(frame.histogram);
+                on_progress(1, i + 1, samples);
+                return true;
+            });
+        if (!ok)
+            return "解码或缩放失败（生成调色板）";
+        add_palette(accumulated, scene_start);
+    }
+    auto scene_of = [&](size_t i)
+    { return static_cast<size_t>(std::upper_bound(scene_starts.begin(), scene_starts.end(), i) - scene_starts.begin()) - 1; };
+
+    // 第二阶段：读取、解码、缩放、量化（映射）、压缩各为流水线的一个阶段，调用线程按顺序写出
+    // 写出器在第一帧时打开：逐帧模式的全局颜色表即第一帧的调色板
+    std::string temp_path = output_path + ".part";
+    GifWriter writer;
+    bool opened = false;
+
+    // 各缓冲区随帧对象循环使用：图像取自帧缓冲池，尺寸不变时沿用，索引和压缩结果沿用容量
+    struct EncodedFrame
+    {
+        std::vector<uint8_t> file;
+        RgbImage decoded;
+        RgbImage scaled;
+        Palette palette; // 该帧映射所用的调色板（逐帧模式中为该帧自己的调色板）
+        std::vector<uint8_t> indices;
+        const MappedFrame *mapped = nullptr; // 帧间差分时发布给下一帧的映射结果
+        std::vector<uint8_t> delta;          // 帧间差分后要压缩的区域
+        std::vector<uint8_t> compressed;
+        DeltaRect rect;       // 写出的区域
+        int transparent = -1; // 透明色（不使用时为-1）
+    };
+    const bool delta = settings.frame_delta;
+    // 写出的颜色表：帧间差分时在末尾加一个透明色
+    auto color_table = [delta](const Palette &palette)
+    {
+        Palette table = palette;
+        if (delta)
+        {
+            std::fill(table.colors[table.size], table.colors[table.size] + 3, 0);
+            table.size++;
+        }
+        return table;
+    };
+    // 同时在流水线中的帧数受内存上限约束：每帧按第一帧估算文件、解码结果、缩放结果、索引和压缩结果，
+    // 帧间差分时另有交给下一帧的映射结果和差分区域；帧数多于各阶段线程总数的两倍时已不能提高吞吐
+    StagePipeline<EncodedFrame> pipeline;
+    size_t stage_threads = 0;
+    for (size_t k = 0; k < pipeline_stage_names.size(); k++)
+        stage_threads += settings.StageThreads(k, workers);
+    const size_t scaled_bytes = FramePool::RowStride(width, PixelFormat::rgb24) * height;
+    const size_t frame_bytes = first_file.size() + first.bytes() + scaled_bytes + pixels * (delta ? 4 : 2);
+    const size_t in_flight = std::clamp<size_t>(settings.memory_budget / frame_bytes, 1, stage_threads * 2);
+    FrameHandoff handoff(delta ? in_flight + 1 : 1);
+
+    std::atomic<size_t> failed_frame{names.size()};
+    std::atomic<bool> resize_failed{false};
+    auto fail = [&](size_t i)
+    {
+        failed_frame = i;
+        handoff.Abort();
+        return false;
+    };
+
+    // 第一帧的文件和解码结果移交给流水线（第一阶段已经用完），缓冲区留给之后的帧复用
+    pipeline.AddStage("读取", settings.StageThreads(0, workers),
+                      [&](size_t i, EncodedFrame &frame)
+                      {
+                          if (i == 0)
+                          {
+                              frame.file = std::move(first_file);
+                              return true;
+                          }
+                          return ReadImageFile(dirfd, names[i], frame.file) || fail(i);
+                      });
+    pipeline.AddStage("解码", settings.StageThreads(1, workers),
+                      [&](size_t i, EncodedFrame &frame)
+                      {
+                          if (i == 0)
+                          {
+                              frame.decoded = std::move(first);
+                              return true;
+                          }
+                          return DecodeImage(frame.file, frame.decoded) || fail(i);
+                      });
+    pipeline.AddStage("缩放", settings.StageThreads(2, workers),
+                      [&](size_t i, EncodedFrame &frame)
+                      {
+                          if (ResizeImage(frame.decoded, width, height, frame.scaled))
+                              return true;
+                          resize_failed = true;
+                          return fail(i);
+                      });
+    pipeline.AddStage("量化", settings.StageThreads(3, workers),
+                      [&](size_t i, EncodedFrame &frame)
+                      {
+                          if (per_frame)
+                          {
+                              thread_local ColorHistogram histogram;
+                              histogram.Clear();
+                              histogram.Add(frame.scaled);
+                              frame.palette = Quantize(histogram, colors, settings.quantizer);
+                              DitherImage(frame.scaled, PaletteMapper(frame.palette), settings.dither, frame.indices);
+                          }
+                          else
+                          {
+                              size_t scene = scene_of(i);
+                              frame.palette = palettes[scene];
+                              DitherImage(frame.scaled, *mappers[scene], settings.dither, frame.indices);
+                          }
+                          // 映射结果在本阶段发布，下一帧在压缩阶段取走：量化阶段不等待其他帧，取走时不会死锁
+                          if (delta)
+                              frame.mapped = handoff.Publish(i, frame.palette, frame.indices);
+                          return true;
+                      });
+    pipeline.AddStage("压缩", settings.StageThreads(4, workers),
+                      [&](size_t i, EncodedFrame &frame)
+                      {
+                          // 第一帧整帧写出，之后的帧只写出相对上一帧的变化
+                          frame.rect = DeltaRect{0, 0, width, height};
+                          frame.transparent = -1;
+                          const std::vector<uint8_t> *output = &frame.indices;
+                          if (delta && i > 0)
+                          {
+                              const MappedFrame *previous = handoff.Take(i - 1);
+                              if (!previous)
+                                  return false;
+                              frame.transparent = frame.palette.size;
+                              frame.rect = MappedFrameDelta(*previous, *frame.mapped, width, height,
+                                                            static_cast<uint8_t>(frame.transparent), frame.delta);
+                              output = &frame.delta;
+                          }
+                          CompressGifFrame(output->data(), output->size(),
+                                           PaletteBits(frame.palette.size + (delta ? 1 : 0)), frame.compressed);
+                          return true;
+                      });
+
+    size_t position = 0; // 当前帧在原始帧序列中的位置（写出线程按顺序累加）
+    std::vector<StageLoad> loads;
+    bool ok = pipeline.Run(
+        names.size(), in_flight, "写出",
+        [&](size_t i, EncodedFrame &frame)
+        {
+            if (i == 0)
+            {
+                opened = writer.Open(temp_path, width, height, color_table(frame.palette), settings.loop_count);
+                if (!opened)
+                {
+                    handoff.Abort();
+                    return false;
+                }
+            }
+            // 第一帧（逐帧模式）或第一个场景使用全局颜色表
+            Palette local;
+            bool has_local = false;
+            if (per_frame && i > 0)
+            {
+                local = color_table(frame.palette);
+                has_local = true;
+            }
+            else if (!per_frame && scene_of(i) > 0)
+            {
+                local = color_table(palettes[scene_of(i)]);
+                has_local = true;
+            }
+            const size_t length = lengths.empty() ? 1 : lengths[i];
+            writer.WriteFrame(frame.rect.x, frame.rect.y, frame.rect.width, frame.rect.height,
+                              FrameDelay(position, length, settings.framerate), frame.compressed,
+                              has_local ? &local : nullptr, frame.transparent);
+            position += length;
+            if (on_loads)
+            {
+                pipeline.Loads(loads);
+                on_loads(loads);
+            }
+            on_progress(2, i + 1, names.size());
+            return true;
+        });
+
+    std::string error;
+    bool written = writer.Close();
+    if (failed_frame < names.size())
+        error = (resize_failed ? "内存不足，无法缩放 " : "无法解码 ") + names[failed_frame.load()];
+    else if (!opened)
+        error = "无法创建输出文件 " + temp_path;
+    else if (!ok || !written)
+        error = "写入输出文件失败：" + output_path;
+    else if (std::rename(temp_path.c_str(), output_path.c_str()) != 0)
+        error = "无法替换输出文件：" + output_path;
+    if (!error.empty())
+        std::remove(temp_path.c_str());
+    return error;
+}
+
+#endif // GIFCMD_NATIVE_ENCODER_HPP
@@ -0,0 +1,92 @@
+#ifndef GIFCMD_ORDERED_WORK_HPP
+#define GIFCMD_ORDERED_WORK_HPP
+
+#include <algorithm>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 有序并行处理：workers 个线程乱序执行 produce(i, result)，调用线程按 0..count-1 的顺序执行 consume(i, result)
+// 已生产但未消费的结果最多 window 个（重排缓冲区），内存占用与总数无关
+// produce 或 consume 返回false时停止，函数返回false
+template <class T, class Produce, class Consume>
+bool ParallelOrdered(size_t count, size_t workers, size_t window, Produce &&produce, Consume &&consume)
+{
+    workers = std::max<size_t>(1, std::min(workers, count));
+    window = std::max(window, workers);
+
+    std::mutex mutex;
+    std::condition_variable slot_ready; // 通知消费者
+    std::condition_variable slot_free;  // 通知生产者
+    std::vector<T> slots(window);
+    std::vector<char> ready(window, 0);
+    size_t next_claim = 0; // 下一个待领取的下标
+    size_t consumed = 0;   // 已消费的数量
+    bool failed = false;
+
+    auto worker = [&]
+    {
+        T result;
+        for (;;)
+        {
+            size_t i;
+            {
+                std::unique_lock<std::mutex> lock(mutex);
+                slot_free.wait(lock, [&]
+                               { return failed || next_claim >= count || next_claim < consumed + window; });
+                if (failed || next_claim >= count)
+                    return;
+                i = next_claim++;
+            }
+
+            bool ok = produce(i, result);
+
+            std::lock_guard<std::mutex> lock(mutex);
+            if (!ok)
+            {
+                failed = true;
+                slot_free.notify_all();
+                slot_ready.notify_all();
+                return;
+            }
+            std::swap(slots[i % window], result);
+            ready[i % window] = 1;
+            slot_ready.notify_all();
+        }
+    };
+
+    std::vector<std::thread> threads;
+    for (size_t w = 0; w < workers; w++)
+        threads.emplace_back(worker);
+
+    T current;
+    for (size_t i = 0; i < count; i++)
+    {
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            slot_ready.wait(lock, [&]
+                            { return failed || ready[i % window]; });
+            if (failed)
+                break;
+            std::swap(current, slots[i % window]);
+            ready[i % window] = 0;
+            consumed++;
+            slot_free.notify_all();
+        }
+        if (!consume(i, current))
+        {
+            std::lock_guard<std::mutex> lock(mutex);
+            failed = true;
+            slot_free.notify_all();
+            break;
+        }
+    }
+
+    for (auto &thread : threads)
+        thread.join();
+    return !failed;
+}
+
+#endif // GIFCMD_ORDERED_WORK_HPP
@@ -0,0 +1,146 @@
+#ifndef GIFCMD_PALETTE_CACHE_HPP
+#define GIFCMD_PALETTE_CACHE_HPP
+
+#include <algorithm>
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <ctime>
+#include <string>
+#include <string_view>
+#include <vector>
+#include <dirent.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include "frame_index.hpp"
+
+// 调色板缓存：任务目录下的 .gifcmd_palettes/<键>.png
+// 键由参与生成调色板的帧（文件名、大小、mtime）和影响调色板的设置（缩放宽度、帧率、抽样步长）散列得到，
+// 只修改循环次数或输出路径时键不变，直接复用已有调色板
+const char palette_cache_directory[] = ".gifcmd_palettes";
+const size_t palette_cache_limit = 32; // 每个目录最多保留的调色板数
+
+// 64位 FNV-1a 散列
+class Fnv1aHash
+{
+public:
+    void Add(const void *data, size_t size)
+    {
+        auto *p = static_cast<const unsigned char *>(data);
+        for (size_t i = 0; i < size; i++)
+        {
+            hash_ ^= p[i];
+            hash_ *= 1099511628211ULL;
+        }
+    }
+    void Add(uint64_t value) { Add(&value, sizeof(value)); }
+    // 字符串带长度写入，避免相邻字段拼接产生歧义
+    void Add(std::string_view text)
+    {
+        Add(static_cast<uint64_t>(text.size()));
+        Add(text.data(), text.size());
+    }
+
+    uint64_t value() const { return hash_; }
+
+private:
+    uint64_t hash_ = 14695981039346656037ULL;
+};
+
+// 计算调色板缓存键：index 中每隔 stride 帧取一帧（需在重命名之前调用，使用原始文件名）
+// 有帧无法stat时返回false
+inline bool PaletteCacheKey(int dirfd, const FrameIndex &index, size_t stride, int width, int framerate, uint64_t &key)
+{
+    Fnv1aHash hash;
+    hash.Add(static_cast<uint64_t>(width));
+    hash.Add(static_cast<uint64_t>(framerate));
+    hash.Add(static_cast<uint64_t>(stride));
+    hash.Add(static_cast<uint64_t>(index.size()));
+
+    std::string name;
+    for (size_t i = 0; i < index.size(); i += stride)
+    {
+        name.assign(index.Name(i));
+        struct stat st;
+        if (::fstatat(dirfd, name.c_str(), &st, 0) != 0)
+            return false;
+        hash.Add(name);
+        hash.Add(static_cast<uint64_t>(st.st_size));
+        hash.Add(static_cast<uint64_t>(st.st_mtim.tv_sec) * 1000000000ULL + static_cast<uint64_t>(st.st_mtim.tv_nsec));
+    }
+    key = hash.value();
+    return true;
+}
+
+// 缓存中的调色板路径（相对任务目录）
+inline std::string PaletteCachePath(uint64_t key)
+{
+    char name[32];
+    std::snprintf(name, sizeof(name), "%016llx", static_cast<unsigned long long>(key));
+    return std::string(palette_cache_directory) + "/" + name + ".png";
+}
+
+// 生成中的临时文件（保留.png后缀，ffmpeg按后缀选择格式），成功后重命名为 PaletteCachePath
+inline std::string PaletteTempPath(uint64_t key)
+{
+    std::string path = PaletteCachePath(key);
+    return path.insert(path.size() - 4, ".tmp");
+}
+
+// 确保缓存目录存在
+inline bool EnsurePaletteCacheDirectory(int dirfd)
+{
+    return ::mkdirat(dirfd, palette_cache_directory, 0755) == 0 || errno == EEXIST;
+}
+
+// 缓存命中时返回true，并更新其mtime（清理时按mtime淘汰最久未用的调色板）
+inline bool UseCachedPalette(int dirfd, uint64_t key)
+{
+    std::string path = PaletteCachePath(key);
+    struct stat st;
+    if (::fstatat(dirfd, path.c_str(), &st, 0) != 0 || !S_ISREG(st.st_mode) || st.st_size == 0)
+        return false;
+    ::utimensat(dirfd, path.c_str(), nullptr, 0);
+    return true;
+}
+
+// 把生成好的临时调色板放入缓存，并删除最旧的调色板使数量不超过上限
+inline bool CommitCachedPalette(int dirfd, uint64_t key)
+{
+    if (::renameat(dirfd, PaletteTempPath(key).c_str(), dirfd, PaletteCachePath(key).c_str()) != 0)
+    {
+        ::unlinkat(dirfd, PaletteTempPath(key).c_str(), 0);
+        return false;
+    }
+
+    int fd = ::openat(dirfd, palette_cache_directory, O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+    if (fd < 0)
+        return true;
+    DIR *dir = ::fdopendir(fd);
+    if (!dir)
+    {
+        ::close(fd);
+        return true;
+    }
+
+    std::vector<std::pair<int64_t, std::string>> entries;
+    while (struct dirent *entry = ::readdir(dir))
+    {
+        std::string_view name = entry->d_name;
+        struct stat st;
+        if (name.size() > 4 && name.substr(name.size() - 4) == ".png" && name.find(".tmp.") == std::string_view::npos &&
+            ::fstatat(fd, entry->d_name, &st, 0) == 0 && S_ISREG(st.st_mode))
+            entries.emplace_back(static_cast<int64_t>(st.st_mtim.tv_sec) * 1000000000LL + st.st_mtim.tv_nsec, entry->d_name);
+    }
+    if (entries.size() > palette_cache_limit)
+    {
+        std::sort(entries.begin(), entries.end());
+        for (size_t i = 0; i + palette_cache_limit < entries.size(); i++)
+            ::unlinkat(fd, entries[i].second.c_str(), 0);
+    }
+    ::closedir(dir);
+    return true;
+}
+
+#endif // GIFCMD_PALETTE_CACHE_HPP
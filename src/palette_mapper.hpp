@@ -0,0 +1,294 @@
+#ifndef GIFCMD_PALETTE_MAPPER_HPP
+#define GIFCMD_PALETTE_MAPPER_HPP
+
+#include <algorithm>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <vector>
+#include "color_quantizer.hpp"
+#include "cpu_features.hpp"
+#include "image_decode.hpp"
+
+// 最近颜色映射，结果与逐个比较全部调色板颜色（距离相同取下标小的）完全一致
+//  - 逆调色板表：每通道6位共262144个格子，每个格子 4x4x4 种颜色；首次用到时才计算（惰性填充）
+//  - 整个格子都离同一个调色板颜色最近时，表中直接存该下标；否则格子“有争议”，
+//    用k-d树找出可能的候选项，逐个算出格子内64种颜色的最近项存入一个细分块，表中存块号
+//  - 表项和细分块用原子操作发布，多个线程可以共用一个映射器
+class PaletteMapper
+{
+public:
+    explicit PaletteMapper(const Palette &palette) : palette_(palette), lut_(cell_count, unknown)
+    {
+        // 颜色相同的项只保留下标最小的（逐个比较时后面的永远不会被选中）
+        std::vector<int> points;
+        for (int i = 0; i < palette.size; i++)
+        {
+            bool duplicate = false;
+            for (int j : points)
+                duplicate = duplicate || std::equal(palette.colors[i], palette.colors[i] + 3, palette.colors[j]);
+            if (!duplicate)
+                points.push_back(i);
+        }
+        nodes_.reserve(points.size());
+        Build(points, 0, static_cast<int>(points.size()));
+    }
+
+    // 单个颜色的调色板下标
+    uint8_t MapColor(const uint8_t *rgb) const
+    {
+        uint32_t entry = Entry(Cell(rgb));
+        if (entry < 256)
+            return static_cast<uint8_t>(entry);
+        if (entry == overflow)
+            return static_cast<uint8_t>(Nearest(rgb[0], rgb[1], rgb[2]));
+        entry -= 256;
+        return blocks_[entry / chunk_blocks][entry % chunk_blocks][((rgb[0] & 3) << 4) | ((rgb[1] & 3) << 2) | (rgb[2] & 3)];
+    }
+
+    // 一行（或任意连续的）n 个像素映射为下标，out 至少 n 字节
+    void MapRow(const uint8_t *rgb, size_t n, uint8_t *out, SimdLevel level = DetectSimdLevel()) const
+    {
+#ifdef GIFCMD_X86
+        if (level == SimdLevel::avx2)
+            return MapRowAvx2(rgb, n, out);
+#endif
+        (void)level;
+        for (size_t i = 0; i < n; i++, rgb += 3)
+            out[i] = MapColor(rgb);
+    }
+
+    // 把图像映射为调色板索引
+    void Map(const RgbImage &image, std::vector<uint8_t> &indices) const
+    {
+        const size_t width = static_cast<size_t>(image.width);
+        indices.resize(width * image.height);
+        for (int y = 0; y < image.height; y++)
+            MapRow(image.Row(y), width, indices.data() + y * width);
+    }
+
+    const Palette &palette() const { return palette_; }
+
+private:
+    static constexpr uint32_t cell_count = 1u << 18;
+    static constexpr uint32_t chunk_blocks = 256;                          // 细分块按块组分配，块组地址不再变化
+    static constexpr uint32_t max_blocks = cell_count;                     // 每个格子至多一个细分块
+    static constexpr uint32_t unknown = 0xFFFFFFFF;                        // 尚未计算
+    static constexpr uint32_t overflow = 0xFFFFFFFE;                       // 细分块用完（并发重复计算时），逐像素搜索
+    using Block = uint8_t[64];
+
+    // k-d 树节点：按 axis 通道在 point 的颜色处切分
+    struct Node
+    {
+        int point;
+        int axis;
+        int left = -1, right = -1;
+    };
+
+    static uint32_t Cell(const uint8_t *rgb) { return ((rgb[0] >> 2) << 12) | ((rgb[1] >> 2) << 6) | (rgb[2] >> 2); }
+
+    // 递归建树：在跨度最大的通道上取中位点；返回子树根节点
+    int Build(std::vector<int> &points, int begin, int end)
+    {
+        if (begin >= end)
+            return -1;
+        int lo[3] = {255, 255, 255}, hi[3] = {0, 0, 0};
+        for (int i = begin; i < end; i++)
+        {
+            for (int c = 0; c < 3; c++)
+            {
+                lo[c] = std::min<int>(lo[c], palette_.colors[points[i]][c]);
+                hi[c] = std::max<int>(hi[c], palette_.colors[points[i]][c]);
+            }
+        }
+        int axis = 0;
+        for (int c = 1; c < 3; c++)
+        {
+            if (hi[c] - lo[c] > hi[axis] - lo[axis])
+                axis = c;
+        }
+        int mid = (begin + end) / 2;
+        std::nth_element(points.begin() + begin, points.begin() + mid, points.begin() + end, [&](int a, int b)
+                         { return palette_.colors[a][axis] < palette_.colors[b][axis]; });
+
+        int index = static_cast<int>(nodes_.size());
+        nodes_.push_back({points[mid], axis});
+        int left = Build(points, begin, mid);
+        int right = Build(points, mid + 1, end);
+        nodes_[index].left = left;
+        nodes_[index].right = right;
+        return index;
+    }
+
+    int Distance(int point, int r, int g, int b) const
+    {
+        int dr = r - palette_.colors[point][0], dg = g - palette_.colors[point][1], db = b - palette_.colors[point][2];
+        return dr * dr + dg * dg + db * db;
+    }
+
+    // 精确最近邻：距离相同取下标小的，因此切分面距离等于当前最佳距离时另一侧也要搜索
+    void Search(int node, const int *q, int &best, int &best_distance) const
+    {
+        while (node >= 0)
+        {
+            const Node &n = nodes_[node];
+            int d = Distance(n.point, q[0], q[1], q[2]);
+            if (d < best_distance || (d == best_distance && n.point < best))
+            {
+                best = n.point;
+                best_distance = d;
+            }
+            int diff = q[n.axis] - palette_.colors[n.point][n.axis];
+            int near = diff < 0 ? n.left : n.right;
+            int far = diff < 0 ? n.right : n.left;
+            if (diff * diff <= best_distance)
+                Search(far, q, best, best_distance);
+            node = near;
+        }
+    }
+
+    int Nearest(int r, int g, int b) const
+    {
+        const int q[3] = {r, g, b};
+        int best = nodes_.empty() ? 0 : nodes_[0].point, best_distance = 1 << 30;
+        Search(0, q, best, best_distance);
+        return best;
+    }
+
+    // 收集与格子 [lo, hi] 的最小距离平方不超过 bound 的点（按切分面到格子的距离剪枝）
+    void Collect(int node, const int *lo, const int *hi, int bound, std::vector<int> &points) const
+    {
+        while (node >= 0)
+        {
+            const Node &n = nodes_[node];
+            int d = 0;
+            for (int c = 0; c < 3; c++)
+            {
+                int v = palette_.colors[n.point][c];
+                int gap = v < lo[c] ? lo[c] - v : (v > hi[c] ? v - hi[c] : 0);
+                d += gap * gap;
+            }
+            if (d <= bound)
+                points.push_back(n.point);
+            int split = palette_.colors[n.point][n.axis];
+            // 格子在切分面左侧的部分只可能接近左子树中的点，右侧同理
+            int left_gap = lo[n.axis] > split ? lo[n.axis] - split : 0;
+            int right_gap = hi[n.axis] < split ? split - hi[n.axis] : 0;
+            bool left = left_gap * left_gap <= bound;
+            bool right = right_gap * right_gap <= bound;
+            if (left && right)
+                Collect(n.right, lo, hi, bound, points);
+            node = left ? n.left : (right ? n.right : -1);
+        }
+    }
+
+    // 计算一个格子：best 为离格子中心最近的项，格子内离 best 最远的距离为 farthest；
+    // 与格子的最小距离超过 farthest 的项在格子内处处比 best 远，只有其余的候选项可能是最近项
+    uint32_t Classify(uint32_t cell) const
+    {
+        const int lo[3] = {static_cast<int>(cell >> 12) << 2, static_cast<int>((cell >> 6) & 63) << 2,
+                           static_cast<int>(cell & 63) << 2};
+        const int hi[3] = {lo[0] + 3, lo[1] + 3, lo[2] + 3};
+        int best = Nearest(lo[0] + 2, lo[1] + 2, lo[2] + 2);
+        int farthest = 0;
+        for (int c = 0; c < 3; c++)
+        {
+            int v = palette_.colors[best][c];
+            int gap = std::max(v - lo[c], hi[c] - v);
+            farthest += gap * gap;
+        }
+        thread_local std::vector<int> candidates;
+        candidates.clear();
+        Collect(0, lo, hi, farthest, candidates);
+        if (candidates.size() <= 1)
+            return static_cast<uint32_t>(best);
+
+        // 有争议：分配一个细分块，在候选项中逐个算出格子内每种颜色的最近项（按下标顺序比较，距离相同取下标小的）
+        uint32_t id;
+        {
+            std::lock_guard<std::mutex> lock(blocks_mutex_);
+            if (block_count_ >= max_blocks)
+                return overflow;
+            id = block_count_++;
+            if (!blocks_[id / chunk_blocks])
+                blocks_[id / chunk_blocks] = std::make_unique<Block[]>(chunk_blocks);
+        }
+        std::sort(candidates.begin(), candidates.end());
+        Block &block = blocks_[id / chunk_blocks][id % chunk_blocks];
+        for (int i = 0; i < 64; i++)
+        {
+            int r = lo[0] + (i >> 4), g = lo[1] + ((i >> 2) & 3), b = lo[2] + (i & 3);
+            int nearest = candidates[0], nearest_distance = Distance(nearest, r, g, b);
+            for (size_t k = 1; k < candidates.size(); k++)
+            {
+                int d = Distance(candidates[k], r, g, b);
+                if (d < nearest_distance)
+                {
+                    nearest_distance = d;
+                    nearest = candidates[k];
+                }
+            }
+            block[i] = static_cast<uint8_t>(nearest);
+        }
+        return id + 256;
+    }
+
+    // 读取表项，尚未计算时计算并发布（release 保证其他线程读到块号时块的内容已写好）
+    uint32_t Entry(uint32_t cell) const
+    {
+        uint32_t entry = __atomic_load_n(&lut_[cell], __ATOMIC_ACQUIRE);
+        if (entry == unknown)
+        {
+            entry = Classify(cell);
+            __atomic_store_n(&lut_[cell], entry, __ATOMIC_RELEASE);
+        }
+        return entry;
+    }
+
+#ifdef GIFCMD_X86
+    // 每次8个像素：向量化计算格子下标并 gather 表项，8项都是下标时直接打包写出，否则逐个处理
+    GIFCMD_TARGET_AVX2 void MapRowAvx2(const uint8_t *rgb, size_t n, uint8_t *out) const
+    {
+        const __m256i mask = _mm256_broadcastsi128_si256(
+            _mm_setr_epi8(0, 1, 2, -1, 3, 4, 5, -1, 6, 7, 8, -1, 9, 10, 11, -1));
+        const __m256i high = _mm256_set1_epi32(~0xFF);
+        const int *table = reinterpret_cast<const int *>(lut_.data());
+        size_t i = 0;
+        for (; i + 10 <= n; i += 8)
+        {
+            const uint8_t *q = rgb + i * 3;
+            __m256i v = _mm256_inserti128_si256(
+                _mm256_castsi128_si256(_mm_loadu_si128(reinterpret_cast<const __m128i *>(q))),
+                _mm_loadu_si128(reinterpret_cast<const __m128i *>(q + 12)), 1);
+            v = _mm256_shuffle_epi8(v, mask); // 每个32位通道为 r | g << 8 | b << 16
+            __m256i r = _mm256_slli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xFC)), 10);
+            __m256i g = _mm256_srli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xFC00)), 4);
+            __m256i b = _mm256_srli_epi32(_mm256_and_si256(v, _mm256_set1_epi32(0xFC0000)), 18);
+            __m256i cells = _mm256_or_si256(_mm256_or_si256(r, g), b);
+            // 未计算、细分块和 overflow 表项都大于255
+            __m256i entries = _mm256_i32gather_epi32(table, cells, 4);
+            if (_mm256_testz_si256(entries, high))
+            {
+                __m128i packed = _mm_packus_epi32(_mm256_castsi256_si128(entries), _mm256_extracti128_si256(entries, 1));
+                _mm_storel_epi64(reinterpret_cast<__m128i *>(out + i), _mm_packus_epi16(packed, packed));
+            }
+            else
+            {
+                for (size_t k = 0; k < 8; k++)
+                    out[i + k] = MapColor(q + k * 3);
+            }
+        }
+        for (; i < n; i++)
+            out[i] = MapColor(rgb + i * 3);
+    }
+#endif
+
+    Palette palette_;
+    std::vector<Node> nodes_;           // nodes_[0] 为根
+    mutable std::vector<uint32_t> lut_; // 格子 -> 下标（<256）/ 256 + 细分块号 / overflow / unknown
+    mutable std::mutex blocks_mutex_;
+    mutable std::unique_ptr<Block[]> blocks_[max_blocks / chunk_blocks];
+    mutable uint32_t block_count_ = 0;
+};
+
+#endif // GIFCMD_PALETTE_MAPPER_HPP
@@ -0,0 +1,50 @@
+#ifndef GIFCMD_PROGRESS_GAUGE_HPP
+#define GIFCMD_PROGRESS_GAUGE_HPP
+
+#include <atomic>
+#include <chrono>
+#include <ftxui/component/animation.hpp>
+#include <ftxui/component/component_base.hpp>
+#include <ftxui/dom/elements.hpp>
+
+// 进度条组件：工作线程只写入原始进度，插值在界面侧随动画帧完成
+// 必须挂在组件树中才能收到 OnAnimation
+class ProgressGauge : public ftxui::ComponentBase
+{
+public:
+    explicit ProgressGauge(const std::atomic<float> *target) : target_(target) {}
+
+    ftxui::Element Render() override
+    {
+        float target = target_->load(std::memory_order_relaxed);
+        // 新一轮运行（进度回退）时直接跳到目标值
+        if (target < displayed_)
+        {
+            displayed_ = target;
+            animator_ = ftxui::animation::Animator(&displayed_, target);
+            animated_target_ = target;
+        }
+        else if (target != animated_target_)
+        {
+            // 从当前显示值平滑过渡到新的目标值
+            animator_ = ftxui::animation::Animator(&displayed_, target, std::chrono::milliseconds(200),
+                                                   ftxui::animation::easing::QuadraticOut);
+            animated_target_ = target;
+            ftxui::animation::RequestAnimationFrame();
+        }
+        return ftxui::gauge(displayed_);
+    }
+
+    void OnAnimation(ftxui::animation::Params &params) override
+    {
+        animator_.OnAnimation(params);
+    }
+
+private:
+    const std::atomic<float> *target_;
+    float displayed_ = 0;
+    float animated_target_ = 0;
+    ftxui::animation::Animator animator_{&displayed_};
+};
+
+#endif // GIFCMD_PROGRESS_GAUGE_HPP
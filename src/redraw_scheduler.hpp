@@ -0,0 +1,84 @@
+#ifndef GIFCMD_REDRAW_SCHEDULER_HPP
+#define GIFCMD_REDRAW_SCHEDULER_HPP
+
+#include <atomic>
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+#include <ftxui/component/event.hpp>
+#include <ftxui/component/screen_interactive.hpp>
+
+// 合并界面刷新请求：任意线程调用 Notify()，每个刷新间隔内最多投递一次 Event::Custom
+class RedrawScheduler
+{
+public:
+    explicit RedrawScheduler(std::chrono::milliseconds interval = std::chrono::milliseconds(16))
+        : interval_(interval), thread_([this]
+                                       { Run(); }) {}
+
+    ~RedrawScheduler()
+    {
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            stop_ = true;
+        }
+        wake_.notify_one();
+        thread_.join();
+    }
+
+    RedrawScheduler(const RedrawScheduler &) = delete;
+    RedrawScheduler &operator=(const RedrawScheduler &) = delete;
+
+    // 请求刷新；已有待投递的刷新时只计数
+    void Notify()
+    {
+        updates_received_.fetch_add(1, std::memory_order_relaxed);
+        if (dirty_.exchange(true, std::memory_order_acq_rel))
+            return;
+        std::lock_guard<std::mutex> lock(mutex_);
+        wake_.notify_one();
+    }
+
+    // 在渲染函数中调用，统计实际渲染的帧数
+    void OnFrameRendered() { frames_rendered_.fetch_add(1, std::memory_order_relaxed); }
+
+    uint64_t UpdatesReceived() const { return updates_received_.load(std::memory_order_relaxed); }
+    uint64_t FramesRendered() const { return frames_rendered_.load(std::memory_order_relaxed); }
+
+private:
+    void Run()
+    {
+        auto last_post = std::chrono::steady_clock::now() - interval_;
+        std::unique_lock<std::mutex> lock(mutex_);
+        while (!stop_)
+        {
+            wake_.wait(lock, [this]
+                       { return stop_ || dirty_.load(std::memory_order_acquire); });
+            if (stop_)
+                break;
+
+            // 距上次投递不足一个间隔则等待，期间到达的请求都会合并到这一帧
+            if (wake_.wait_until(lock, last_post + interval_, [this]
+                                 { return stop_; }))
+                break;
+
+            dirty_.store(false, std::memory_order_release);
+            last_post = std::chrono::steady_clock::now();
+            if (auto *screen = ftxui::ScreenInteractive::Active())
+                screen->PostEvent(ftxui::Event::Custom);
+        }
+    }
+
+    std::chrono::milliseconds interval_;
+    std::mutex mutex_;
+    std::condition_variable wake_;
+    bool stop_ = false;
+    std::atomic<bool> dirty_{false};
+    std::atomic<uint64_t> updates_received_{0};
+    std::atomic<uint64_t> frames_rendered_{0};
+    std::thread thread_;
+};
+
+#endif // GIFCMD_REDRAW_SCHEDULER_HPP
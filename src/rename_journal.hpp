@@ -0,0 +1,286 @@
+#ifndef GIFCMD_RENAME_JOURNAL_HPP
+#define GIFCMD_RENAME_JOURNAL_HPP
+
+#include <cerrno>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <string_view>
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+
+// 重命名日志（二进制）：在重命名开始前写入并落盘，记录 临时文件名 -> 原始文件名
+// 格式：魔数"GCRJ" | 版本(u32) | 条目数(u32) | 条目...
+// 条目：临时名长度(u16) | 原始名长度(u16) | 临时名 | 原始名
+const char rename_journal_path[] = ".gifcmd_rename.journal";
+
+struct RenameJournalEntry
+{
+    std::string temp_name;     // 重命名后的临时文件名
+    std::string original_name; // 原始文件名
+};
+
+namespace rename_journal_detail
+{
+    const char magic[4] = {'G', 'C', 'R', 'J'};
+    const uint32_t version = 1;
+
+    inline void PutU16(std::string &out, uint16_t v)
+    {
+        out.push_back(static_cast<char>(v & 0xFF));
+        out.push_back(static_cast<char>(v >> 8));
+    }
+
+    inline void PutU32(std::string &out, uint32_t v)
+    {
+        for (int i = 0; i < 4; i++)
+            out.push_back(static_cast<char>((v >> (8 * i)) & 0xFF));
+    }
+
+    inline uint32_t GetLE(const unsigned char *p, int bytes)
+    {
+        uint32_t v = 0;
+        for (int i = 0; i < bytes; i++)
+            v |= static_cast<uint32_t>(p[i]) << (8 * i);
+        return v;
+    }
+
+    // 重命名但不覆盖已存在的目标：目标存在时失败，errno 为 EEXIST
+    // 文件系统不支持 RENAME_NOREPLACE 时改用 linkat + unlinkat（目标存在时同样原子地失败）
+    inline int RenameNoReplace(int dirfd, const char *from, const char *to)
+    {
+#ifdef RENAME_NOREPLACE
+        if (::renameat2(dirfd, from, dirfd, to, RENAME_NOREPLACE) == 0)
+            return 0;
+        if (errno != EINVAL && errno != ENOSYS)
+            return -1;
+#endif
+        if (::linkat(dirfd, from, dirfd, to, 0) != 0)
+            return -1;
+        return ::unlinkat(dirfd, from, 0);
+    }
+
+    // 写满整个缓冲区，处理EINTR和部分写入
+    inline bool WriteAll(int fd, const char *data, size_t size)
+    {
+        while (size > 0)
+        {
+            ssize_t n = ::write(fd, data, size);
+            if (n < 0)
+            {
+                if (errno == EINTR)
+                    continue;
+                return false;
+            }
+            data += n;
+            size -= static_cast<size_t>(n);
+        }
+        return true;
+    }
+}
+
+// 检查目录中是否残留重命名日志（上次运行未正常恢复）
+inline bool HasRenameJournal(int dirfd)
+{
+    struct stat st;
+    return ::fstatat(dirfd, rename_journal_path, &st, 0) == 0;
+}
+
+// 一次性写入全部条目，仅做一次fsync，再fsync目录确保日志文件本身可见
+inline bool WriteRenameJournal(int dirfd, const std::vector<RenameJournalEntry> &entries)
+{
+    using namespace rename_journal_detail;
+
+    std::string buffer(magic, sizeof(magic));
+    PutU32(buffer, version);
+    PutU32(buffer, static_cast<uint32_t>(entries.size()));
+    for (const auto &entry : entries)
+    {
+        if (entry.temp_name.size() > 0xFFFF || entry.original_name.size() > 0xFFFF)
+            return false;
+        PutU16(buffer, static_cast<uint16_t>(entry.temp_name.size()));
+        PutU16(buffer, static_cast<uint16_t>(entry.original_name.size()));
+        buffer += entry.temp_name;
+        buffer += entry.original_name;
+    }
+
+    int fd = ::openat(dirfd, rename_journal_path, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+    if (fd < 0)
+        return false;
+
+    bool ok = WriteAll(fd, buffer.data(), buffer.size()) && ::fsync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+    ok = ok && ::fsync(dirfd) == 0;
+    return ok;
+}
+
+// 读取日志全部条目；文件损坏或版本不符时返回false
+inline bool ReadRenameJournal(int dirfd, std::vector<RenameJournalEntry> &entries)
+{
+    using namespace rename_journal_detail;
+
+    entries.clear();
+    int fd = ::openat(dirfd, rename_journal_path, O_RDONLY | O_CLOEXEC);
+    if (fd < 0)
+        return false;
+
+    std::string data;
+    char chunk[65536];
+    ssize_t n;
+    while ((n = ::read(fd, chunk, sizeof(chunk))) != 0)
+    {
+        if (n < 0)
+        {
+            if (errno == EINTR)
+                continue;
+            ::close(fd);
+            return false;
+        }
+        data.append(chunk, static_cast<size_t>(n));
+    }
+    ::close(fd);
+
+    const unsigned char *p = reinterpret_cast<const unsigned char *>(data.data());
+    const unsigned char *end = p + data.size();
+    if (data.size() < 12 || std::memcmp(p, magic, sizeof(magic)) != 0 || GetLE(p + 4, 4) != version)
+        return false;
+
+    uint32_t count = GetLE(p + 8, 4);
+    p += 12;
+    entries.reserve(count);
+    for (uint32_t i = 0; i < count; i++)
+    {
+        if (end - p < 4)
+            return false;
+        size_t temp_len = GetLE(p, 2);
+        size_t orig_len = GetLE(p + 2, 2);
+        p += 4;
+        if (static_cast<size_t>(end - p) < temp_len + orig_len)
+            return false;
+
+        RenameJournalEntry entry;
+        entry.temp_name.assign(reinterpret_cast<const char *>(p), temp_len);
+        entry.original_name.assign(reinterpret_cast<const char *>(p + temp_len), orig_len);
+        p += temp_len + orig_len;
+        entries.push_back(std::move(entry));
+    }
+    return true;
+}
+
+// 调整条目顺序，使每次重命名的目标都不是尚未重命名的另一帧的原始名：
+// 目标被另一条目的原始名占用时，先排那个条目（帧号整体增大时即为倒序）
+// 调整后的顺序即执行顺序，按原样写入日志，倒序回放仍然成立
+// 条目互相占用成环（如两帧交换名字）时无法只靠文件名判断回放进度，返回false且不修改 entries
+inline bool OrderRenameJournal(std::vector<RenameJournalEntry> &entries)
+{
+    std::unordered_map<std::string_view, size_t> by_original;
+    by_original.reserve(entries.size());
+    for (size_t i = 0; i < entries.size(); i++)
+        by_original.emplace(entries[i].original_name, i);
+
+    // 条目 i 的目标被 blocker(i) 的原始名占用，blocker 必须先执行
+    auto blocker = [&](size_t i) -> size_t
+    {
+        if (entries[i].temp_name == entries[i].original_name)
+            return entries.size();
+        auto it = by_original.find(entries[i].temp_name);
+        return it == by_original.end() ? entries.size() : it->second;
+    };
+
+    std::vector<size_t> order;
+    order.reserve(entries.size());
+    std::vector<uint8_t> state(entries.size(), 0); // 0 未处理，1 在当前链上，2 已排入
+    std::vector<size_t> chain;
+    for (size_t start = 0; start < entries.size(); start++)
+    {
+        // 沿占用关系走到目标空闲（或占用者已排入）的条目，再倒序排入整条链
+        chain.clear();
+        size_t i = start;
+        while (i < entries.size() && state[i] == 0)
+        {
+            state[i] = 1;
+            chain.push_back(i);
+            i = blocker(i);
+        }
+        if (i < entries.size() && state[i] == 1)
+            return false;
+        for (auto it = chain.rbegin(); it != chain.rend(); ++it)
+        {
+            order.push_back(*it);
+            state[*it] = 2;
+        }
+    }
+
+    std::vector<RenameJournalEntry> ordered;
+    ordered.reserve(entries.size());
+    for (size_t i : order)
+        ordered.push_back(std::move(entries[i]));
+    entries = std::move(ordered);
+    return true;
+}
+
+// 按日志顺序重命名：原始名 -> 临时名；目标已存在时不覆盖（被覆盖的文件不在日志中，无法恢复）
+// 返回完成的条目数，小于条目总数时 entries[返回值] 失败，errno 为失败原因（EEXIST 表示目标已存在）
+inline size_t ApplyRenameJournal(int dirfd, const std::vector<RenameJournalEntry> &entries)
+{
+    for (size_t i = 0; i < entries.size(); i++)
+    {
+        const auto &entry = entries[i];
+        if (entry.original_name == entry.temp_name)
+            continue;
+        if (rename_journal_detail::RenameNoReplace(dirfd, entry.original_name.c_str(), entry.temp_name.c_str()) != 0)
+            return i;
+    }
+    return entries.size();
+}
+
+// 按日志的相反顺序线性回放：临时名 -> 原始名
+// 重命名按日志顺序进行且从不覆盖，倒序撤销到某个已完成的条目时，它之后占用其原始名的条目都已撤销，
+// 原始名必然空出；因此：
+//  - 临时文件不存在：该条目尚未执行，跳过
+//  - 原始名仍被占用且临时名是另一帧的原始名：该条目尚未执行，临时名上是那一帧的原始文件，跳过
+//  - 其余失败（包括原始名被日志以外的文件占用）写入 failed，不覆盖任何文件
+// 返回成功恢复的数量
+inline size_t ReplayRenameJournal(int dirfd, const std::vector<RenameJournalEntry> &entries,
+                                  std::vector<std::string> *failed = nullptr)
+{
+    std::unordered_set<std::string_view> originals;
+    originals.reserve(entries.size());
+    for (const auto &entry : entries)
+        originals.insert(entry.original_name);
+
+    size_t restored = 0;
+    for (auto it = entries.rbegin(); it != entries.rend(); ++it)
+    {
+        const auto &entry = *it;
+        if (entry.original_name == entry.temp_name)
+        {
+            restored++;
+            continue;
+        }
+        if (rename_journal_detail::RenameNoReplace(dirfd, entry.temp_name.c_str(), entry.original_name.c_str()) == 0)
+        {
+            restored++;
+        }
+        else if (errno != ENOENT && !(errno == EEXIST && originals.count(entry.temp_name)) && failed)
+        {
+            failed->push_back(entry.temp_name + " -> " + entry.original_name + ": " + std::strerror(errno));
+        }
+    }
+    ::fsync(dirfd);
+    return restored;
+}
+
+// 恢复完成后删除日志
+inline void RemoveRenameJournal(int dirfd)
+{
+    ::unlinkat(dirfd, rename_journal_path, 0);
+    ::fsync(dirfd);
+}
+
+#endif // GIFCMD_RENAME_JOURNAL_HPP
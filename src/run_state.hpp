@@ -0,0 +1,135 @@
+#ifndef GIFCMD_RUN_STATE_HPP
+#define GIFCMD_RUN_STATE_HPP
+
+#include <atomic>
+#include <functional>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <ftxui/component/receiver.hpp>
+#include "ffmpeg_process.hpp"
+#include "frame_pool.hpp"
+#include "settings_model.hpp"
+#include "stage_pipeline.hpp"
+
+// 一个编码任务：在 directory 中按 settings 生成GIF
+// 进度是高频数值，通过原子变量发布给界面的进度条，不经过 RunState
+struct EncodeJob
+{
+    int id = 0;
+    std::string directory;                           // 帧文件所在目录，ffmpeg在此目录中运行
+    bool watched = false;                            // 是否为监视线程正在监视的目录
+    std::shared_ptr<const EncodeSettings> settings;  // 提交时的设置快照
+    std::atomic<float> progress{0};                  // ffmpeg报告的原始进度（0.0 - 1.0）
+};
+
+// 一次运行的状态快照：工作线程持有自己的副本，修改后整体通过Sender发送给界面，
+// 界面线程只读取自己收到的最新副本，两边不共享任何字符串
+struct RunState
+{
+    int job_id = 0;
+    bool running = false;
+    bool finished = false;       // 本次运行已结束（succeeded 有效）
+    bool succeeded = false;
+    size_t total_frames = 0;
+    int stage = 0;               // 当前阶段（从1开始）
+    int stage_count = 1;         // 两遍编码时为2：生成调色板、编码
+    bool palette_cached = false; // 调色板来自缓存，跳过了第一遍
+    bool deduplicating = false;  // 正在检测重复帧（编码之前）
+    size_t dropped_frames = 0;   // 去重时合并掉的帧数
+    std::vector<StageLoad> stage_loads; // 进程内流水线各阶段的队列占用（不使用流水线时为空）
+    FramePoolStats pool_stats;   // 本任务期间帧缓冲池的命中/新分配次数，以及池的峰值占用
+    double elapsed_seconds = 0;  // 结束时的总耗时
+    std::string result_message;  // 运行结果或期间捕获的错误行
+    FFmpegProgress last_sample;  // 最近一次ffmpeg进度（帧、fps、速度等）
+};
+
+// 一个任务的状态副本及保护它的互斥锁：工作线程持锁修改 state 后调用 Publish，
+// 整份副本经所有任务共用的 Sender 发送，之后调用 notify（界面用来请求刷新，可以为空）
+struct RunStatePublisher
+{
+    RunStatePublisher(int job_id, ftxui::Sender<RunState> &sender, std::function<void()> notify = {})
+        : sender_(sender), notify_(std::move(notify))
+    {
+        state.job_id = job_id;
+    }
+
+    // 把状态副本发送给界面（多线程阶段须持有 mutex）
+    void Publish()
+    {
+        sender_->Send(state);
+        if (notify_)
+            notify_();
+    }
+
+    // 帧缓冲池的统计：命中/新分配次数取本任务开始以来的增量（多线程阶段须持有 mutex）
+    void UpdatePoolStats()
+    {
+        FramePoolStats now = FramePool::Default().Stats();
+        now.hits -= pool_start.hits;
+        now.misses -= pool_start.misses;
+        state.pool_stats = now;
+    }
+
+    RunState state;
+    std::mutex mutex;
+    FramePoolStats pool_start = FramePool::Default().Stats();
+
+private:
+    ftxui::Sender<RunState> &sender_;
+    std::function<void()> notify_;
+};
+
+// 任务行右侧的状态文字：阶段、帧进度与fps，结束后为结果和总耗时
+inline std::string FormatRunStatus(const RunState &st)
+{
+    std::ostringstream status;
+    status << std::fixed << std::setprecision(1);
+    if (st.finished)
+    {
+        status << (st.succeeded ? " 成功 " : " 失败 ") << st.elapsed_seconds << "s";
+    }
+    else if (st.running && st.deduplicating)
+    {
+        status << " [去重] " << st.last_sample.frame << "/" << st.total_frames;
+    }
+    else if (st.running && st.stage_count > 1 && st.stage == 1)
+    {
+        status << " [1/2 生成调色板] " << st.last_sample.frame << " 帧";
+    }
+    else if (st.running)
+    {
+        if (st.stage_count > 1)
+            status << (st.palette_cached ? " [2/2 编码，调色板已缓存]" : " [2/2 编码]");
+        status << " " << st.last_sample.frame << "/" << st.total_frames << "  " << st.last_sample.fps << " fps";
+    }
+    else
+    {
+        status << " 等待中";
+    }
+    if (st.dropped_frames > 0 && !st.deduplicating)
+        status << "  去重 -" << st.dropped_frames;
+    return status.str();
+}
+
+// 流水线各阶段：排队帧数/队列容量，忙碌线程数/线程数；排队接近容量的阶段是瓶颈
+// 帧缓冲池：复用/新分配次数，池的峰值占用；稳定运行时只有复用次数增长
+inline std::string FormatStageLoads(const RunState &st)
+{
+    std::string loads = "    队列";
+    for (const StageLoad &load : st.stage_loads)
+    {
+        loads += "  " + std::string(load.name) + " " + std::to_string(load.queued) + "/" +
+                 std::to_string(load.capacity) + " 忙" + std::to_string(load.busy) + "/" +
+                 std::to_string(load.threads);
+    }
+    loads += "  缓冲池 复用" + std::to_string(st.pool_stats.hits) + " 新分配" +
+             std::to_string(st.pool_stats.misses) + " 峰值" +
+             std::to_string(st.pool_stats.peak_bytes >> 20) + "MB";
+    return loads;
+}
+
+#endif // GIFCMD_RUN_STATE_HPP
@@ -0,0 +1,407 @@
+#ifndef GIFCMD_SETTINGS_MODEL_HPP
+#define GIFCMD_SETTINGS_MODEL_HPP
+
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <vector>
+#include "color_quantizer.hpp"
+#include "dither.hpp"
+#include "ffmpeg_process.hpp"
+#include "image_decode.hpp"
+
+const char concat_list_path[] = "frames.ffconcat";          // concat列表路径
+const char palette_list_path[] = ".gifcmd_palette.ffconcat"; // 生成调色板的帧列表
+const int max_segments = 64;                                 // 分段数上限
+const int max_stage_threads = 64;                            // 流水线每个阶段的线程数上限
+
+// 内置编码器的调色板范围：全部帧共用一个、每帧一个，或每个场景一个（场景切换处换调色板）
+enum class PaletteMode
+{
+    global,
+    per_frame,
+    per_scene,
+};
+
+// 界面上的选项名称，顺序与枚举值一致
+const std::vector<std::string> quantizer_names = {"中位切分", "八叉树", "K均值"};
+const std::vector<std::string> palette_mode_names = {"全局", "逐帧", "按场景"};
+const std::vector<std::string> dither_names = {"无", "Bayer", "蓝噪声", "Floyd-Steinberg", "Sierra"};
+// 可设置线程数的流水线阶段（并行解码模式只用到前三个）
+const std::vector<std::string> pipeline_stage_names = {"读取", "解码", "缩放", "量化", "压缩"};
+
+// 校验通过后的类型化设置；生成后不再修改，工作线程持有它的共享指针
+struct EncodeSettings
+{
+    std::string output_path;
+    int framerate = 0;
+    int width = 0;
+    int quality = 0;    // 0 表示未设置
+    int loop_count = 0; // 0 表示无限循环
+    std::string extension;
+    bool rename_free = false;
+    bool two_pass = false; // 两遍编码：先生成调色板，再用 paletteuse 编码
+    bool native_encoder = false; // 内置编码器（仅当帧格式可在进程内解码时生效）
+    int segments = 1;      // 并行分段数（1 表示不分段）
+    bool decode_pipe = false; // 进程内并行解码，原始帧经管道送入ffmpeg
+    int palette_colors = 0;   // 内置编码器的调色板颜色数，0 表示按质量参数换算
+    QuantizeAlgorithm quantizer = QuantizeAlgorithm::median_cut;
+    PaletteMode palette_mode = PaletteMode::global;
+    DitherMethod dither = DitherMethod::none; // 内置编码器映射颜色时的抖动方式
+    bool frame_delta = false; // 帧间差分：只写出变化区域，未变化的像素透明（ffmpeg输出时作为后处理）
+    bool dedup = false;       // 编码前去除连续的重复帧，时长合并到保留的帧
+    int dedup_threshold = 0;  // 近似重复的阈值（缩略图亮度差，0 表示只去除完全相同的帧）
+    size_t memory_budget = 256u << 20; // 进程内流水线中帧缓冲的内存上限（字节）
+    std::vector<int> stage_threads;    // 各流水线阶段的线程数（顺序同 pipeline_stage_names），为空时自动
+    bool huge_pages = false;           // 帧缓冲池的大缓冲区使用透明大页
+
+    std::vector<std::string> command_args; // 单遍编码时直接传给posix_spawn的参数
+    std::string command_display;           // 用于显示的命令行
+
+    // 分段编码同样需要先生成全局调色板
+    bool UsesPalette() const { return two_pass || segments > 1; }
+
+    // 第k个流水线阶段的线程数：未设置时读取用一个线程，其余阶段用 workers 个
+    size_t StageThreads(size_t k, size_t workers) const
+    {
+        if (k < stage_threads.size())
+            return static_cast<size_t>(stage_threads[k]);
+        return k == 0 ? 1 : std::max<size_t>(1, workers);
+    }
+
+    // 并行解码只用于不分段的ffmpeg编码，且帧格式可在进程内解码
+    bool UsesDecodePipe() const
+    {
+        return decode_pipe && !native_encoder && segments == 1 && CanDecodeNatively(extension);
+    }
+};
+
+// 内置编码器：质量参数映射为调色板颜色数，未设置为256色，1-31 每级减少8色（最少16色）
+inline int NativePaletteSize(int quality)
+{
+    if (quality <= 0)
+        return 256;
+    return std::max(16, 256 - (quality - 1) * 8);
+}
+
+// 内置编码器实际使用的颜色数：设置了颜色数时优先使用；帧间差分需要在调色板中留一个透明色
+inline int NativePaletteSize(const EncodeSettings &s)
+{
+    int colors = s.palette_colors > 0 ? s.palette_colors : NativePaletteSize(s.quality);
+    return s.frame_delta ? std::min(colors, 255) : colors;
+}
+
+// 分段k的concat列表和输出文件（位于任务目录中）
+inline std::string SegmentListPath(size_t k) { return ".gifcmd_segment_" + std::to_string(k) + ".ffconcat"; }
+inline std::string SegmentOutputPath(size_t k) { return ".gifcmd_segment_" + std::to_string(k) + ".gif"; }
+
+// 第一遍：由帧列表生成调色板写入 palette
+// 缩放结果同时送往null输出，使 -progress 的帧数反映已处理的输入帧（palettegen只在结束时输出一帧）
+inline std::vector<std::string> PaletteCommandArgs(const EncodeSettings &s, const std::string &palette)
+{
+    return {"ffmpeg", "-hide_banner", "-loglevel", "info", "-nostats", "-progress", "pipe:1",
+            "-f", "concat", "-safe", "0", "-i", palette_list_path,
+            "-filter_complex", "scale=" + std::to_string(s.width) + ":-1,split[n][p];[p]palettegen[palette]",
+            "-map", "[n]", "-f", "null", "-",
+            "-map", "[palette]", "-y", palette};
+}
+
+// 编码命令的滤镜和输出部分：palette 为空时按宽度缩放，否则缩放后使用该调色板（paletteuse，调色板为第二个输入）
+// scale 为false时输入已是目标尺寸，不再缩放
+inline void AppendEncodeOutputArgs(std::vector<std::string> &args, const EncodeSettings &s, const std::string &palette,
+                                   const std::string &output_path, bool scale = true)
+{
+    std::string scale_filter = "scale=" + std::to_string(s.width) + ":-1";
+    if (palette.empty() && scale)
+    {
+        args.insert(args.end(), {"-vf", scale_filter});
+    }
+    else if (!palette.empty())
+    {
+        args.insert(args.end(), {"-i", palette, "-lavfi", (scale ? scale_filter + "[s];[s]" : "[0:v]") + "[1:v]paletteuse"});
+    }
+
+    // 添加质量参数
+    if (s.quality > 0)
+    {
+        args.insert(args.end(), {"-q:v", std::to_string(s.quality)});
+    }
+
+    // 添加循环参数
+    args.insert(args.end(), {"-loop", std::to_string(s.loop_count), "-y", output_path}); // 添加 -y 参数
+}
+
+// 并行解码模式的编码命令：stdin 为已缩放到 s.width x height 的 rgb24 原始帧序列，ffmpeg 只负责编码
+inline std::vector<std::string> RawVideoCommandArgs(const EncodeSettings &s, const std::string &palette, int height)
+{
+    std::vector<std::string> args = {"ffmpeg", "-hide_banner", "-loglevel", "info", "-nostats", "-progress", "pipe:1",
+                                     "-f", "rawvideo", "-pix_fmt", "rgb24",
+                                     "-s", std::to_string(s.width) + "x" + std::to_string(height),
+                                     "-framerate", std::to_string(s.framerate), "-i", "pipe:0"};
+    AppendEncodeOutputArgs(args, s, palette, s.output_path, false);
+    return args;
+}
+
+// 编码命令：palette 为空时单遍编码（ffmpeg默认调色板），否则使用该调色板（paletteuse）
+// count 为0时编码整个序列并写入输出路径；否则只编码第k段 [start, start + count) 并写入分段文件：
+// 重命名模式通过 -start_number 和 -frames:v 截取序列，免重命名模式使用该段自己的concat列表
+inline std::vector<std::string> EncodeCommandArgs(const EncodeSettings &s, const std::string &palette,
+                                                  size_t k = 0, size_t start = 0, size_t count = 0)
+{
+    std::vector<std::string> args = {"ffmpeg", "-hide_banner", "-loglevel", "info", "-nostats", "-progress", "pipe:1"};
+
+    // 输入部分：免重命名模式使用concat列表，否则使用重命名后的序列
+    if (s.rename_free)
+    {
+        args.insert(args.end(), {"-f", "concat", "-safe", "0", "-i", count > 0 ? SegmentListPath(k) : concat_list_path});
+    }
+    else if (count > 0)
+    {
+        args.insert(args.end(), {"-framerate", std::to_string(s.framerate), "-start_number", std::to_string(start + 1),
+                                 "-i", "image_%03d." + s.extension});
+    }
+    else
+    {
+        args.insert(args.end(), {"-framerate", std::to_string(s.framerate), "-i", "image_%03d." + s.extension});
+    }
+
+    if (!s.rename_free && count > 0)
+    {
+        args.insert(args.end(), {"-frames:v", std::to_string(count)});
+    }
+    AppendEncodeOutputArgs(args, s, palette, count > 0 ? SegmentOutputPath(k) : s.output_path);
+    return args;
+}
+
+// 检查字符串是否为有效整数（不抛异常）
+inline bool ParseIntSetting(const std::string &s, int &value)
+{
+    if (s.empty())
+        return false;
+    auto result = std::from_chars(s.data(), s.data() + s.size(), value);
+    return result.ec == std::errc() && result.ptr == s.data() + s.size();
+}
+
+// 解析以,分隔的各阶段线程数，个数须与 pipeline_stage_names 相同
+inline bool ParseStageThreads(const std::string &text, std::vector<int> &threads)
+{
+    threads.clear();
+    size_t start = 0;
+    while (start <= text.size())
+    {
+        size_t end = text.find(',', start);
+        if (end == std::string::npos)
+            end = text.size();
+        int value = 0;
+        if (!ParseIntSetting(text.substr(start, end - start), value) || value < 1 || value > max_stage_threads)
+            return false;
+        threads.push_back(value);
+        start = end + 1;
+    }
+    return threads.size() == pipeline_stage_names.size();
+}
+
+// 界面绑定的设置模型：输入框修改时调用 MarkDirty()，Refresh() 只在版本变化时重新校验和生成命令
+// 仅在界面线程使用
+class SettingsModel
+{
+public:
+    // 输入框绑定的原始文本
+    std::string output_path = "output.gif";
+    std::string framerate = "10";
+    std::string width = "320";
+    std::string quality = "";      // 质量参数（默认留空）
+    std::string loop_count = "0";  // 循环次数（0=无限）
+    std::string extension = "jpg"; // 文件后缀名
+    bool rename_free = false;      // 免重命名模式（通过concat列表输入）
+    bool two_pass = false;         // 两遍编码（palettegen + paletteuse）
+    bool native_encoder = false;   // 内置编码器（不调用ffmpeg）
+    std::string segments = "1";    // 并行分段数（1=不分段）
+    bool decode_pipe = false;      // 并行解码（原始帧经管道送入ffmpeg）
+    std::string palette_colors;    // 调色板颜色数（留空按质量换算）
+    int quantizer = 0;             // 量化算法（quantizer_names 的下标）
+    int palette_mode = 0;          // 调色板范围（palette_mode_names 的下标）
+    int dither = 0;                // 抖动方式（dither_names 的下标）
+    bool frame_delta = false;      // 帧间差分（只写变化区域）
+    bool dedup = false;            // 去除重复帧（合并时长）
+    std::string dedup_threshold = "0"; // 近似重复阈值（0=只去除完全相同的帧）
+    std::string memory_budget = "256"; // 流水线内存上限（MB）
+    std::string stage_threads;         // 各阶段线程数（以,分隔，留空自动）
+    bool huge_pages = false;           // 帧缓冲使用大页
+
+    void MarkDirty() { version_++; }
+    uint64_t version() const { return version_; }
+
+    // 设置有变化时重新校验并生成命令；返回是否重新生成
+    bool Refresh()
+    {
+        if (validated_version_ == version_)
+            return false;
+        validated_version_ = version_;
+        Rebuild();
+        return true;
+    }
+
+    const std::string &error_message() const { return error_message_; }
+    const std::string &command_display() const
+    {
+        static const std::string empty;
+        return snapshot_ ? snapshot_->command_display : empty;
+    }
+
+    // 当前设置的不可变快照；校验未通过时为空
+    std::shared_ptr<const EncodeSettings> Snapshot()
+    {
+        Refresh();
+        return snapshot_;
+    }
+
+private:
+    void Rebuild()
+    {
+        // 检查参数有效性
+        std::vector<std::string> errors;
+        auto settings = std::make_shared<EncodeSettings>();
+
+        // 帧率检查
+        if (!ParseIntSetting(framerate, settings->framerate) || settings->framerate <= 0)
+        {
+            errors.push_back("帧率必须为正整数");
+        }
+
+        // 宽度检查
+        if (!ParseIntSetting(width, settings->width) || settings->width <= 0)
+        {
+            errors.push_back("宽度必须为正整数");
+        }
+
+        // 质量检查（可选参数）
+        if (!quality.empty() && (!ParseIntSetting(quality, settings->quality) || settings->quality < 1 || settings->quality > 31))
+        {
+            errors.push_back("质量参数应为1-31（值越小质量越高）");
+        }
+
+        // 循环次数检查
+        if (!ParseIntSetting(loop_count, settings->loop_count) || settings->loop_count < 0)
+        {
+            errors.push_back("循环次数必须为非负整数（0=无限循环）");
+        }
+
+        // 分段数检查
+        if (!ParseIntSetting(segments, settings->segments) || settings->segments < 1 || settings->segments > max_segments)
+        {
+            errors.push_back("分段数应为1-" + std::to_string(max_segments) + "（1=不分段）");
+        }
+
+        // 调色板颜色数检查（可选参数）
+        if (!palette_colors.empty() &&
+            (!ParseIntSetting(palette_colors, settings->palette_colors) || settings->palette_colors < 2 || settings->palette_colors > 256))
+        {
+            errors.push_back("调色板颜色数应为2-256");
+        }
+
+        // 近似重复阈值检查
+        if (!ParseIntSetting(dedup_threshold, settings->dedup_threshold) || settings->dedup_threshold < 0 ||
+            settings->dedup_threshold > 255)
+        {
+            errors.push_back("近似重复阈值应为0-255（0=只去除完全相同的帧）");
+        }
+
+        // 内存上限检查
+        int budget_mb = 0;
+        if (!ParseIntSetting(memory_budget, budget_mb) || budget_mb < 16 || budget_mb > 65536)
+        {
+            errors.push_back("内存上限应为16-65536 MB");
+        }
+        settings->memory_budget = static_cast<size_t>(budget_mb) << 20;
+
+        // 各阶段线程数检查（可选参数）
+        if (!stage_threads.empty() && !ParseStageThreads(stage_threads, settings->stage_threads))
+        {
+            errors.push_back("阶段线程数应为 " + std::to_string(pipeline_stage_names.size()) +
+                             " 个以,分隔的1-" + std::to_string(max_stage_threads) + "的整数（读取,解码,缩放,量化,压缩）");
+        }
+
+        // 合并错误信息
+        error_message_.clear();
+        snapshot_.reset();
+        if (!errors.empty())
+        {
+            error_message_ = "错误：";
+            for (const auto &err : errors)
+            {
+                error_message_ += "\n  • " + err;
+            }
+            return;
+        }
+
+        settings->output_path = output_path;
+        settings->extension = extension;
+        settings->rename_free = rename_free;
+        settings->two_pass = two_pass;
+        settings->native_encoder = native_encoder;
+        settings->decode_pipe = decode_pipe;
+        settings->quantizer = static_cast<QuantizeAlgorithm>(quantizer);
+        settings->palette_mode = static_cast<PaletteMode>(palette_mode);
+        settings->dither = static_cast<DitherMethod>(dither);
+        settings->frame_delta = frame_delta;
+        settings->dedup = dedup;
+        settings->huge_pages = huge_pages;
+        BuildCommand(*settings);
+        snapshot_ = std::move(settings);
+    }
+
+    // 生成FFmpeg命令
+    static void BuildCommand(EncodeSettings &s)
+    {
+        s.command_args = EncodeCommandArgs(s, "");
+        if (s.native_encoder && CanDecodeNatively(s.extension))
+        {
+            s.command_display = "内置编码器：解码 ." + s.extension + " → " + (s.dedup ? "去除重复帧 → " : "") + "缩放到宽 " + std::to_string(s.width) +
+                                " → " + std::to_string(NativePaletteSize(s)) + " 色" +
+                                palette_mode_names[static_cast<int>(s.palette_mode)] + "调色板（" +
+                                quantizer_names[static_cast<int>(s.quantizer)] + "）→ " +
+                                (s.dither == DitherMethod::none ? "" : dither_names[static_cast<int>(s.dither)] + "抖动 → ") +
+                                (s.frame_delta ? "帧间差分 → " : "") + "并行LZW压缩 → " + s.output_path +
+                                "\n（分阶段流水线，帧缓冲上限 " + std::to_string(s.memory_budget >> 20) + " MB" +
+                                (s.huge_pages ? "，大页" : "") + "）";
+            return;
+        }
+        // 并行解码时输出高度取决于第一帧，显示时用占位符
+        auto encode_display = [&s](const std::string &palette)
+        {
+            if (!s.UsesDecodePipe())
+                return JoinCommandLine(EncodeCommandArgs(s, palette));
+            std::string size = std::to_string(s.width) + "x0";
+            std::string line = JoinCommandLine(RawVideoCommandArgs(s, palette, 0));
+            line.replace(line.find(size), size.size(), std::to_string(s.width) + "x<高>");
+            return "并行解码并缩放 ." + s.extension + "（帧缓冲上限 " + std::to_string(s.memory_budget >> 20) + " MB" +
+                   (s.huge_pages ? "，大页" : "") + "）| " + line;
+        };
+        const std::string post_pass = std::string(s.dedup ? "\n（编码前去除重复帧，有重复时改用带时长的concat列表输入）" : "") +
+                                      (s.frame_delta ? "\n（完成后做帧间差分后处理）" : "");
+        if (!s.UsesPalette())
+        {
+            s.command_display = encode_display("") + post_pass;
+            return;
+        }
+
+        // 调色板模式：显示两遍的命令，调色板位于以内容散列命名的缓存中
+        std::string palette = ".gifcmd_palettes/<散列>.png";
+        s.command_display = JoinCommandLine(PaletteCommandArgs(s, palette)) + "\n" + encode_display(palette);
+        if (s.segments > 1)
+        {
+            s.command_display += "\n（分 " + std::to_string(s.segments) + " 段并行编码后拼接）";
+        }
+        s.command_display += post_pass;
+    }
+
+    uint64_t version_ = 1;
+    uint64_t validated_version_ = 0;
+    std::string error_message_;
+    std::shared_ptr<const EncodeSettings> snapshot_;
+};
+
+#endif // GIFCMD_SETTINGS_MODEL_HPP
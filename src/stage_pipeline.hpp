@@ -0,0 +1,349 @@
+#ifndef GIFCMD_STAGE_PIPELINE_HPP
+#define GIFCMD_STAGE_PIPELINE_HPP
+
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <cstdint>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// 有界无锁环形队列（Vyukov的多生产者多消费者算法，单生产者/单消费者时同样适用）
+// 每个格子的序号表示它可写（等于写位置）还是可读（等于写位置+1）；Push/Pop 在满或空时才加锁等待，
+// 成功的一方看到有等待者时才加锁通知
+template <class T>
+class BoundedQueue
+{
+public:
+    explicit BoundedQueue(size_t capacity) : capacity_(std::max<size_t>(1, capacity)), cells_(new Cell[capacity_])
+    {
+        for (size_t i = 0; i < capacity_; i++)
+            cells_[i].sequence.store(i, std::memory_order_relaxed);
+    }
+
+    // 不等待：满时返回false
+    bool TryPush(const T &value)
+    {
+        size_t position = tail_.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &cells_[position % capacity_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position);
+            if (diff == 0)
+            {
+                if (tail_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = tail_.load(std::memory_order_relaxed);
+            }
+        }
+        cell->value = value;
+        cell->sequence.store(position + 1, std::memory_order_release);
+        return true;
+    }
+
+    // 不等待：空时返回false
+    bool TryPop(T &value)
+    {
+        size_t position = head_.load(std::memory_order_relaxed);
+        Cell *cell;
+        for (;;)
+        {
+            cell = &cells_[position % capacity_];
+            size_t sequence = cell->sequence.load(std::memory_order_acquire);
+            intptr_t diff = static_cast<intptr_t>(sequence) - static_cast<intptr_t>(position + 1);
+            if (diff == 0)
+            {
+                if (head_.compare_exchange_weak(position, position + 1, std::memory_order_relaxed))
+                    break;
+            }
+            else if (diff < 0)
+            {
+                return false;
+            }
+            else
+            {
+                position = head_.load(std::memory_order_relaxed);
+            }
+        }
+        value = cell->value;
+        cell->sequence.store(position + capacity_, std::memory_order_release);
+        return true;
+    }
+
+    // 满时等待；已关闭时返回false
+    bool Push(const T &value)
+    {
+        bool pushed = false;
+        Wait([&]
+             { return closed_.load(std::memory_order_acquire) || (pushed = TryPush(value)); });
+        if (pushed)
+            Notify();
+        return pushed;
+    }
+
+    // 空时等待；已关闭且为空时返回false
+    bool Pop(T &value)
+    {
+        bool popped = false;
+        Wait([&]
+             { return (popped = TryPop(value)) || closed_.load(std::memory_order_acquire); });
+        if (popped)
+            Notify();
+        return popped;
+    }
+
+    // 关闭队列并唤醒所有等待者：之后 Push 失败，Pop 取完剩余元素后失败
+    void Close()
+    {
+        std::lock_guard<std::mutex> lock(mutex_);
+        closed_.store(true, std::memory_order_release);
+        changed_.notify_all();
+    }
+
+    // 当前元素数（并发修改时为近似值）
+    size_t size() const
+    {
+        size_t head = head_.load(std::memory_order_relaxed);
+        size_t tail = tail_.load(std::memory_order_relaxed);
+        return tail > head ? std::min(tail - head, capacity_) : 0;
+    }
+    size_t capacity() const { return capacity_; }
+
+private:
+    struct alignas(64) Cell
+    {
+        std::atomic<size_t> sequence{0};
+        T value{};
+    };
+
+    // 先尝试一次，不成功再登记为等待者并在锁内重试
+    // 登记和 Notify 的检查都是对 waiters_ 的读改写，总能读到最新值：Notify 读到0时，
+    // 登记在它之后并与它同步，登记后的重试一定能看到这次成功的 Push/Pop，不会漏掉通知
+    template <class Ready>
+    void Wait(Ready ready)
+    {
+        if (ready())
+            return;
+        waiters_.fetch_add(1);
+        {
+            std::unique_lock<std::mutex> lock(mutex_);
+            changed_.wait(lock, ready);
+        }
+        waiters_.fetch_sub(1);
+    }
+
+    void Notify()
+    {
+        if (waiters_.fetch_add(0) > 0)
+        {
+            std::lock_guard<std::mutex> lock(mutex_);
+            changed_.notify_all();
+        }
+    }
+
+    const size_t capacity_;
+    std::unique_ptr<Cell[]> cells_;
+    alignas(64) std::atomic<size_t> head_{0}; // 下一个读取的位置
+    alignas(64) std::atomic<size_t> tail_{0}; // 下一个写入的位置
+    alignas(64) std::atomic<int> waiters_{0};
+    std::atomic<bool> closed_{false};
+    std::mutex mutex_;
+    std::condition_variable changed_;
+};
+
+// 一个阶段的负载快照：queued 为排队等待该阶段的帧数，busy 为正在处理的线程数
+// 排队数长期接近容量的阶段即瓶颈
+struct StageLoad
+{
+    const char *name = "";
+    size_t queued = 0;
+    size_t capacity = 0;
+    size_t busy = 0;
+    size_t threads = 0;
+};
+
+// 分阶段流水线：帧依次经过各阶段，每个阶段有自己的线程数，阶段之间用 BoundedQueue 连接；
+// 最后由调用线程按帧序号顺序执行 sink（写出）
+//  - 同时在流水线中的帧最多 in_flight 个：帧对象（及其中的缓冲区）预先分配，循环使用，
+//    空闲帧队列为空时不再放入新帧，内存占用由 in_flight 决定，与帧数无关
+//  - 各队列的容量都等于 in_flight，阶段线程放入下一队列时不会阻塞，阻塞只发生在取空闲帧处，
+//    因此阶段内部可以等待前面的帧（如帧间差分等待上一帧的映射结果）而不会死锁
+//  - 任一阶段或 sink 返回false时关闭所有队列，各线程尽快退出，Run 返回false；
+//    阶段内部若会等待其他帧，须在失败时自行唤醒
+template <class Item>
+class StagePipeline
+{
+public:
+    using Work = std::function<bool(size_t, Item &)>;
+
+    // 按顺序添加阶段：name 须为静态字符串，threads 至少为1
+    void AddStage(const char *name, size_t threads, Work work)
+    {
+        auto stage = std::make_unique<Stage>();
+        stage->name = name;
+        stage->threads = std::max<size_t>(1, threads);
+        stage->work = std::move(work);
+        stages_.push_back(std::move(stage));
+    }
+
+    // 处理 count 帧；sink 的名称只用于负载快照
+    bool Run(size_t count, size_t in_flight, const char *sink_name, Work sink)
+    {
+        if (count == 0)
+            return true;
+        in_flight = std::clamp<size_t>(in_flight, 1, count);
+        sink_name_ = sink_name;
+        failed_ = false;
+
+        std::vector<Token> tokens(in_flight);
+        free_ = std::make_unique<BoundedQueue<Token *>>(in_flight);
+        for (auto &token : tokens)
+            free_->TryPush(&token);
+        for (auto &stage : stages_)
+        {
+            stage->input = std::make_unique<BoundedQueue<Token *>>(in_flight);
+            stage->busy = 0;
+            stage->remaining = stage->threads;
+        }
+        output_ = std::make_unique<BoundedQueue<Token *>>(in_flight);
+        auto next_queue = [&](size_t k)
+        { return k + 1 < stages_.size() ? stages_[k + 1]->input.get() : output_.get(); };
+
+        // 放入帧：按序号顺序取空闲帧（没有时等待写出释放），放入第一个阶段
+        std::vector<std::thread> threads;
+        threads.emplace_back([&]
+                             {
+            BoundedQueue<Token *> *first = stages_.empty() ? output_.get() : stages_[0]->input.get();
+            for (size_t i = 0; i < count && !failed_; i++) {
+                Token *token;
+                if (!free_->Pop(token))
+                    break;
+                token->index = i;
+                if (!first->Push(token))
+                    break;
+            }
+            first->Close(); });
+
+        // 各阶段的线程：最后一个退出的线程关闭下一阶段的队列
+        for (size_t k = 0; k < stages_.size(); k++)
+        {
+            for (size_t t = 0; t < stages_[k]->threads; t++)
+            {
+                threads.emplace_back([&, k]
+                                     {
+                    Stage &stage = *stages_[k];
+                    BoundedQueue<Token *> *next = next_queue(k);
+                    Token *token;
+                    while (!failed_ && stage.input->Pop(token)) {
+                        stage.busy++;
+                        bool ok = stage.work(token->index, token->item);
+                        stage.busy--;
+                        if (!ok) {
+                            Abort();
+                            break;
+                        }
+                        next->Push(token);
+                    }
+                    if (--stage.remaining == 0)
+                        next->Close(); });
+            }
+        }
+
+        // 写出：乱序到达的帧按序号放入重排表（在流水线中的帧序号都在 [written, written + in_flight) 内）
+        std::vector<Token *> pending(in_flight, nullptr);
+        size_t written = 0;
+        while (written < count && !failed_)
+        {
+            Token *token = pending[written % in_flight];
+            if (!token)
+            {
+                if (!output_->Pop(token))
+                    break;
+                pending[token->index % in_flight] = token;
+                continue;
+            }
+            pending[written % in_flight] = nullptr;
+            if (!sink(written, token->item))
+            {
+                Abort();
+                break;
+            }
+            written++;
+            free_->Push(token);
+        }
+        if (written < count)
+            Abort();
+
+        for (auto &thread : threads)
+            thread.join();
+        return !failed_;
+    }
+
+    // 各阶段（最后为写出）的负载；只在 Run 期间有意义，可在 sink 中调用
+    void Loads(std::vector<StageLoad> &loads) const
+    {
+        loads.resize(stages_.size() + 1);
+        for (size_t k = 0; k < stages_.size(); k++)
+        {
+            const Stage &stage = *stages_[k];
+            loads[k].name = stage.name;
+            loads[k].queued = stage.input ? stage.input->size() : 0;
+            loads[k].capacity = stage.input ? stage.input->capacity() : 0;
+            loads[k].busy = stage.busy;
+            loads[k].threads = stage.threads;
+        }
+        StageLoad &sink = loads.back();
+        sink.name = sink_name_;
+        sink.queued = output_ ? output_->size() : 0;
+        sink.capacity = output_ ? output_->capacity() : 0;
+        sink.busy = 1;
+        sink.threads = 1;
+    }
+
+private:
+    struct Token
+    {
+        size_t index = 0;
+        Item item;
+    };
+
+    struct Stage
+    {
+        const char *name = "";
+        size_t threads = 1;
+        Work work;
+        std::unique_ptr<BoundedQueue<Token *>> input;
+        std::atomic<size_t> busy{0};
+        std::atomic<size_t> remaining{0};
+    };
+
+    void Abort()
+    {
+        failed_ = true;
+        free_->Close();
+        for (auto &stage : stages_)
+            stage->input->Close();
+        output_->Close();
+    }
+
+    std::vector<std::unique_ptr<Stage>> stages_;
+    std::unique_ptr<BoundedQueue<Token *>> free_;
+    std::unique_ptr<BoundedQueue<Token *>> output_;
+    const char *sink_name_ = "";
+    std::atomic<bool> failed_{false};
+};
+
+#endif // GIFCMD_STAGE_PIPELINE_HPP
@@ -0,0 +1,54 @@
+#include <cstring>
+#include "color_quantizer.hpp"
+#include "synthetic_image.hpp"
+#include "test_util.hpp"
+
+// 颜色量化：各SIMD级别统计的直方图相同；各算法的调色板不超过指定颜色数；颜色数不多于上限时每种颜色都保留
+
+int main()
+{
+    RgbImage frame;
+    CHECK(FillSyntheticFrame(frame, 333, 171, 2));
+
+    ColorHistogram scalar;
+    scalar.Add(frame, SimdLevel::scalar);
+    CHECK(scalar.total() == 333u * 171u);
+    for (SimdLevel level : {SimdLevel::sse41, SimdLevel::avx2})
+    {
+        if (level > DetectSimdLevel())
+            continue;
+        ColorHistogram simd;
+        simd.Add(frame, level);
+        CHECK(simd.counts() == scalar.counts());
+    }
+
+    // 只有4种颜色（都在桶中心）：任何算法都应原样得到这4种颜色
+    RgbImage four;
+    CHECK(four.Resize(40, 10));
+    const uint8_t colors[4][3] = {{4, 4, 4}, {252, 4, 4}, {4, 252, 132}, {124, 124, 252}};
+    for (int y = 0; y < four.height; y++)
+        for (int x = 0; x < four.width; x++)
+            std::memcpy(four.Row(y) + x * 3, colors[(x / 10 + y) % 4], 3);
+    ColorHistogram small;
+    small.Add(four);
+
+    for (QuantizeAlgorithm algorithm : {QuantizeAlgorithm::median_cut, QuantizeAlgorithm::octree, QuantizeAlgorithm::kmeans})
+    {
+        for (int max_colors : {2, 16, 64, 256})
+        {
+            Palette palette = Quantize(scalar, max_colors, algorithm);
+            CHECK(palette.size >= 1 && palette.size <= max_colors);
+        }
+
+        Palette palette = Quantize(small, 16, algorithm);
+        CHECK(palette.size == 4);
+        for (const auto &color : colors)
+        {
+            bool found = false;
+            for (int i = 0; i < palette.size; i++)
+                found = found || std::memcmp(palette.colors[i], color, 3) == 0;
+            CHECK(found);
+        }
+    }
+    return TestResult();
+}
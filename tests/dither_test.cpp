@@ -0,0 +1,55 @@
+#include <vector>
+#include "color_quantizer.hpp"
+#include "dither.hpp"
+#include "palette_mapper.hpp"
+#include "synthetic_image.hpp"
+#include "test_util.hpp"
+
+// 抖动：任意线程数（误差扩散为波前并行）的结果与单线程逐字节相同，有序抖动的SIMD内核与标量相同；
+// 图像中只有调色板颜色时误差扩散不产生误差，结果与直接映射相同
+
+int main()
+{
+    RgbImage frame;
+    CHECK(FillSyntheticFrame(frame, 257, 131, 6));
+    ColorHistogram histogram;
+    histogram.Add(frame);
+    const Palette palette = Quantize(histogram, 32, QuantizeAlgorithm::median_cut);
+    PaletteMapper mapper(palette);
+
+    const DitherMethod methods[] = {DitherMethod::none, DitherMethod::bayer, DitherMethod::blue_noise,
+                                    DitherMethod::floyd_steinberg, DitherMethod::sierra};
+    std::vector<uint8_t> single, parallel;
+    for (DitherMethod method : methods)
+    {
+        DitherImage(frame, mapper, method, single, 1, SimdLevel::scalar);
+        for (size_t threads : {1, 2, 3, 4, 7, 300})
+        {
+            DitherImage(frame, mapper, method, parallel, threads);
+            CHECK(parallel == single);
+        }
+        for (SimdLevel level : {SimdLevel::sse41, SimdLevel::avx2})
+        {
+            if (level > DetectSimdLevel())
+                continue;
+            DitherImage(frame, mapper, method, parallel, 2, level);
+            CHECK(parallel == single);
+        }
+    }
+
+    // 只含调色板颜色的图像
+    RgbImage exact;
+    CHECK(exact.Resize(97, 41));
+    for (int y = 0; y < exact.height; y++)
+        for (int x = 0; x < exact.width; x++)
+            for (int c = 0; c < 3; c++)
+                exact.Row(y)[x * 3 + c] = palette.colors[(x / 5 + y / 3) % palette.size][c];
+    std::vector<uint8_t> mapped;
+    mapper.Map(exact, mapped);
+    for (DitherMethod method : {DitherMethod::floyd_steinberg, DitherMethod::sierra})
+    {
+        DitherImage(exact, mapper, method, parallel, 3);
+        CHECK(parallel == mapped);
+    }
+    return TestResult();
+}
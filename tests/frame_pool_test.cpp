@@ -0,0 +1,70 @@
+#include <cstdint>
+#include <utility>
+#include "frame_pool.hpp"
+#include "test_util.hpp"
+
+// 帧缓冲池：同尺寸复用、行对齐、缓存上限淘汰，以及多个使用者登记要求时取最大的缓存上限
+
+int main()
+{
+    FramePool pool;
+    const size_t frame = FramePool::RowStride(100, PixelFormat::rgb24) * 50;
+    CHECK(FramePool::RowStride(100, PixelFormat::rgb24) == 320);
+
+    // 归还后同尺寸再申请时复用同一块缓冲区
+    uint8_t *first;
+    {
+        FramePool::Handle handle = pool.Acquire(100, 50, PixelFormat::rgb24);
+        CHECK(handle && handle.stride() == 320 && handle.bytes() == frame);
+        CHECK(reinterpret_cast<uintptr_t>(handle.data()) % frame_row_alignment == 0);
+        first = handle.data();
+    }
+    {
+        FramePool::Handle handle = pool.Acquire(100, 50, PixelFormat::rgb24);
+        CHECK(handle.data() == first);
+        FramePool::Handle moved = std::move(handle);
+        CHECK(!handle && moved.data() == first);
+    }
+    CHECK(pool.Stats().hits == 1 && pool.Stats().misses == 1);
+    CHECK(pool.Stats().live_bytes == 0 && pool.Stats().pooled_bytes == frame);
+    CHECK(!pool.Acquire(0, 10, PixelFormat::rgb24));
+
+    // 缓存上限：只能留一帧时，多归还的直接释放
+    pool.SetCacheLimit(frame);
+    {
+        FramePool::Handle a = pool.Acquire(100, 50, PixelFormat::rgb24);
+        FramePool::Handle b = pool.Acquire(100, 50, PixelFormat::rgb24);
+        FramePool::Handle c = pool.Acquire(100, 50, PixelFormat::rgb24);
+    }
+    CHECK(pool.Stats().pooled_bytes == frame);
+
+    // 登记的要求：生效的上限取最大的登记值，大页取任一登记；全部撤销后回到基础设置
+    CHECK(pool.CacheLimit() == frame && !pool.HugePages());
+    {
+        FramePool::Requirement small = pool.Require(2 * frame, false);
+        CHECK(pool.CacheLimit() == 2 * frame);
+        FramePool::Requirement large = pool.Require(8 * frame, true);
+        FramePool::Requirement medium = pool.Require(4 * frame, false);
+        CHECK(pool.CacheLimit() == 8 * frame && pool.HugePages());
+
+        // 后登记的较小要求不会压低先登记的较大要求
+        {
+            FramePool::Handle handles[6];
+            for (auto &handle : handles)
+                handle = pool.Acquire(100, 50, PixelFormat::rgb24);
+        }
+        CHECK(pool.Stats().pooled_bytes == 6 * frame);
+
+        large.Release();
+        CHECK(pool.CacheLimit() == 4 * frame && !pool.HugePages());
+        CHECK(pool.Stats().pooled_bytes == 4 * frame);
+        FramePool::Requirement moved = std::move(medium);
+        CHECK(pool.CacheLimit() == 4 * frame);
+    }
+    CHECK(pool.CacheLimit() == frame);
+    CHECK(pool.Stats().pooled_bytes == frame);
+
+    pool.Trim();
+    CHECK(pool.Stats().pooled_bytes == 0);
+    return TestResult();
+}
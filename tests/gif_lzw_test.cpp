@@ -0,0 +1,146 @@
+#include <cstdint>
+#include <map>
+#include <random>
+#include <vector>
+#include "gif_lzw.hpp"
+#include "test_util.hpp"
+
+// GIF LZW：编码后再解码必须逐字节还原；编码结果须与按定义实现的参考编码器逐字节相同
+// （包括码宽增长、4096个码用满后的清除码）
+
+namespace
+{
+    // 参考实现：std::map 码表，逐码按位写出，最后切分为255字节的子块
+    std::vector<uint8_t> ReferenceEncode(const std::vector<uint8_t> &indices, int min_code_size)
+    {
+        const uint32_t clear_code = 1u << min_code_size;
+        const uint32_t end_code = clear_code + 1;
+        std::vector<uint8_t> raw;
+        uint32_t bits = 0;
+        int bit_count = 0;
+        auto emit = [&](uint32_t code, int width)
+        {
+            bits |= code << bit_count;
+            bit_count += width;
+            while (bit_count >= 8)
+            {
+                raw.push_back(static_cast<uint8_t>(bits));
+                bits >>= 8;
+                bit_count -= 8;
+            }
+        };
+
+        std::map<std::pair<uint32_t, uint8_t>, uint32_t> table;
+        uint32_t next_code = end_code + 1;
+        int width = min_code_size + 1;
+        emit(clear_code, width);
+        if (!indices.empty())
+        {
+            uint32_t prefix = indices[0];
+            for (size_t i = 1; i < indices.size(); i++)
+            {
+                auto it = table.find({prefix, indices[i]});
+                if (it != table.end())
+                {
+                    prefix = it->second;
+                    continue;
+                }
+                emit(prefix, width);
+                if (next_code < 4096)
+                {
+                    table[{prefix, indices[i]}] = next_code;
+                    if (next_code == (1u << width) && width < 12)
+                        width++;
+                    next_code++;
+                }
+                else
+                {
+                    emit(clear_code, width);
+                    table.clear();
+                    next_code = end_code + 1;
+                    width = min_code_size + 1;
+                }
+                prefix = indices[i];
+            }
+            emit(prefix, width);
+        }
+        emit(end_code, width);
+        if (bit_count > 0)
+            raw.push_back(static_cast<uint8_t>(bits));
+
+        std::vector<uint8_t> out{static_cast<uint8_t>(min_code_size)};
+        for (size_t offset = 0; offset < raw.size(); offset += 255)
+        {
+            size_t length = std::min<size_t>(255, raw.size() - offset);
+            out.push_back(static_cast<uint8_t>(length));
+            out.insert(out.end(), raw.begin() + offset, raw.begin() + offset + length);
+        }
+        out.push_back(0);
+        return out;
+    }
+
+    enum class Pattern
+    {
+        random, // 均匀随机
+        runs,   // 长短不一的同色段
+        noise,  // 渐变加少量随机扰动，接近抖动后的图像
+    };
+
+    std::vector<uint8_t> MakeIndices(Pattern pattern, size_t count, int bits, uint32_t seed)
+    {
+        std::mt19937 rng(seed);
+        const uint32_t colors = 1u << bits;
+        std::vector<uint8_t> indices(count);
+        for (size_t i = 0; i < count; i++)
+        {
+            switch (pattern)
+            {
+            case Pattern::random:
+                indices[i] = static_cast<uint8_t>(rng() % colors);
+                break;
+            case Pattern::runs:
+                indices[i] = i > 0 && rng() % 64 != 0 ? indices[i - 1] : static_cast<uint8_t>(rng() % colors);
+                break;
+            case Pattern::noise:
+                indices[i] = static_cast<uint8_t>(((i / 97) + rng() % 3) % colors);
+                break;
+            }
+        }
+        return indices;
+    }
+
+    void CheckRoundTrip(GifLzwEncoder &encoder, GifLzwDecoder &decoder, const std::vector<uint8_t> &indices, int bits)
+    {
+        // GIF 的最小码长至少为2
+        const int min_code_size = std::max(2, bits);
+        std::vector<uint8_t> compressed;
+        encoder.Encode(indices.data(), indices.size(), min_code_size, compressed);
+        CHECK(compressed == ReferenceEncode(indices, min_code_size));
+
+        CHECK(compressed.size() >= 3 && compressed[0] == min_code_size && compressed.back() == 0);
+        std::vector<uint8_t> decoded(indices.size() + 1, 0xEE);
+        CHECK(decoder.Decode(compressed.data() + 1, compressed.size() - 1, min_code_size, decoded.data(), indices.size()));
+        CHECK(std::equal(indices.begin(), indices.end(), decoded.begin()));
+        CHECK(decoded.back() == 0xEE);
+    }
+}
+
+int main()
+{
+    // 同一对编码器/解码器重复使用，覆盖码表代数和缓冲区复用
+    GifLzwEncoder encoder;
+    GifLzwDecoder decoder;
+    uint32_t seed = 1;
+    for (int bits = 1; bits <= 8; bits++)
+    {
+        for (size_t count : {0, 1, 2, 3, 255, 4093, 4096, 70000, 300000})
+        {
+            for (Pattern pattern : {Pattern::random, Pattern::runs, Pattern::noise})
+                CheckRoundTrip(encoder, decoder, MakeIndices(pattern, count, bits, seed++), bits);
+        }
+    }
+
+    // 单一颜色：码串不断加长，码表在很长的输入后才用满
+    CheckRoundTrip(encoder, decoder, std::vector<uint8_t>(5000000, 7), 8);
+    return TestResult();
+}
@@ -0,0 +1,212 @@
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstring>
+#include <vector>
+#include "image_resize.hpp"
+#include "synthetic_image.hpp"
+#include "test_util.hpp"
+
+// 缩放：各SIMD级别与标量实现逐字节相同；与双精度的参考实现相比误差在定点量化的范围内；纯色保持不变
+
+namespace
+{
+    struct Size
+    {
+        int src_width, src_height, width, height;
+    };
+
+    // 覆盖：放大、小倍数缩小、需要区域平均预缩小的大倍数缩小、奇数宽度和单行/单列
+    const Size sizes[] = {
+        {320, 240, 640, 480}, {320, 240, 160, 120}, {1920, 1080, 480, 270}, {1920, 1080, 97, 55},
+        {333, 211, 250, 159}, {101, 77, 303, 231}, {640, 480, 641, 481},   {64, 1, 17, 1},
+        {1, 64, 1, 9},        {3, 3, 1, 1},
+    };
+
+    // 参考实现：区域平均和卷积都用 double 计算，不取整；几何关系（预缩小倍数、滤波中心和支撑）与 ResizeImage 相同，
+    // 水平方向的中间结果同样截断到 [0, 255]（Lanczos 在锐利边缘的过冲在两个方向之间不保留）
+    std::vector<double> ReferenceResize(const RgbImage &src, int width, int height, ResizeFilter filter)
+    {
+        using image_resize_detail::Lanczos3;
+        using image_resize_detail::Triangle;
+        const int kx = std::clamp(src.width / width / 2, 1, image_resize_detail::max_box_factor);
+        const int ky = std::clamp(src.height / height / 2, 1, image_resize_detail::max_box_factor);
+        const int in_width = (src.width + kx - 1) / kx, in_height = (src.height + ky - 1) / ky;
+        std::vector<double> input(static_cast<size_t>(in_width) * in_height * 3);
+        for (int by = 0; by < in_height; by++)
+            for (int bx = 0; bx < in_width; bx++)
+            {
+                const int y1 = std::min(src.height, by * ky + ky), x1 = std::min(src.width, bx * kx + kx);
+                for (int c = 0; c < 3; c++)
+                {
+                    double sum = 0;
+                    for (int y = by * ky; y < y1; y++)
+                        for (int x = bx * kx; x < x1; x++)
+                            sum += src.Row(y)[x * 3 + c];
+                    input[(static_cast<size_t>(by) * in_width + bx) * 3 + c] = sum / ((x1 - bx * kx) * (y1 - by * ky));
+                }
+            }
+
+        // 一个方向的归一化权重：weights[i] 为 (输入位置, 权重) 列表
+        auto weights = [&](int in_size, double in_extent, int out_size)
+        {
+            const double scale = in_extent / out_size;
+            const double filter_scale = std::max(1.0, scale);
+            const double support = (filter == ResizeFilter::lanczos ? 3.0 : 1.0) * filter_scale;
+            std::vector<std::vector<std::pair<int, double>>> result(out_size);
+            for (int i = 0; i < out_size; i++)
+            {
+                const double center = (i + 0.5) * scale;
+                const int lo = std::max(0, static_cast<int>(std::floor(center - support + 0.5)));
+                const int hi = std::min(in_size, static_cast<int>(std::floor(center + support + 0.5)));
+                double sum = 0;
+                for (int x = lo; x < hi; x++)
+                {
+                    const double t = (x + 0.5 - center) / filter_scale;
+                    const double value = filter == ResizeFilter::lanczos ? Lanczos3(t) : Triangle(t);
+                    result[i].push_back({x, value});
+                    sum += value;
+                }
+                if (sum == 0)
+                {
+                    result[i] = {{std::clamp(static_cast<int>(center), 0, in_size - 1), 1.0}};
+                    sum = 1;
+                }
+                for (auto &entry : result[i])
+                    entry.second /= sum;
+            }
+            return result;
+        };
+        const auto columns = weights(in_width, static_cast<double>(src.width) / kx, width);
+        const auto rows = weights(in_height, static_cast<double>(src.height) / ky, height);
+
+        std::vector<double> horizontal(static_cast<size_t>(width) * in_height * 3, 0.0);
+        for (int y = 0; y < in_height; y++)
+            for (int x = 0; x < width; x++)
+                for (const auto &[ix, w] : columns[x])
+                    for (int c = 0; c < 3; c++)
+                        horizontal[(static_cast<size_t>(y) * width + x) * 3 + c] +=
+                            w * input[(static_cast<size_t>(y) * in_width + ix) * 3 + c];
+        for (double &value : horizontal)
+            value = std::clamp(value, 0.0, 255.0);
+
+        std::vector<double> out(static_cast<size_t>(width) * height * 3, 0.0);
+        for (int y = 0; y < height; y++)
+            for (const auto &[iy, w] : rows[y])
+                for (size_t i = 0; i < static_cast<size_t>(width) * 3; i++)
+                    out[static_cast<size_t>(y) * width * 3 + i] += w * horizontal[static_cast<size_t>(iy) * width * 3 + i];
+        for (double &value : out)
+            value = std::clamp(value, 0.0, 255.0);
+        return out;
+    }
+
+    bool SameImage(const RgbImage &a, const RgbImage &b)
+    {
+        if (a.width != b.width || a.height != b.height)
+            return false;
+        for (int y = 0; y < a.height; y++)
+            if (std::memcmp(a.Row(y), b.Row(y), static_cast<size_t>(a.width) * 3) != 0)
+                return false;
+        return true;
+    }
+
+    void TestSimdLevels()
+    {
+        const SimdLevel best = DetectSimdLevel();
+        std::printf("SIMD: %s\n", best == SimdLevel::avx2 ? "avx2" : best == SimdLevel::sse41 ? "sse4.1" : "scalar");
+        RgbImage src, scalar, simd;
+        for (const Size &size : sizes)
+        {
+            CHECK(FillSyntheticFrame(src, size.src_width, size.src_height, 3));
+            for (ResizeFilter filter : {ResizeFilter::lanczos, ResizeFilter::bilinear})
+            {
+                CHECK(ResizeImage(src, size.width, size.height, scalar, filter, SimdLevel::scalar));
+                for (SimdLevel level : {SimdLevel::sse41, SimdLevel::avx2})
+                {
+                    if (level > best)
+                        continue;
+                    CHECK(ResizeImage(src, size.width, size.height, simd, filter, level));
+                    CHECK(SameImage(scalar, simd));
+                }
+            }
+        }
+    }
+
+    // 定点实现与参考实现之差只来自取整：系数为14位，预缩小和水平方向的结果取整为8位后再参与下一步，
+    // 每个值的误差不超过2个灰度级，平均约为半个灰度级
+    void TestAgainstReference()
+    {
+        RgbImage src, dst;
+        for (const Size &size : sizes)
+        {
+            CHECK(FillSyntheticFrame(src, size.src_width, size.src_height, 5));
+            for (ResizeFilter filter : {ResizeFilter::lanczos, ResizeFilter::bilinear})
+            {
+                CHECK(ResizeImage(src, size.width, size.height, dst, filter));
+                const std::vector<double> reference = ReferenceResize(src, size.width, size.height, filter);
+                double max_error = 0, total_error = 0;
+                for (int y = 0; y < size.height; y++)
+                    for (int i = 0; i < size.width * 3; i++)
+                    {
+                        double error = std::fabs(dst.Row(y)[i] - reference[static_cast<size_t>(y) * size.width * 3 + i]);
+                        max_error = std::max(max_error, error);
+                        total_error += error;
+                    }
+                const double mean_error = total_error / (static_cast<double>(size.width) * size.height * 3);
+                if (max_error > 2.0 || mean_error > 0.6)
+                    std::fprintf(stderr, "%dx%d -> %dx%d: max %.2f mean %.3f\n", size.src_width, size.src_height,
+                                 size.width, size.height, max_error, mean_error);
+                CHECK(max_error <= 2.0);
+                CHECK(mean_error <= 0.6);
+            }
+        }
+    }
+
+    void TestSolidColor()
+    {
+        RgbImage src, dst;
+        CHECK(src.Resize(257, 131));
+        for (int y = 0; y < src.height; y++)
+            for (int x = 0; x < src.width; x++)
+            {
+                src.Row(y)[x * 3] = 12;
+                src.Row(y)[x * 3 + 1] = 200;
+                src.Row(y)[x * 3 + 2] = 255;
+            }
+        for (const Size &size : {Size{0, 0, 64, 33}, Size{0, 0, 500, 255}, Size{0, 0, 7, 3}})
+        {
+            CHECK(ResizeImage(src, size.width, size.height, dst));
+            bool solid = true;
+            for (int y = 0; y < dst.height; y++)
+                for (int x = 0; x < dst.width; x++)
+                    solid = solid && dst.Row(y)[x * 3] == 12 && dst.Row(y)[x * 3 + 1] == 200 && dst.Row(y)[x * 3 + 2] == 255;
+            CHECK(solid);
+        }
+    }
+
+    // 帧缓冲池分配失败（尺寸过大）：Resize 和 ResizeImage 返回false，图像为 0x0，不会访问空缓冲区
+    void TestAllocationFailure()
+    {
+        const int huge = 1 << 30;
+        RgbImage image;
+        CHECK(image.Resize(64, 32));
+        CHECK(!image.Resize(huge, huge));
+        CHECK(image.width == 0 && image.height == 0 && !image.buffer);
+
+        RgbImage src, dst;
+        CHECK(FillSyntheticFrame(src, 64, 32, 1));
+        CHECK(!ResizeImage(src, huge, huge, dst));
+        CHECK(dst.width == 0 && dst.height == 0);
+        CHECK(ResizeImage(src, 32, 16, dst));
+        CHECK(dst.width == 32 && dst.height == 16);
+    }
+}
+
+int main()
+{
+    TestSimdLevels();
+    TestAgainstReference();
+    TestSolidColor();
+    TestAllocationFailure();
+    return TestResult();
+}
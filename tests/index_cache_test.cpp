@@ -0,0 +1,45 @@
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <string>
+#include <fcntl.h>
+#include <sys/stat.h>
+#include "index_cache.hpp"
+#include "test_util.hpp"
+
+namespace fs = std::filesystem;
+
+// 帧索引缓存：目录未变时直接从缓存重建，结果（包括帧号超出范围的文件数）与完整扫描相同
+
+int main()
+{
+    std::string pattern = (fs::temp_directory_path() / "gifcmd_index_XXXXXX").string();
+    if (!::mkdtemp(pattern.data()))
+        return 1;
+    const std::string directory = pattern;
+    for (const char *name : {"image_003.jpg", "image_001.jpg", "image_002.jpg", "image_99999999999999999999999.jpg"})
+        std::ofstream(fs::path(directory) / name) << name;
+    std::ofstream(fs::path(directory) / frame_cache_path).close();
+
+    // 目录mtime设为10秒前，避免缓存被标记为racy
+    struct timespec times[2];
+    ::clock_gettime(CLOCK_REALTIME, &times[0]);
+    times[0].tv_sec -= 10;
+    times[1] = times[0];
+    CHECK(::utimensat(AT_FDCWD, directory.c_str(), times, 0) == 0);
+
+    for (bool expect_hit : {false, true})
+    {
+        FrameIndex index;
+        FrameCacheStats stats;
+        CHECK(LoadFrameIndex(directory.c_str(), "jpg", index, &stats));
+        CHECK(stats.cache_hit == expect_hit);
+        CHECK(index.size() == 3);
+        CHECK(index.OverflowCount() == 1);
+        for (size_t i = 0; i < index.size(); i++)
+            CHECK(index.Name(i) == "image_00" + std::to_string(i + 1) + ".jpg");
+    }
+
+    fs::remove_all(directory);
+    return TestResult();
+}
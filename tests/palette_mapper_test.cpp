@@ -0,0 +1,107 @@
+#include <random>
+#include <thread>
+#include <vector>
+#include "color_quantizer.hpp"
+#include "palette_mapper.hpp"
+#include "synthetic_image.hpp"
+#include "test_util.hpp"
+
+// 最近颜色映射：结果与逐个比较全部调色板颜色（距离相同取下标小的）逐个相同，
+// 标量与AVX2路径相同，多个线程共用一个映射器（同时惰性填充）时结果不变
+
+namespace
+{
+    uint8_t BruteForce(const Palette &palette, const uint8_t *rgb)
+    {
+        int best = 0, best_distance = 1 << 30;
+        for (int i = 0; i < palette.size; i++)
+        {
+            int dr = rgb[0] - palette.colors[i][0], dg = rgb[1] - palette.colors[i][1], db = rgb[2] - palette.colors[i][2];
+            int d = dr * dr + dg * dg + db * db;
+            if (d < best_distance)
+            {
+                best = i;
+                best_distance = d;
+            }
+        }
+        return static_cast<uint8_t>(best);
+    }
+
+    Palette RandomPalette(int size, uint32_t seed, int levels = 256)
+    {
+        std::mt19937 rng(seed);
+        Palette palette;
+        palette.size = size;
+        for (int i = 0; i < size; i++)
+            for (int c = 0; c < 3; c++)
+                palette.colors[i][c] = static_cast<uint8_t>(rng() % levels * (256 / levels));
+        return palette;
+    }
+
+    // 测试颜色：步长为9的网格（覆盖每个格子的各种位置）加随机颜色
+    std::vector<uint8_t> TestColors()
+    {
+        std::vector<uint8_t> rgb;
+        for (int r = 0; r < 256; r += 9)
+            for (int g = 1; g < 256; g += 9)
+                for (int b = 2; b < 256; b += 9)
+                    rgb.insert(rgb.end(), {static_cast<uint8_t>(r), static_cast<uint8_t>(g), static_cast<uint8_t>(b)});
+        std::mt19937 rng(7);
+        for (int i = 0; i < 20000; i++)
+            rgb.insert(rgb.end(), {static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng()), static_cast<uint8_t>(rng())});
+        return rgb;
+    }
+
+    void CheckPalette(const Palette &palette, const std::vector<uint8_t> &rgb, bool concurrent = false)
+    {
+        const size_t n = rgb.size() / 3;
+        std::vector<uint8_t> expected(n);
+        for (size_t i = 0; i < n; i++)
+            expected[i] = BruteForce(palette, &rgb[i * 3]);
+
+        PaletteMapper mapper(palette);
+        std::vector<uint8_t> scalar(n), simd(n);
+        mapper.MapRow(rgb.data(), n, scalar.data(), SimdLevel::scalar);
+        CHECK(scalar == expected);
+        mapper.MapRow(rgb.data(), n, simd.data());
+        CHECK(simd == expected);
+        if (!concurrent)
+            return;
+
+        // 新的映射器由4个线程同时填充，各自从不同位置开始
+        PaletteMapper shared(palette);
+        std::vector<std::vector<uint8_t>> results(4, std::vector<uint8_t>(n));
+        std::vector<std::thread> threads;
+        for (size_t t = 0; t < results.size(); t++)
+            threads.emplace_back([&, t]
+                                 {
+                const size_t offset = n * t / results.size();
+                shared.MapRow(rgb.data() + offset * 3, n - offset, results[t].data() + offset);
+                shared.MapRow(rgb.data(), offset, results[t].data()); });
+        for (auto &thread : threads)
+            thread.join();
+        for (const auto &result : results)
+            CHECK(result == expected);
+    }
+}
+
+int main()
+{
+    const std::vector<uint8_t> rgb = TestColors();
+
+    // 随机调色板（含1色、2色和满256色），以及颜色重复、距离经常相同的粗糙调色板
+    for (int size : {1, 2, 17, 64, 256})
+        CheckPalette(RandomPalette(size, static_cast<uint32_t>(size)), rgb, size == 64);
+    CheckPalette(RandomPalette(200, 3, 4), rgb);
+
+    // 量化合成帧得到的调色板，映射该帧本身
+    RgbImage frame;
+    CHECK(FillSyntheticFrame(frame, 320, 180, 4));
+    ColorHistogram histogram;
+    histogram.Add(frame);
+    std::vector<uint8_t> pixels;
+    for (int y = 0; y < frame.height; y++)
+        pixels.insert(pixels.end(), frame.Row(y), frame.Row(y) + frame.width * 3);
+    CheckPalette(Quantize(histogram, 128, QuantizeAlgorithm::median_cut), pixels, true);
+    return TestResult();
+}
@@ -0,0 +1,195 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <unistd.h>
+#include "rename_journal.hpp"
+#include "test_util.hpp"
+
+namespace fs = std::filesystem;
+
+// 重命名日志：按日志顺序重命名、倒序回放；帧号整体平移（新名是另一帧的旧名）时不能丢失任何文件
+
+namespace
+{
+    struct TempDir
+    {
+        std::string path;
+        int fd = -1;
+
+        TempDir()
+        {
+            std::string pattern = (fs::temp_directory_path() / "gifcmd_journal_XXXXXX").string();
+            path = ::mkdtemp(pattern.data()) ? pattern : "";
+            fd = ::open(path.c_str(), O_RDONLY | O_DIRECTORY | O_CLOEXEC);
+        }
+        ~TempDir()
+        {
+            ::close(fd);
+            std::error_code ec;
+            fs::remove_all(path, ec);
+        }
+
+        void Write(const std::string &name, const std::string &content) const
+        {
+            std::ofstream(fs::path(path) / name, std::ios::binary) << content;
+        }
+        std::string Read(const std::string &name) const
+        {
+            std::ifstream in(fs::path(path) / name, std::ios::binary);
+            if (!in.is_open())
+                return "<missing>";
+            return std::string(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        }
+        size_t Count() const { return static_cast<size_t>(std::distance(fs::directory_iterator(path), {})); }
+    };
+
+    std::string Frame(int n)
+    {
+        char name[32];
+        std::snprintf(name, sizeof(name), "image_%03d.jpg", n);
+        return name;
+    }
+
+    // image_{first}..image_{first+count-1} 按顺序重命名为 image_001..image_{count}
+    std::vector<RenameJournalEntry> Shifted(int first, int count)
+    {
+        std::vector<RenameJournalEntry> entries;
+        for (int i = 0; i < count; i++)
+            entries.push_back({Frame(i + 1), Frame(first + i)});
+        return entries;
+    }
+
+    // 帧号整体减小：image_002..004 -> image_001..003，每个新名都是上一帧的旧名
+    void TestShiftDown()
+    {
+        TempDir dir;
+        for (int n = 2; n <= 4; n++)
+            dir.Write(Frame(n), "frame" + std::to_string(n));
+        auto entries = Shifted(2, 3);
+        CHECK(WriteRenameJournal(dir.fd, entries));
+
+        CHECK(ApplyRenameJournal(dir.fd, entries) == entries.size());
+        for (int i = 0; i < 3; i++)
+            CHECK(dir.Read(Frame(i + 1)) == "frame" + std::to_string(i + 2));
+
+        std::vector<RenameJournalEntry> read;
+        CHECK(ReadRenameJournal(dir.fd, read) && read.size() == entries.size());
+        std::vector<std::string> failed;
+        CHECK(ReplayRenameJournal(dir.fd, read, &failed) == entries.size());
+        CHECK(failed.empty());
+        for (int n = 2; n <= 4; n++)
+            CHECK(dir.Read(Frame(n)) == "frame" + std::to_string(n));
+        CHECK(dir.Read(Frame(1)) == "<missing>");
+    }
+
+    // 在第 k 个条目之前中断（模拟崩溃），回放后所有文件都回到原名
+    void TestInterrupted()
+    {
+        for (size_t k = 0; k <= 3; k++)
+        {
+            TempDir dir;
+            for (int n = 2; n <= 4; n++)
+                dir.Write(Frame(n), "frame" + std::to_string(n));
+            auto entries = Shifted(2, 3);
+            std::vector<RenameJournalEntry> prefix(entries.begin(), entries.begin() + k);
+            CHECK(ApplyRenameJournal(dir.fd, prefix) == k);
+
+            std::vector<std::string> failed;
+            CHECK(ReplayRenameJournal(dir.fd, entries, &failed) == k);
+            CHECK(failed.empty());
+            for (int n = 2; n <= 4; n++)
+                CHECK(dir.Read(Frame(n)) == "frame" + std::to_string(n));
+            CHECK(dir.Count() == 3);
+        }
+    }
+
+    // 帧号整体增大：image_000..002 -> image_001..003，按顺序执行时第一个目标就被下一帧占用，
+    // 排序后倒序执行，全部成功且能恢复
+    void TestShiftUp()
+    {
+        TempDir dir;
+        for (int n = 0; n <= 2; n++)
+            dir.Write(Frame(n), "frame" + std::to_string(n));
+        auto entries = Shifted(0, 3);
+        CHECK(ApplyRenameJournal(dir.fd, entries) == 0);
+        CHECK(errno == EEXIST);
+
+        auto ordered = entries;
+        CHECK(OrderRenameJournal(ordered));
+        CHECK(ordered.front().original_name == Frame(2));
+        CHECK(WriteRenameJournal(dir.fd, ordered));
+        CHECK(ApplyRenameJournal(dir.fd, ordered) == ordered.size());
+        for (int i = 0; i < 3; i++)
+            CHECK(dir.Read(Frame(i + 1)) == "frame" + std::to_string(i));
+        CHECK(dir.Read(Frame(0)) == "<missing>");
+
+        std::vector<RenameJournalEntry> read;
+        CHECK(ReadRenameJournal(dir.fd, read) && read.size() == ordered.size());
+        std::vector<std::string> failed;
+        CHECK(ReplayRenameJournal(dir.fd, read, &failed) == ordered.size());
+        CHECK(failed.empty());
+        for (int n = 0; n <= 2; n++)
+            CHECK(dir.Read(Frame(n)) == "frame" + std::to_string(n));
+        CHECK(dir.Read(Frame(3)) == "<missing>");
+    }
+
+    // 帧号整体减小时保持原顺序；互相占用成环（两帧交换名字）时拒绝且不修改条目
+    void TestOrder()
+    {
+        auto entries = Shifted(2, 3);
+        auto ordered = entries;
+        CHECK(OrderRenameJournal(ordered));
+        for (size_t i = 0; i < entries.size(); i++)
+            CHECK(ordered[i].temp_name == entries[i].temp_name && ordered[i].original_name == entries[i].original_name);
+
+        std::vector<RenameJournalEntry> swap = {{Frame(3), Frame(4)}, {Frame(1), Frame(2)}, {Frame(2), Frame(1)}};
+        CHECK(!OrderRenameJournal(swap));
+        CHECK(swap[0].temp_name == Frame(3) && swap[1].temp_name == Frame(1) && swap[2].temp_name == Frame(2));
+    }
+
+    // 目标名被日志以外的文件占用：重命名失败，两个文件都保留
+    void TestForeignCollision()
+    {
+        TempDir dir;
+        dir.Write("x0.jpg", "x0");
+        dir.Write(Frame(1), "other");
+        std::vector<RenameJournalEntry> entries = {{Frame(1), "x0.jpg"}};
+        CHECK(ApplyRenameJournal(dir.fd, entries) == 0);
+        CHECK(errno == EEXIST);
+        CHECK(dir.Read("x0.jpg") == "x0");
+        CHECK(dir.Read(Frame(1)) == "other");
+    }
+
+    // 文件名本来就是目标名的条目不做任何操作
+    void TestIdentity()
+    {
+        TempDir dir;
+        dir.Write(Frame(1), "frame1");
+        dir.Write(Frame(3), "frame3");
+        std::vector<RenameJournalEntry> entries = {{Frame(1), Frame(1)}, {Frame(2), Frame(3)}};
+        CHECK(ApplyRenameJournal(dir.fd, entries) == 2);
+        CHECK(dir.Read(Frame(2)) == "frame3");
+        std::vector<std::string> failed;
+        CHECK(ReplayRenameJournal(dir.fd, entries, &failed) == 2);
+        CHECK(failed.empty());
+        CHECK(dir.Read(Frame(1)) == "frame1");
+        CHECK(dir.Read(Frame(3)) == "frame3");
+    }
+}
+
+int main()
+{
+    TestShiftDown();
+    TestInterrupted();
+    TestShiftUp();
+    TestOrder();
+    TestForeignCollision();
+    TestIdentity();
+    return TestResult();
+}
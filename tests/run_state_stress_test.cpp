@@ -0,0 +1,152 @@
+#include <atomic>
+#include <deque>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <vector>
+#include <ftxui/component/receiver.hpp>
+#include "frame_pool.hpp"
+#include "run_state.hpp"
+#include "stage_pipeline.hpp"
+#include "test_util.hpp"
+
+using ftxui::MakeReceiver;
+using ftxui::Receiver;
+using ftxui::Sender;
+
+// 界面渲染的同时多个任务高频更新并发布 RunState：与 main.cpp 的 JobContext 相同，经 RunStatePublisher
+// 持锁修改各自的状态副本后整体经共用的 Sender 发送；界面线程非阻塞地取出并格式化状态文字、读取原子进度
+// 用 -fsanitize=thread 构建时检查数据竞争
+
+namespace
+{
+    const int job_count = 4;
+    const size_t frames_per_job = 2000;
+
+    // 发布后的通知只计数，代替界面刷新请求
+    struct StressJob : RunStatePublisher
+    {
+        StressJob(int id, Sender<RunState> &sender, std::atomic<size_t> &sent)
+            : RunStatePublisher(id, sender, [&sent]
+                                { sent.fetch_add(1, std::memory_order_relaxed); })
+        {
+            job.id = id;
+        }
+
+        EncodeJob job;
+    };
+
+    struct StressFrame
+    {
+        FramePool::Handle buffer;
+    };
+
+    // 一个任务：两阶段流水线，阶段线程申请帧缓冲区并发布进度，写出时发布各阶段负载
+    void RunJob(StressJob &ctx)
+    {
+        {
+            std::lock_guard<std::mutex> lock(ctx.mutex);
+            ctx.state.running = true;
+            ctx.state.stage_count = 2;
+            ctx.state.stage = 1;
+            ctx.state.total_frames = frames_per_job;
+            ctx.Publish();
+        }
+        StagePipeline<StressFrame> pipeline;
+        std::atomic<size_t> decoded{0};
+        pipeline.AddStage("解码", 2, [&](size_t, StressFrame &frame)
+                          {
+            frame.buffer = FramePool::Default().Acquire(64, 48, PixelFormat::rgb24);
+            frame.buffer.data()[0] = 1;
+            size_t done = ++decoded;
+            std::lock_guard<std::mutex> lock(ctx.mutex);
+            ctx.state.last_sample.frame = static_cast<int64_t>(done);
+            ctx.state.last_sample.fps = static_cast<double>(done);
+            ctx.state.result_message = "解码 " + std::to_string(done);
+            ctx.Publish();
+            return true; });
+        pipeline.AddStage("压缩", 2, [&](size_t, StressFrame &frame)
+                          {
+            frame.buffer.Release();
+            return true; });
+
+        std::vector<StageLoad> loads;
+        bool ok = pipeline.Run(frames_per_job, 8, "写出", [&](size_t i, StressFrame &)
+                               {
+            pipeline.Loads(loads);
+            ctx.job.progress = static_cast<float>(i + 1) / frames_per_job;
+            std::lock_guard<std::mutex> lock(ctx.mutex);
+            ctx.state.stage = 2;
+            ctx.state.stage_loads = loads;
+            ctx.UpdatePoolStats();
+            ctx.Publish();
+            return true; });
+
+        std::lock_guard<std::mutex> lock(ctx.mutex);
+        ctx.state.running = false;
+        ctx.state.finished = true;
+        ctx.state.succeeded = ok;
+        ctx.state.stage_loads.clear();
+        ctx.state.result_message = "完成 #" + std::to_string(ctx.job.id);
+        ctx.Publish();
+    }
+}
+
+int main()
+{
+    Receiver<RunState> receiver = MakeReceiver<RunState>();
+    Sender<RunState> sender = receiver->MakeSender(); // 所有任务共用
+    std::atomic<size_t> sent{0};
+
+    std::deque<StressJob> jobs;
+    for (int i = 0; i < job_count; i++)
+        jobs.emplace_back(i + 1, sender, sent);
+
+    std::atomic<int> running{job_count};
+    std::vector<std::thread> workers;
+    for (StressJob &job : jobs)
+        workers.emplace_back([&]
+                             { RunJob(job); running--; });
+
+    // 界面线程：与渲染函数相同地取出所有待处理的状态并生成每行的文字
+    std::map<int, RunState> rows;
+    size_t received = 0;
+    size_t rendered_bytes = 0;
+    for (;;)
+    {
+        const bool done = running.load() == 0;
+        RunState state;
+        while (receiver->ReceiveNonBlocking(&state))
+        {
+            received++;
+            rows[state.job_id] = std::move(state);
+        }
+        for (const auto &[id, row] : rows)
+        {
+            rendered_bytes += FormatRunStatus(row).size() + row.result_message.size();
+            if (row.running && !row.stage_loads.empty())
+                rendered_bytes += FormatStageLoads(row).size();
+            rendered_bytes += static_cast<size_t>(jobs[id - 1].job.progress.load(std::memory_order_relaxed) * 100);
+        }
+        if (done)
+            break;
+    }
+    for (auto &worker : workers)
+        worker.join();
+
+    CHECK(received == sent.load());
+    CHECK(rendered_bytes > 0);
+    CHECK(rows.size() == static_cast<size_t>(job_count));
+    for (const auto &[id, row] : rows)
+    {
+        CHECK(row.finished && row.succeeded);
+        CHECK(row.result_message == "完成 #" + std::to_string(id));
+        CHECK(FormatRunStatus(row).find("成功") != std::string::npos);
+        CHECK(jobs[id - 1].job.progress.load() == 1.0f);
+    }
+    FramePoolStats stats = FramePool::Default().Stats();
+    CHECK(stats.live_bytes == 0);
+    return TestResult();
+}
@@ -0,0 +1,51 @@
+#ifndef GIFCMD_SYNTHETIC_IMAGE_HPP
+#define GIFCMD_SYNTHETIC_IMAGE_HPP
+
+#include <cstdint>
+#include "image_decode.hpp"
+
+// 测试和基准用的合成帧：平滑渐变背景、随 frame 移动的实心矩形和圆（锐利边缘），以及一块带噪声的纹理
+// 同样的参数总是生成同样的像素；帧缓冲池分配失败时返回false
+inline bool FillSyntheticFrame(RgbImage &image, int width, int height, uint32_t frame = 0)
+{
+    if (!image.Resize(width, height))
+        return false;
+    uint32_t noise = 0x9E3779B9u ^ frame;
+    const int box_x = static_cast<int>((frame * 7) % static_cast<uint32_t>(width));
+    const int circle_x = width / 2, circle_y = height / 2;
+    const int radius = std::max(1, std::min(width, height) / 5);
+    for (int y = 0; y < height; y++)
+    {
+        uint8_t *row = image.Row(y);
+        for (int x = 0; x < width; x++)
+        {
+            uint8_t *p = row + x * 3;
+            p[0] = static_cast<uint8_t>(x * 255 / std::max(1, width - 1));
+            p[1] = static_cast<uint8_t>(y * 255 / std::max(1, height - 1));
+            p[2] = static_cast<uint8_t>((x + y + frame) & 0xFF);
+            const int dx = x - circle_x, dy = y - circle_y;
+            if (dx * dx + dy * dy < radius * radius)
+            {
+                p[0] = 230;
+                p[1] = 40;
+                p[2] = 60;
+            }
+            if (x >= box_x && x < box_x + width / 6 && y >= height / 8 && y < height / 3)
+            {
+                p[0] = 20;
+                p[1] = 200;
+                p[2] = 90;
+            }
+            if (y > height * 3 / 4 && x < width / 3)
+            {
+                noise = noise * 1664525u + 1013904223u;
+                p[0] = static_cast<uint8_t>(noise >> 24);
+                p[1] = static_cast<uint8_t>(noise >> 16);
+                p[2] = static_cast<uint8_t>(noise >> 8);
+            }
+        }
+    }
+    return true;
+}
+
+#endif // GIFCMD_SYNTHETIC_IMAGE_HPP
@@ -0,0 +1,26 @@
+#ifndef GIFCMD_TEST_UTIL_HPP
+#define GIFCMD_TEST_UTIL_HPP
+
+#include <cstdio>
+
+// 最小的断言工具：失败时打印位置并计数，main 返回 TestResult()
+inline int test_failures = 0;
+
+#define CHECK(condition)                                                                        \
+    do                                                                                          \
+    {                                                                                           \
+        if (!(condition))                                                                       \
+        {                                                                                       \
+            std::fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            test_failures++;                                                                    \
+        }                                                                                       \
+    } while (0)
+
+inline int TestResult()
+{
+    if (test_failures)
+        std::fprintf(stderr, "%d check(s) failed\n", test_failures);
+    return test_failures ? 1 : 0;
+}
+
+#endif // GIFCMD_TEST_UTIL_HPP